@@ -37,6 +37,32 @@ void nx__default_fiq(void);
 void nx__spurious_irq(void);
 /*@}*/
 
+/** @name Interrupted state introspection.
+ *
+ * These let the innermost interrupt handler (typically the high
+ * priority system timer) inspect the code it interrupted, for
+ * sampling profilers and the like.
+ */
+/*@{*/
+
+/** The address of the registers saved by the innermost interrupt.
+ *
+ * If the interrupt preempted a User or System mode task, this points
+ * to a nx_task_stack_t. Otherwise, it points to the saved r0-r12 and
+ * lr of the interrupted Supervisor mode code, in that order.
+ */
+extern U32 *nx__irq_saved_state;
+
+/** Return the CPSR and PC of the code interrupted by the innermost
+ * interrupt.
+ *
+ * @return A pointer to two words: the interrupted CPSR, followed by
+ * the address of the instruction that will resume execution.
+ */
+U32 *nx__interrupts_get_irq_frame(void);
+
+/*@}*/
+
 /*@}*/
 /*@}*/
 
@@ -0,0 +1,47 @@
+/** @file _timer.h
+ *  @brief Software timer internals.
+ */
+
+/* Copyright (c) 2008 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#ifndef __NXOS_BASE__TIMER_H__
+#define __NXOS_BASE__TIMER_H__
+
+#include "base/timer.h"
+
+/** @addtogroup kernelinternal */
+/*@{*/
+
+/** @defgroup timerinternal Software timer internals */
+/*@{*/
+
+/** Check whether any timer is armed.
+ *
+ * @return TRUE if nx__timer_run() must be called every millisecond.
+ */
+bool nx__timer_pending(void);
+
+/** Fire the timers that expired since the last call.
+ *
+ * @warning Called by the systick driver when appropriate. Do @b not
+ * call directly!
+ */
+void nx__timer_run(void);
+
+/** Get the time until the timers next need attention.
+ *
+ * @return The number of milliseconds the system can sleep without
+ * delaying a timer.
+ */
+U32 nx__timer_next_timeout(void);
+
+/*@}*/
+/*@}*/
+
+#endif /* __NXOS_BASE__TIMER_H__ */
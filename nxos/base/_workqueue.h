@@ -0,0 +1,32 @@
+/** @file _workqueue.h
+ *  @brief Deferred work internals.
+ */
+
+/* Copyright (c) 2008 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#ifndef __NXOS_BASE__WORKQUEUE_H__
+#define __NXOS_BASE__WORKQUEUE_H__
+
+#include "base/workqueue.h"
+
+/** @addtogroup kernelinternal */
+/*@{*/
+
+/** @defgroup workqueueinternal Deferred work internals */
+/*@{*/
+
+/** Initialize the work queue. Must be called before the drivers that
+ * use it are initialized.
+ */
+void nx__workqueue_init(void);
+
+/*@}*/
+/*@}*/
+
+#endif /* __NXOS_BASE__WORKQUEUE_H__ */
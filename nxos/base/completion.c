@@ -0,0 +1,87 @@
+/* Copyright (c) 2008 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#include "base/types.h"
+#include "base/assert.h"
+#include "base/interrupts.h"
+#include "base/drivers/systick.h"
+
+#include "base/completion.h"
+
+/* The application kernel's operations, or NULL. */
+static const nx_completion_ops_t *completion_ops = NULL;
+
+void nx_completion_init(nx_completion_t *c) {
+  NX_ASSERT(c != NULL);
+
+  c->done = FALSE;
+}
+
+void nx_completion_reset(nx_completion_t *c) {
+  c->done = FALSE;
+}
+
+void nx_completion_signal(nx_completion_t *c) {
+  const nx_completion_ops_t *ops = completion_ops;
+
+  c->done = TRUE;
+  if (ops)
+    ops->signal(c);
+}
+
+bool nx_completion_is_done(nx_completion_t *c) {
+  return c->done;
+}
+
+/* Return the time left before @a timeout expires, 0 once it has. */
+static U32 completion_remaining(U32 start, U32 timeout) {
+  U32 elapsed;
+
+  if (timeout == NX_COMPLETION_FOREVER)
+    return NX_COMPLETION_FOREVER;
+
+  elapsed = nx_systick_get_ms() - start;
+  return (elapsed < timeout) ? timeout - elapsed : 0;
+}
+
+bool nx_completion_wait(nx_completion_t *c, U32 timeout) {
+  const nx_completion_ops_t *ops = completion_ops;
+  U32 start = nx_systick_get_ms();
+  U32 remaining;
+
+  NX_ASSERT(c != NULL);
+
+  while (!c->done) {
+    remaining = completion_remaining(start, timeout);
+    if (remaining == 0)
+      break;
+
+    if (ops && ops->can_block()) {
+      ops->block(c, remaining);
+    } else {
+      /* Checking the completion with interrupts disabled closes the
+       * window between the check and the sleep: a signal that comes
+       * in between ends the sleep right away.
+       */
+      nx_interrupts_disable();
+      if (!c->done)
+        nx_systick_idle(remaining);
+      nx_interrupts_enable();
+    }
+  }
+
+  return c->done;
+}
+
+void nx_completion_install_ops(const nx_completion_ops_t *ops) {
+  NX_ASSERT(ops == NULL ||
+            (ops->can_block != NULL && ops->block != NULL &&
+             ops->signal != NULL));
+
+  completion_ops = ops;
+}
@@ -0,0 +1,118 @@
+/** @file completion.h
+ *  @brief Waiting for interrupt driven operations to complete.
+ */
+
+/* Copyright (c) 2008 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#ifndef __NXOS_BASE_COMPLETION_H__
+#define __NXOS_BASE_COMPLETION_H__
+
+#include "base/types.h"
+
+/** @addtogroup kernel */
+/*@{*/
+
+/** @defgroup completion Completions
+ *
+ * A completion lets code wait for something an interrupt handler
+ * will signal, like the end of a transfer, without polling the driver
+ * in a busy loop.
+ *
+ * By default, a waiter stops the processor until the next interrupt
+ * (see nx_systick_idle()) and checks the completion again. Application
+ * kernels with a scheduler can install their own wait and signal
+ * operations with nx_completion_install_ops(), so that waiting tasks
+ * are blocked and woken up directly by the signal, leaving the
+ * processor to the other tasks in the meantime.
+ *
+ * A completion has a single waiter. Completions must not be waited on
+ * from interrupt handlers.
+ */
+/*@{*/
+
+/** Wait without a timeout. */
+#define NX_COMPLETION_FOREVER 0xFFFFFFFF
+
+/** A completion.
+ *
+ * Completions are allocated by the caller, usually statically, and
+ * initialized with nx_completion_init().
+ */
+typedef struct {
+  volatile bool done; /**< Set once the completion is signaled. */
+} nx_completion_t;
+
+/** Wait and signal operations of an application kernel. */
+typedef struct {
+  /** Return TRUE if the caller can be blocked by @a block. If not,
+   * the default wait is used.
+   */
+  bool (*can_block)(void);
+
+  /** Block the caller until @a c is signaled or @a timeout
+   * milliseconds have elapsed. May return early.
+   */
+  void (*block)(nx_completion_t *c, U32 timeout);
+
+  /** Wake up the waiter of @a c, which has just been signaled. Called
+   * from any context, including interrupt handlers.
+   */
+  void (*signal)(nx_completion_t *c);
+} nx_completion_ops_t;
+
+/** Initialize @a c, not signaled.
+ *
+ * @param c The completion.
+ */
+void nx_completion_init(nx_completion_t *c);
+
+/** Clear @a c before starting a new operation.
+ *
+ * This must happen before the operation can complete, or the signal
+ * may be lost.
+ *
+ * @param c The completion.
+ */
+void nx_completion_reset(nx_completion_t *c);
+
+/** Signal @a c, and wake up its waiter.
+ *
+ * Safe to call from any context.
+ *
+ * @param c The completion.
+ */
+void nx_completion_signal(nx_completion_t *c);
+
+/** Wait for @a c to be signaled.
+ *
+ * @param c The completion.
+ * @param timeout The longest time to wait, in milliseconds, or
+ * NX_COMPLETION_FOREVER.
+ * @return TRUE if @a c was signaled, FALSE on timeout.
+ */
+bool nx_completion_wait(nx_completion_t *c, U32 timeout);
+
+/** Check whether @a c has been signaled.
+ *
+ * @param c The completion.
+ * @return TRUE if @a c was signaled since it was last reset.
+ */
+bool nx_completion_is_done(nx_completion_t *c);
+
+/** Install the application kernel's wait and signal operations.
+ *
+ * @param ops The operations, or NULL for the default ones. They must
+ * stay allocated while installed.
+ */
+void nx_completion_install_ops(const nx_completion_ops_t *ops);
+
+/*@}*/
+/*@}*/
+
+#endif /* __NXOS_BASE_COMPLETION_H__ */
@@ -12,6 +12,7 @@
 #include "base/interrupts.h"
 #include "base/_display.h"
 #include "base/assert.h"
+#include "base/_workqueue.h"
 #include "drivers/_aic.h"
 #include "drivers/_systick.h"
 #include "drivers/_sound.h"
@@ -36,6 +37,7 @@ static void core_init(void) {
   nx__aic_init();
   nx_interrupts_enable();
   nx__systick_init();
+  nx__workqueue_init();
   nx__sound_init();
   nx__avr_init();
   nx__motors_init();
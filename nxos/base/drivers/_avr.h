@@ -42,6 +42,16 @@ void nx__avr_init(void);
  */
 void nx__avr_fast_update(void);
 
+/** Return how long the AVR link can go without updates.
+ *
+ * Used by the system timer to bound how many ticks it may skip when
+ * the system is idle.
+ *
+ * @return The maximum number of milliseconds between two calls to
+ * nx__avr_fast_update().
+ */
+U32 nx__avr_max_idle_ms(void);
+
 /** Return the raw sensor value for @a sensor.
  *
  * @param sensor The sensor port, 0 through 3.
@@ -0,0 +1,53 @@
+/** @file _buttons.h
+ *  @brief Debounced button events internal interface.
+ */
+
+/* Copyright (c) 2008 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#ifndef __NXOS_BASE_DRIVERS__BUTTONS_H__
+#define __NXOS_BASE_DRIVERS__BUTTONS_H__
+
+#include "base/drivers/buttons.h"
+
+/** @addtogroup driverinternal */
+/*@{*/
+
+/** @defgroup buttonsinternal Button events */
+/*@{*/
+
+/** Initialize the debouncer and the event queue.
+ *
+ * @warning Called by the AVR driver before the link starts.
+ */
+void nx__buttons_init(void);
+
+/** Feed the button reading of an AVR status frame to the debouncer.
+ *
+ * @param button The button decoded from the frame.
+ * @param timestamp When the frame arrived, in microseconds.
+ *
+ * @warning Called by the AVR driver from the system timer interrupt,
+ * for every frame that passes its checksum.
+ */
+void nx__buttons_frame(nx_avr_button_t button, U32 timestamp);
+
+/** Check whether a button is down, or about to be.
+ *
+ * The AVR driver keeps the link running every millisecond while it
+ * is, so that debouncing, holds and repeats keep their timing when
+ * the system is idle.
+ *
+ * @return TRUE if the buttons need frequent frames.
+ */
+bool nx__buttons_is_active(void);
+
+/*@}*/
+/*@}*/
+
+#endif /* __NXOS_BASE_DRIVERS__BUTTONS_H__ */
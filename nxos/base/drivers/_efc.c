@@ -32,7 +32,11 @@ static bool nx__efc_do_write(U32 page) {
   /* Trigger the flash write command. */
   *AT91C_MC_FCR = EFC_WRITE + ((page & 0x000003FF) << 8);
 
-  /* Wait for the command to complete. */
+  /* Wait for the command to complete. This can't sleep on a
+   * completion like the other drivers do: the flash can't be read
+   * while it is being programmed, so neither tasks nor interrupt
+   * handlers running from it could make use of the time.
+   */
   do {
     ret = *AT91C_MC_FSR;
   } while (!(ret & AT91C_MC_FRDY));
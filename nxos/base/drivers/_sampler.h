@@ -0,0 +1,46 @@
+/** @file _sampler.h
+ *  @brief Analog sensor sampling service internal interface.
+ */
+
+/* Copyright (c) 2008 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#ifndef __NXOS_BASE_DRIVERS__SAMPLER_H__
+#define __NXOS_BASE_DRIVERS__SAMPLER_H__
+
+#include "base/drivers/sampler.h"
+
+/** @addtogroup driverinternal */
+/*@{*/
+
+/** @defgroup samplerinternal Sensor sampling */
+/*@{*/
+
+/** Feed the readings of an AVR status frame to the sampler.
+ *
+ * @param adc The readings of all the sensor ports.
+ * @param timestamp When the frame arrived, in microseconds.
+ *
+ * @warning Called by the AVR driver from the system timer interrupt,
+ * for every frame that passes its checksum.
+ */
+void nx__sampler_frame(const U16 *adc, U32 timestamp);
+
+/** Check whether any port is being sampled.
+ *
+ * The AVR driver keeps the link running every millisecond while it
+ * is, instead of slowing it down when the system is idle.
+ *
+ * @return TRUE if a port is being sampled.
+ */
+bool nx__sampler_is_active(void);
+
+/*@}*/
+/*@}*/
+
+#endif /* __NXOS_BASE_DRIVERS__SAMPLER_H__ */
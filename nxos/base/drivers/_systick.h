@@ -13,6 +13,7 @@
 #ifndef __NXOS_BASE_DRIVERS__SYSTICK_H__
 #define __NXOS_BASE_DRIVERS__SYSTICK_H__
 
+#include "base/nxt.h"
 #include "base/drivers/systick.h"
 
 /** @addtogroup driverinternal */
@@ -21,9 +22,23 @@
 /** @defgroup systickinternal System timer */
 /*@{*/
 
+/** The frequency of the system timer's hardware counter, in Hz. */
+#define NX__SYSTICK_TICK_FREQ (NXT_CLOCK_FREQ/16)
+
 /** Initialize the system timer driver. */
 void nx__systick_init(void);
 
+/** Return the time elapsed since bootup, in system timer counter
+ * ticks.
+ *
+ * The counter runs at #NX__SYSTICK_TICK_FREQ, and this value wraps
+ * around every 23 minutes or so: it is only meant for measuring short
+ * intervals. Safe to call from any context.
+ *
+ * @return The current value of the counter.
+ */
+U32 nx__systick_get_ticks(void);
+
 /*@}*/
 /*@}*/
 
@@ -11,6 +11,7 @@
 #include "base/types.h"
 #include "base/interrupts.h"
 #include "base/assert.h"
+#include "base/lock.h"
 #include "base/drivers/aic.h"
 #include "base/drivers/systick.h"
 
@@ -31,10 +32,18 @@ static volatile struct {
   /* Address and size of a send/receive buffer. */
   U8 *ptr;
   U32 len;
+
+  /* When the current transfer started, and how long the last one
+   * took, in microseconds.
+   */
+  U32 start;
+  U32 duration;
 } twi_state = {
   TWI_UNINITIALIZED, /* Not initialized yet. */
   NULL,              /* No send/recv buffer. */
   0,                 /* And zero length, obviously. */
+  0,
+  0,
 };
 
 static void twi_isr(void)
@@ -60,6 +69,7 @@ static void twi_isr(void)
      */
     if (twi_state.len == 0) {
       *AT91C_TWI_IDR = ~0;
+      twi_state.duration = nx_systick_get_us() - twi_state.start;
       twi_state.mode = TWI_READY;
     }
   }
@@ -71,6 +81,7 @@ static void twi_isr(void)
      */
     if (twi_state.len == 0) {
       *AT91C_TWI_IDR = ~0;
+      twi_state.duration = nx_systick_get_us() - twi_state.start;
       twi_state.mode = TWI_READY;
     } else {
       /* Instruct the TWI to send a STOP condition at the end of the
@@ -93,8 +104,8 @@ static void twi_isr(void)
   if (status & (AT91C_TWI_OVRE | AT91C_TWI_UNRE | AT91C_TWI_NACK)) {
     *AT91C_TWI_CR = AT91C_TWI_STOP;
     *AT91C_TWI_IDR = ~0;
+    /* The AVR driver recovers from this with nx__twi_abort(). */
     twi_state.mode = TWI_FAILED;
-    /* TODO: This should be an assertion failed, ie. a hard crash. */
   }
 }
 
@@ -168,6 +179,7 @@ void nx__twi_read_async(U32 dev_addr, U8 *data, U32 len)
   twi_state.mode = TWI_RX_BUSY;
   twi_state.ptr = data;
   twi_state.len = len;
+  twi_state.start = nx_systick_get_us();
 
   *AT91C_TWI_MMR = mode;
   *AT91C_TWI_CR = AT91C_TWI_START | AT91C_TWI_MSEN;
@@ -186,6 +198,7 @@ void nx__twi_write_async(U32 dev_addr, U8 *data, U32 len)
   twi_state.mode = TWI_TX_BUSY;
   twi_state.ptr = data;
   twi_state.len = len;
+  twi_state.start = nx_systick_get_us();
 
   *AT91C_TWI_MMR = mode;
   *AT91C_TWI_CR = AT91C_TWI_START | AT91C_TWI_MSEN;
@@ -195,3 +208,27 @@ void nx__twi_write_async(U32 dev_addr, U8 *data, U32 len)
 bool nx__twi_ready(void) {
   return (twi_state.mode == TWI_READY) ? TRUE : FALSE;
 }
+
+bool nx__twi_failed(void) {
+  return (twi_state.mode == TWI_FAILED) ? TRUE : FALSE;
+}
+
+void nx__twi_abort(void) {
+  U32 state;
+
+  NX_ASSERT(twi_state.mode != TWI_UNINITIALIZED);
+
+  /* Called from the system timer interrupt, where
+   * nx_interrupts_enable() would unmask interrupts too early.
+   */
+  state = nx_critical_enter();
+  *AT91C_TWI_IDR = ~0;
+  if (twi_state.mode != TWI_READY)
+    *AT91C_TWI_CR = AT91C_TWI_STOP;
+  twi_state.mode = TWI_READY;
+  nx_critical_exit(state);
+}
+
+U32 nx__twi_get_duration_us(void) {
+  return twi_state.duration;
+}
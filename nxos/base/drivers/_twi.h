@@ -65,6 +65,29 @@ void nx__twi_read_async(U32 dev_addr, U8 *data, U32 len);
  */
 bool nx__twi_ready(void);
 
+/** Check whether the last transfer failed.
+ *
+ * After a failure, the driver is neither busy nor ready until
+ * nx__twi_abort() is called.
+ *
+ * @return TRUE if the slave didn't acknowledge the last transfer, or
+ * the controller overran or underran.
+ */
+bool nx__twi_failed(void);
+
+/** Abort the transfer in progress, if any, and make the driver ready.
+ *
+ * Used to recover from a failed or stuck transfer.
+ */
+void nx__twi_abort(void);
+
+/** Return the duration of the last completed transfer.
+ *
+ * @return The time from the start of the transfer to its last byte, in
+ * microseconds.
+ */
+U32 nx__twi_get_duration_us(void);
+
 /*@}*/
 /*@}*/
 
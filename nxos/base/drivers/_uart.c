@@ -12,6 +12,9 @@
 #include "base/nxt.h"
 #include "base/assert.h"
 #include "base/interrupts.h"
+#include "base/util.h"
+#include "base/workqueue.h"
+#include "base/ring.h"
 #include "base/drivers/aic.h"
 #include "base/drivers/systick.h"
 
@@ -34,27 +37,105 @@
  */
 #define UART_CLOCK_DIVISOR (NXT_CLOCK_FREQ / 8 / UART_BAUD_RATE)
 
+/* Size of the ring of received packets. It holds a few of them, so
+ * that the Bluecore doesn't have to wait for each packet to be
+ * processed before sending the next.
+ */
+#define UART_RX_RING_SIZE 512
+
+/* The largest record in the ring: a size byte, and the packet. */
+#define UART_RX_RECORD_MAX (1 + UART_BUFSIZE)
+
 static volatile struct {
   nx__uart_read_callback_t callback;
 
   U32 packet_size;
-  U8 buf[UART_BUFSIZE];
+
+  /* The packet being received: its size, followed by the data the
+   * PDC reads, so that both can be queued as one record.
+   */
+  U8 buf[UART_RX_RECORD_MAX];
 
   /* for manual reading from the bluetooth driver : */
   U32 to_read;
 
+  /* Set when reception is held off until the ring has room for
+   * another packet. The hardware handshake meanwhile holds off the
+   * Bluecore.
+   */
+  bool rx_stalled;
 } uart_state = {
-  NULL, 0, {0}, 0
+  NULL, 0, {0}, 0, FALSE
 };
 
+/* The received packets, waiting for the callback. Each is a record of
+ * a size byte followed by the data, a break being a record of size 0.
+ * The interrupt handler produces them, and the deferred work consumes
+ * them.
+ */
+static nx_ring_t uart_rx_ring;
+static U8 uart_rx_storage[UART_RX_RING_SIZE];
+
+/* The packet handed to the callback. */
+static U8 uart_rx_packet[UART_BUFSIZE];
+
+static nx_work_t uart_rx_work;
+
+/* Restart reception, to get the size of the next packet. */
+static void uart_rx_restart(void) {
+  /* We must put a size != 0 in the RCR register (even if the PDC is disabled for the receiving) */
+  /* else when we try to read manually a value on US1_RHR thanks to the RXRDY interruption
+   * the RXRDY of the CSR seems to never be set to 1 (no value read on the UART ?) */
+  /* TODO : figure this out */
+  *AT91C_US1_RPR = (U32)(&uart_state.buf[1]);
+  *AT91C_US1_RCR = UART_BUFSIZE; /* default size */
+
+  /* we've read a packet, so now we will do a manual reading
+   * to have the next packet size and adapt the PDC RCR register value */
+  *AT91C_US1_IER = AT91C_US_RXRDY;
+}
+
+/* Hand the received packets and breaks to the callback. This parsing
+ * is left out of the interrupt handler, which only queues the packets
+ * and goes on receiving.
+ */
+static void uart_rx_deliver(void *arg __attribute__((unused))) {
+  nx__uart_read_callback_t callback;
+  U8 size;
+
+  /* A record is queued whole, so its data is there once its size is. */
+  while (nx_ring_get(&uart_rx_ring, &size, 1)) {
+    if (size > 0)
+      nx_ring_get(&uart_rx_ring, uart_rx_packet, size);
+
+    callback = uart_state.callback;
+    if (callback)
+      callback(size > 0 ? uart_rx_packet : NULL, size);
+  }
+
+  /* Resume the reception held off by a full ring. */
+  nx_interrupts_disable();
+  if (uart_state.rx_stalled &&
+      nx_ring_space(&uart_rx_ring) >= UART_RX_RECORD_MAX) {
+    uart_state.rx_stalled = FALSE;
+    uart_rx_restart();
+  }
+  nx_interrupts_enable();
+}
+
 static void uart_isr(void) {
   U32 status = *AT91C_US1_CSR;
+  U32 size;
 
   /* If we receive a break condition from the Bluecore, send up a NULL
    * packet and reset the controller status.
    */
   if (status & AT91C_US_RXBRK) {
-    uart_state.callback(NULL, 0);
+    U8 brk = 0;
+
+    /* With the ring full, the break is lost like a garbled packet. */
+    nx_ring_put(&uart_rx_ring, &brk, 1);
+    nx_work_queue(&uart_rx_work);
     *AT91C_US1_CR = AT91C_US_RSTSTA;
   }
 
@@ -67,7 +148,9 @@ static void uart_isr(void) {
     *AT91C_US1_IDR = AT91C_US_RXRDY;
     while(*AT91C_US1_IMR & AT91C_US_RXRDY);
 
-    uart_state.packet_size = *AT91C_US1_RHR & 0xFF;
+    size = *AT91C_US1_RHR & 0xFF;
+    uart_state.packet_size = MIN(size, UART_BUFSIZE);
+    uart_state.buf[0] = uart_state.packet_size;
     *AT91C_US1_RCR = uart_state.packet_size;
 
     /* we reenable the receiving with the PDC */
@@ -78,24 +161,30 @@ static void uart_isr(void) {
 
   if (status & AT91C_US_ENDRX) {
     *AT91C_US1_PTCR = AT91C_PDC_RXTDIS;
-
-    uart_state.callback((U8*)&(uart_state.buf), uart_state.packet_size);
-
-    /* We must put a size != 0 in the RCR register (even if the PDC is disabled for the receiving) */
-    /* else when we try to read manually a value on US1_RHR thanks to the RXRDY interruption
-     * the RXRDY of the CSR seems to never be set to 1 (no value read on the UART ?) */
-    /* TODO : figure this out */
-    *AT91C_US1_RPR = (U32)(&uart_state.buf);
-    *AT91C_US1_RCR = UART_BUFSIZE; /* default size */
-
-    /* we've read a packet, so now we will do a manual reading
-     * to have the next packet size and adapt the PDC RCR register value */
-    *AT91C_US1_IER = AT91C_US_RXRDY;
+    *AT91C_US1_IDR = AT91C_US_ENDRX;
+
+    /* Reception only restarts when the ring has room for a whole
+     * packet. Only a flurry of breaks meanwhile could leave this one
+     * without room, and it is then lost like a garbled packet.
+     */
+    nx_ring_put(&uart_rx_ring, (U8*)uart_state.buf,
+                1 + uart_state.packet_size);
+    nx_work_queue(&uart_rx_work);
+
+    /* Go on receiving if another packet fits, else wait for the
+     * callback to catch up.
+     */
+    if (nx_ring_space(&uart_rx_ring) >= UART_RX_RECORD_MAX)
+      uart_rx_restart();
+    else
+      uart_state.rx_stalled = TRUE;
   }
 }
 
 void nx__uart_init(nx__uart_read_callback_t callback) {
   uart_state.callback = callback;
+  nx_ring_init(&uart_rx_ring, uart_rx_storage, sizeof(uart_rx_storage));
+  nx_work_init(&uart_rx_work, uart_rx_deliver, NULL);
 
   nx_interrupts_disable();
 
@@ -123,7 +212,7 @@ void nx__uart_init(nx__uart_read_callback_t callback) {
    *
    * TODO : figure this out
    */
-  *AT91C_US1_RPR = (U32)(&uart_state.buf);
+  *AT91C_US1_RPR = (U32)(&uart_state.buf[1]);
   *AT91C_US1_RCR = UART_BUFSIZE;
   *AT91C_US1_TPR = 0;
   *AT91C_US1_TCR = 0;
@@ -185,6 +274,14 @@ bool nx__uart_is_writing(void) {
 
 
 void nx__uart_set_callback(nx__uart_read_callback_t callback) {
+  /* Drop the packets waiting for the previous callback, if any.
+   * Neither side of the ring can run meanwhile.
+   */
+  nx_interrupts_disable();
+  nx_ring_consume(&uart_rx_ring, nx_ring_count(&uart_rx_ring));
+  uart_state.rx_stalled = FALSE;
+  nx_interrupts_enable();
+
   if (callback == NULL) {
 
     *AT91C_US1_IDR = AT91C_US_RXRDY | AT91C_US_RXBRK | AT91C_US_ENDRX;
@@ -201,7 +298,7 @@ void nx__uart_set_callback(nx__uart_read_callback_t callback) {
     *AT91C_US1_PTCR = AT91C_PDC_RXTDIS;
 
     *AT91C_US1_RCR = UART_BUFSIZE;
-    *AT91C_US1_RPR = (U32)(&uart_state.buf);
+    *AT91C_US1_RPR = (U32)(&uart_state.buf[1]);
 
     uart_state.callback = callback;
 
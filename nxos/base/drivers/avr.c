@@ -10,14 +10,34 @@
 #include "base/types.h"
 #include "base/util.h"
 #include "base/assert.h"
+#include "base/interrupts.h"
 #include "base/drivers/systick.h"
 #include "base/drivers/_twi.h"
+#include "base/drivers/_sampler.h"
+#include "base/drivers/_buttons.h"
+#include "base/lib/tracing/tracing.h"
 
 #include "base/drivers/_avr.h"
 
 #define AVR_ADDRESS 1
 #define AVR_MAX_FAILED_CHECKSUMS 3
 
+/* How many times in a row the link is resynchronized without a
+ * handshake, before it is restarted from scratch.
+ */
+#define AVR_MAX_RESYNCS 2
+
+/* The longest a transfer may take before it is considered stuck. The
+ * longest one, the handshake, takes about 1.3ms at 380kHz.
+ */
+#define AVR_TWI_TIMEOUT_US 5000
+
+/* The longest the system timer may go without updating the AVR link
+ * when the system is idle. This keeps the button state, sensor
+ * readings and motor commands at most this many milliseconds stale.
+ */
+#define AVR_MAX_IDLE_MS 8
+
 const char avr_init_handshake[] =
   "\xCC" "Let's samba nxt arm in arm, (c)LEGO System A/S";
 
@@ -35,11 +55,30 @@ static volatile struct {
 
   /* Used to detect link failures and restart the AVR link. */
   U8 failed_consecutive_checksums;
+
+  /* Resynchronizations since the last good frame. */
+  U8 resyncs;
+
+  /* When the transfer in progress started, and how long the
+   * transmission of the last commands took, in microseconds.
+   */
+  U32 transfer_start;
+  U32 send_duration;
+
+  /* The start of the current 1 second frame rate window, and the
+   * number of good frames received in it so far.
+   */
+  U32 window_start;
+  U32 window_frames;
 } avr_state = {
   AVR_UNINITIALIZED, /* We start uninitialized. */
   0,                 /* No failed checksums yet. */
+  0, 0, 0, 0, 0,
 };
 
+/* The health of the link, updated by the interrupt handler. */
+static volatile nx_avr_link_stats_t avr_stats;
+
 
 /* Contains all the commands that are periodically sent to the AVR. */
 static volatile struct {
@@ -64,33 +103,32 @@ static volatile struct {
 };
 
 
-/* Contains all the status data periodically received from the AVR. */
+/* The status data periodically received from the AVR, double
+ * buffered. The interrupt handler unpacks each frame into the buffer
+ * that readers aren't using, and publishes it by incrementing the
+ * generation: readers use avr_frames[avr_generation & 1].
+ *
+ * A reader preempted by the handler keeps reading a stable buffer,
+ * unless a second frame arrives before it is done: then the handler
+ * reuses the buffer, and the reader must start over. Frames are
+ * milliseconds apart, so this is rare, and doesn't need interrupts
+ * disabled.
+ */
+static nx_avr_frame_t avr_frames[2];
+static volatile U32 avr_generation = 0;
+
+/* The version of the AVR firmware. The currently supported version
+ * is 1.1.
+ */
 static volatile struct {
-  /* The analog reading of the analog pin on all active sensors. */
-  U16 adc_value[NXT_N_SENSORS];
+  U8 major;
+  U8 minor;
+} avr_version;
 
-  /* The state of the NXT's buttons. Given the way that the buttons
-   * are handled in hardware, only one button is reported pressed at a
-   * time. See the nx_avr_button_t enumeration for values to test for.
-   */
-  U8 buttons;
-
-  /* Battery information. */
-  struct {
-    bool is_aa; /* True if the power supply is AA batteries (as
-                 * opposed to a battery pack).
-                 */
-    U16 charge; /* The remaining battery charge in mV. */
-  } battery;
-
-  /* The version of the AVR firmware. The currently supported version
-   * is 1.1.
-   */
-  struct {
-    U8 major;
-    U8 minor;
-  } version;
-} from_avr;
+/* Keep the compiler from moving memory accesses across the
+ * publication of a frame. The ARM7 itself doesn't reorder them.
+ */
+#define avr_barrier() asm volatile("" ::: "memory")
 
 
 /* The following two arrays hold the data structures above, converted
@@ -163,15 +201,18 @@ static inline U16 unpack_word(U8 *word) {
   return *((U16*)word);
 }
 
-/* Deserialize the AVR data structure in raw_from_avr into the
- * from_avr status structure.
+/* Deserialize the AVR data structure in raw_from_avr into the spare
+ * frame buffer, and publish it. Returns FALSE, publishing nothing, if
+ * the frame is corrupt.
  */
-static void avr_unpack_from_avr(void) {
+static bool avr_unpack_from_avr(void) {
   U8 checksum = 0;
   U16 word;
   U32 voltage;
   U32 i;
   U8 *p = raw_from_avr;
+  U32 generation = avr_generation + 1;
+  nx_avr_frame_t *frame = &avr_frames[generation & 1];
 
   /* Compute the checksum of the received data. This is done by doing
    * the unsigned sum of all the bytes in the received buffer. They
@@ -182,33 +223,39 @@ static void avr_unpack_from_avr(void) {
 
   if (checksum != 0xff) {
     avr_state.failed_consecutive_checksums++;
-    return;
+    avr_stats.checksum_failures++;
+    return FALSE;
   } else {
     avr_state.failed_consecutive_checksums = 0;
+    avr_state.resyncs = 0;
   }
 
+  frame->seq = generation;
+  frame->timestamp = nx_systick_get_us();
+
   /* Unpack and store the 4 sensor analog readings. */
   for (i = 0; i < NXT_N_SENSORS; i++) {
-    from_avr.adc_value[i] = unpack_word(p);
+    frame->adc[i] = unpack_word(p);
     p += 2;
   }
 
   /* Grab the buttons word (an analog reading), and compute the state
-   * of buttons from that.
+   * of buttons from that. Given the way that the buttons are handled
+   * in hardware, only one button is reported pressed at a time.
    */
   word = unpack_word(p);
   p += 2;
 
   if (word > 1023)
-    from_avr.buttons = BUTTON_OK;
+    frame->button = BUTTON_OK;
   else if (word > 720)
-    from_avr.buttons = BUTTON_CANCEL;
+    frame->button = BUTTON_CANCEL;
   else if (word > 270)
-    from_avr.buttons = BUTTON_RIGHT;
+    frame->button = BUTTON_RIGHT;
   else if (word > 60)
-    from_avr.buttons = BUTTON_LEFT;
+    frame->button = BUTTON_LEFT;
   else
-    from_avr.buttons = BUTTON_NONE;
+    frame->button = BUTTON_NONE;
 
   /* Process the last word, which is a mix and match of many
    * values.
@@ -218,9 +265,9 @@ static void avr_unpack_from_avr(void) {
   /* Extract the AVR firmware version, as well as the type of power
    * supply connected.
    */
-  from_avr.version.major = (word >> 13) & 0x3;
-  from_avr.version.minor = (word >> 10) & 0x7;
-  from_avr.battery.is_aa = (word & 0x8000) ? TRUE : FALSE;
+  avr_version.major = (word >> 13) & 0x3;
+  avr_version.minor = (word >> 10) & 0x7;
+  frame->battery_is_aa = (word & 0x8000) ? TRUE : FALSE;
 
   /* The rest of the word is the voltage value, in units of
    * 13.848mV. As the NXT does not have a floating point unit, the
@@ -229,7 +276,78 @@ static void avr_unpack_from_avr(void) {
    */
   voltage = word & 0x3ff;
   voltage = (voltage * 3545) >> 9;
-  from_avr.battery.charge = voltage;
+  frame->battery_mv = voltage;
+
+  avr_barrier();
+  avr_generation = generation;
+
+  return TRUE;
+}
+
+/* Account for a good frame, received @a now. */
+static void avr_count_frame(U32 now) {
+  avr_stats.frames++;
+  avr_stats.latency_us = avr_state.send_duration +
+    nx__twi_get_duration_us();
+  avr_stats.max_latency_us = MAX(avr_stats.max_latency_us,
+                                 avr_stats.latency_us);
+
+  avr_state.window_frames++;
+  if (now - avr_state.window_start >= 1000000) {
+    avr_stats.frames_per_sec = avr_state.window_frames;
+    avr_state.window_frames = 0;
+    avr_state.window_start = now;
+  }
+}
+
+/* Pack the to_avr struct into a raw buffer, and shovel that over the
+ * i2c bus to the AVR.
+ */
+static void avr_send(void) {
+  avr_pack_to_avr();
+  nx__twi_write_async(AVR_ADDRESS, raw_to_avr, sizeof(raw_to_avr));
+  avr_state.transfer_start = nx_systick_get_us();
+  avr_state.mode = AVR_SEND;
+}
+
+/* Recover from a failed exchange with the AVR: too many corrupt
+ * frames, or a transfer that failed or got stuck.
+ *
+ * These are usually transient, and the AVR is still listening, so the
+ * link is first resynchronized: the TWI is reset, and the commands
+ * are sent again right away. Only if that keeps failing is the link
+ * restarted with the handshake, which leaves the motors without
+ * commands for several milliseconds.
+ */
+static void avr_link_error(void) {
+  nx__twi_abort();
+  avr_state.failed_consecutive_checksums = 0;
+
+  if (avr_state.resyncs < AVR_MAX_RESYNCS) {
+    avr_state.resyncs++;
+    avr_stats.resyncs++;
+    avr_send();
+  } else {
+    avr_state.resyncs = 0;
+    avr_stats.resets++;
+    avr_state.mode = AVR_LINK_DOWN;
+  }
+}
+
+/* Check the transfer in progress. Returns TRUE if it is complete,
+ * FALSE if it isn't yet, or failed and was handled.
+ */
+static bool avr_transfer_done(void) {
+  if (nx__twi_ready())
+    return TRUE;
+
+  if (nx__twi_failed() ||
+      nx_systick_get_us() - avr_state.transfer_start > AVR_TWI_TIMEOUT_US) {
+    avr_stats.twi_errors++;
+    avr_link_error();
+  }
+
+  return FALSE;
 }
 
 /* Initialize the NXT-AVR communication. */
@@ -238,6 +356,8 @@ void nx__avr_init(void) {
    * state machine to start transmitting.
    */
   nx__twi_init();
+  nx__buttons_init();
+  avr_state.window_start = nx_systick_get_us();
   avr_state.mode = AVR_LINK_DOWN;
 }
 
@@ -248,6 +368,8 @@ void nx__avr_init(void) {
  * must return as fast as possible.
  */
 void nx__avr_fast_update(void) {
+  U32 now;
+
   /* The action taken depends on the state of the AVR
    * communication.
    */
@@ -268,9 +390,16 @@ void nx__avr_fast_update(void) {
      * other things) stop the "clicking brick" sound, and avoid having
      * the brick powered down after a few minutes by an AVR that
      * doesn't see us coming up.
+     *
+     * The TWI may have been left failed or busy by the exchange that
+     * brought the link down.
      */
+    nx_tracing_add_event(NX_TRACE_INSTANT, NX_TRACE_TRACK_DRIVER,
+                         NX_TRACE_DRIVER_AVR);
+    nx__twi_abort();
     nx__twi_write_async(AVR_ADDRESS, (U8*)avr_init_handshake,
                     sizeof(avr_init_handshake)-1);
+    avr_state.transfer_start = nx_systick_get_us();
     avr_state.failed_consecutive_checksums = 0;
     avr_state.mode = AVR_INIT;
     break;
@@ -280,8 +409,14 @@ void nx__avr_fast_update(void) {
      * millisecond wait, which is accomplished by the use of two
      * intermediate state machine states.
      */
-    if (nx__twi_ready())
+    if (nx__twi_ready()) {
       avr_state.mode = AVR_WAIT_2MS;
+    } else if (nx__twi_failed() || nx_systick_get_us() -
+               avr_state.transfer_start > AVR_TWI_TIMEOUT_US) {
+      avr_stats.twi_errors++;
+      avr_stats.resets++;
+      avr_state.mode = AVR_LINK_DOWN;
+    }
     break;
 
   case AVR_WAIT_2MS:
@@ -300,41 +435,64 @@ void nx__avr_fast_update(void) {
 
   case AVR_SEND:
     /* If the transmission is complete, switch to receive mode and
-     * read the status structure from the AVR.
+     * read the status structure from the AVR. The read can't be
+     * complete before the next update, so don't fall through to
+     * check it: that would unpack an empty buffer.
      */
-    if (nx__twi_ready()) {
+    if (avr_transfer_done()) {
+      avr_state.send_duration = nx__twi_get_duration_us();
       avr_state.mode = AVR_RECV;
+      nx_tracing_add_event(NX_TRACE_BEGIN, NX_TRACE_TRACK_DRIVER,
+                           NX_TRACE_DRIVER_AVR);
       memset(raw_from_avr, 0, sizeof(raw_from_avr));
       nx__twi_read_async(AVR_ADDRESS, raw_from_avr,
                      sizeof(raw_from_avr));
+      avr_state.transfer_start = nx_systick_get_us();
     }
+    break;
 
   case AVR_RECV:
     /* If the transmission is complete, unpack the read data into the
-     * from_avr struct, pack the data in the to_avr struct into a raw
-     * buffer, and shovel that over the i2c bus to the AVR.
+     * spare frame, and send the next commands. If the number of
+     * failed consecutive checksums is over the restart threshold,
+     * consider the link broken and resynchronize it instead.
      */
-    if (nx__twi_ready()) {
-      avr_unpack_from_avr();
-      /* If the number of failed consecutive checksums is over the
-       * restart threshold, consider the link down and reboot the
-       * link. */
-      if (avr_state.failed_consecutive_checksums >= AVR_MAX_FAILED_CHECKSUMS) {
-        avr_state.mode = AVR_LINK_DOWN;
-      } else {
-        avr_state.mode = AVR_SEND;
-        avr_pack_to_avr();
-        nx__twi_write_async(AVR_ADDRESS, raw_to_avr, sizeof(raw_to_avr));
+    if (avr_transfer_done()) {
+      nx_tracing_add_event(NX_TRACE_END, NX_TRACE_TRACK_DRIVER,
+                           NX_TRACE_DRIVER_AVR);
+      if (avr_unpack_from_avr()) {
+        now = avr_frames[avr_generation & 1].timestamp;
+        avr_count_frame(now);
+        nx__sampler_frame(avr_frames[avr_generation & 1].adc, now);
+        nx__buttons_frame(avr_frames[avr_generation & 1].button, now);
       }
+      if (avr_state.failed_consecutive_checksums >= AVR_MAX_FAILED_CHECKSUMS)
+        avr_link_error();
+      else
+        avr_send();
     }
     break;
   }
 }
 
+U32 nx__avr_max_idle_ms(void) {
+  /* The handshake sequence relies on millisecond steps. */
+  if (avr_state.mode != AVR_SEND && avr_state.mode != AVR_RECV)
+    return 1;
+
+  /* Every frame counts while sensors are being sampled, or buttons
+   * debounced.
+   */
+  if (nx__sampler_is_active() || nx__buttons_is_active())
+    return 1;
+
+  return AVR_MAX_IDLE_MS;
+}
+
 U32 nx__avr_get_sensor_value(U32 n) {
   NX_ASSERT(n < NXT_N_SENSORS);
 
-  return from_avr.adc_value[n];
+  return avr_frames[avr_generation & 1].adc[n];
 }
 
 void nx__avr_set_motor(U32 motor, int power_percent, bool brake) {
@@ -357,21 +515,48 @@ void nx__avr_firmware_update_mode(void) {
     to_avr.power_mode = AVR_RESET_MODE;
 }
 
+void nx_avr_get_link_stats(nx_avr_link_stats_t *stats) {
+  NX_ASSERT(stats != NULL);
+
+  nx_interrupts_disable();
+  memcpy(stats, (void*)&avr_stats, sizeof(*stats));
+  nx_interrupts_enable();
+}
+
+void nx_avr_reset_link_stats(void) {
+  nx_interrupts_disable();
+  memset((void*)&avr_stats, 0, sizeof(avr_stats));
+  nx_interrupts_enable();
+}
+
+void nx_avr_get_snapshot(nx_avr_frame_t *frame) {
+  U32 generation;
+
+  NX_ASSERT(frame != NULL);
+
+  do {
+    generation = avr_generation;
+    avr_barrier();
+    memcpy(frame, &avr_frames[generation & 1], sizeof(*frame));
+    avr_barrier();
+  } while (avr_generation - generation >= 2);
+}
+
 nx_avr_button_t nx_avr_get_button(void) {
-  return from_avr.buttons;
+  return nx_buttons_get_state();
 }
 
 U32 nx_avr_get_battery_voltage(void) {
-  return from_avr.battery.charge;
+  return avr_frames[avr_generation & 1].battery_mv;
 }
 
 bool nx_avr_battery_is_aa(void) {
-  return from_avr.battery.is_aa;
+  return avr_frames[avr_generation & 1].battery_is_aa;
 }
 
 void nx_avr_get_version(U8 *major, U8 *minor) {
   if (major)
-    *major = from_avr.version.major;
+    *major = avr_version.major;
   if (minor)
-    *minor = from_avr.version.minor;
+    *minor = avr_version.minor;
 }
@@ -14,6 +14,7 @@
 #define __NXOS_BASE_DRIVERS_AVR_H__
 
 #include "base/types.h"
+#include "base/nxt.h"
 
 /** @addtogroup driver */
 /*@{*/
@@ -37,7 +38,63 @@ typedef enum {
   BUTTON_RIGHT, /**< Right arrow pressed. */
 } nx_avr_button_t;
 
+/** The inputs reported by the coprocessor in one status frame. */
+typedef struct {
+  U32 seq; /**< Sequence number, incremented for every frame. */
+  U32 timestamp; /**< When the frame arrived, in microseconds. */
+  U16 adc[NXT_N_SENSORS]; /**< Raw analog reading of each sensor port. */
+  nx_avr_button_t button; /**< The button pressed, not debounced. */
+  U16 battery_mv; /**< Battery voltage, in millivolts. */
+  bool battery_is_aa; /**< TRUE for AA batteries, FALSE for a pack. */
+} nx_avr_frame_t;
+
+/** Take a snapshot of the last status frame from the coprocessor.
+ *
+ * The frame is coherent: all its values come from the same exchange
+ * with the coprocessor, unlike the results of separate calls to
+ * nx_avr_get_button(), nx_avr_get_battery_voltage() and
+ * nx_sensors_analog_get(). Interrupts are not disabled.
+ *
+ * The sequence number tells whether a new frame arrived since the last
+ * snapshot, and how many were missed.
+ *
+ * @param frame Filled with the last frame. Before the first frame
+ * arrives, its sequence number is 0 and its values are 0.
+ */
+void nx_avr_get_snapshot(nx_avr_frame_t *frame);
+
+/** The health of the link with the coprocessor. */
+typedef struct {
+  U32 frames; /**< Status frames received intact. */
+  U32 frames_per_sec; /**< Frames received intact in the last whole
+                       * second that had any. */
+  U32 checksum_failures; /**< Status frames received corrupt. */
+  U32 twi_errors; /**< Transfers that failed or got stuck. */
+  U32 resyncs; /**< Recoveries that kept sending commands. */
+  U32 resets; /**< Link restarts, with the full handshake. */
+  U32 latency_us; /**< Bus time of the last exchange, in microseconds. */
+  U32 max_latency_us; /**< Longest bus time of an exchange. */
+} nx_avr_link_stats_t;
+
+/** Read the statistics of the link with the coprocessor.
+ *
+ * The link exchanges commands and a status frame about every 2
+ * milliseconds. After a few corrupt frames or a failed transfer, it is
+ * resynchronized without interrupting the flow of motor commands, and
+ * restarted from scratch only if that fails too.
+ *
+ * @param stats Filled with the statistics since boot, or since the
+ * last call to nx_avr_reset_link_stats().
+ */
+void nx_avr_get_link_stats(nx_avr_link_stats_t *stats);
+
+/** Reset the statistics of the link with the coprocessor. */
+void nx_avr_reset_link_stats(void);
+
 /** Return the state of the brick's buttons.
+ *
+ * The state is debounced. To wait for the user's input rather than
+ * poll it, use the button events of buttons.h.
  *
  * @return A <tt>nx_avr_button_t</tt> value.
  *
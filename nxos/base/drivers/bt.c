@@ -11,6 +11,7 @@
 #include "base/types.h"
 #include "base/util.h"
 #include "base/display.h"
+#include "base/completion.h"
 #include "base/drivers/aic.h"
 #include "base/drivers/systick.h"
 #include "base/drivers/_uart.h"
@@ -247,6 +248,11 @@ static volatile struct {
 
 } bt_state;
 
+/* Signaled by the UART callback for every message received from the
+ * bluecore. Kept out of bt_state, which is volatile.
+ */
+static nx_completion_t bt_msg_received;
+
 
 
 
@@ -302,8 +308,21 @@ static bool bt_check_checksum(U8 *msg, U32 len) {
 static bool bt_wait_msg(U8 msg)
 {
   U32 start = nx_systick_get_ms();
-
-  while(bt_state.last_msg != msg && start+BT_ACK_TIMEOUT > nx_systick_get_ms());
+  U32 elapsed;
+
+  while (bt_state.last_msg != msg) {
+    elapsed = nx_systick_get_ms() - start;
+    if (elapsed >= BT_ACK_TIMEOUT)
+      break;
+
+    /* Check again after the reset, or a message coming in between
+     * would be missed.
+     */
+    nx_completion_reset(&bt_msg_received);
+    if (bt_state.last_msg == msg)
+      break;
+    nx_completion_wait(&bt_msg_received, BT_ACK_TIMEOUT - elapsed);
+  }
 
   return bt_state.last_msg == msg;
 }
@@ -352,6 +371,8 @@ static void bt_uart_command_callback(U8 *msg, U32 len)
     bt_state.args[i] = 0;
   }
 
+  nx_completion_signal(&bt_msg_received);
+
 
   if (msg[0] == BT_MSG_HEARTBEAT) {
     bt_state.last_heartbeat = nx_systick_get_ms();
@@ -456,6 +477,7 @@ static void bt_uart_command_callback(U8 *msg, U32 len)
 void nx_bt_init(void)
 {
   memset((void*)&bt_state, 0, sizeof(bt_state));
+  nx_completion_init(&bt_msg_received);
   USB_SEND("nx_bt_init()");
 
   bt_state.new_handle = -1;
@@ -0,0 +1,153 @@
+/* Copyright (c) 2008 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#include "base/types.h"
+#include "base/assert.h"
+#include "base/ring.h"
+#include "base/completion.h"
+
+#include "base/drivers/_buttons.h"
+
+static struct {
+  /* The last reading, and when it was first seen, in microseconds. */
+  nx_avr_button_t candidate;
+  U32 candidate_since;
+
+  /* The debounced state, when it was entered, whether the hold event
+   * was sent, and how long after the press the next repeat is due.
+   */
+  volatile nx_avr_button_t state;
+  U32 pressed_at;
+  bool held;
+  U32 repeat_at;
+
+  /* The events, written by the interrupt handler. */
+  nx_ring_t queue;
+  nx_buttons_event_t queue_buf[NX_BUTTONS_QUEUE_SIZE];
+  U32 overruns;
+
+  /* Signaled when an event is queued. */
+  nx_completion_t ready;
+} buttons;
+
+static void buttons_emit(nx_avr_button_t button,
+                         nx_buttons_event_type_t type, U32 timestamp) {
+  nx_buttons_event_t event;
+
+  event.timestamp = timestamp;
+  event.button = button;
+  event.type = type;
+
+  if (nx_ring_put(&buttons.queue, &event, sizeof(event)))
+    nx_completion_signal(&buttons.ready);
+  else
+    buttons.overruns++;
+}
+
+void nx__buttons_init(void) {
+  buttons.candidate = BUTTON_NONE;
+  buttons.state = BUTTON_NONE;
+  nx_ring_init(&buttons.queue, buttons.queue_buf,
+               sizeof(buttons.queue_buf));
+  nx_completion_init(&buttons.ready);
+}
+
+void nx__buttons_frame(nx_avr_button_t button, U32 timestamp) {
+  U32 held_for;
+
+  if (button != buttons.candidate) {
+    buttons.candidate = button;
+    buttons.candidate_since = timestamp;
+  }
+
+  if (buttons.candidate != buttons.state) {
+    if (timestamp - buttons.candidate_since < NX_BUTTONS_DEBOUNCE_MS * 1000)
+      return;
+
+    /* Only one button is reported at a time, so going from one button
+     * to another releases the first.
+     */
+    if (buttons.state != BUTTON_NONE)
+      buttons_emit(buttons.state, NX_BUTTON_RELEASE, timestamp);
+
+    buttons.state = buttons.candidate;
+    buttons.pressed_at = timestamp;
+    buttons.held = FALSE;
+    buttons.repeat_at = NX_BUTTONS_REPEAT_DELAY_MS * 1000;
+
+    if (buttons.state != BUTTON_NONE)
+      buttons_emit(buttons.state, NX_BUTTON_PRESS, timestamp);
+    return;
+  }
+
+  if (buttons.state == BUTTON_NONE)
+    return;
+
+  held_for = timestamp - buttons.pressed_at;
+
+  if (!buttons.held && held_for >= NX_BUTTONS_HOLD_MS * 1000) {
+    buttons.held = TRUE;
+    buttons_emit(buttons.state, NX_BUTTON_HOLD, timestamp);
+  }
+
+  /* If frames were late, send a single repeat rather than a burst. */
+  if (held_for >= buttons.repeat_at) {
+    buttons_emit(buttons.state, NX_BUTTON_REPEAT, timestamp);
+    buttons.repeat_at += NX_BUTTONS_REPEAT_MS * 1000;
+    if (buttons.repeat_at <= held_for)
+      buttons.repeat_at = held_for + NX_BUTTONS_REPEAT_MS * 1000;
+  }
+}
+
+bool nx__buttons_is_active(void) {
+  return buttons.state != BUTTON_NONE || buttons.candidate != BUTTON_NONE;
+}
+
+nx_avr_button_t nx_buttons_get_state(void) {
+  return buttons.state;
+}
+
+bool nx_buttons_get_event(nx_buttons_event_t *event) {
+  NX_ASSERT(event != NULL);
+
+  return nx_ring_get(&buttons.queue, event, sizeof(*event));
+}
+
+bool nx_buttons_wait_event(nx_buttons_event_t *event, U32 timeout) {
+  NX_ASSERT(event != NULL);
+
+  /* Reset before checking the queue, so that an event queued in
+   * between still wakes us up.
+   */
+  nx_completion_reset(&buttons.ready);
+  if (nx_buttons_get_event(event))
+    return TRUE;
+
+  nx_completion_wait(&buttons.ready, timeout);
+  return nx_buttons_get_event(event);
+}
+
+void nx_buttons_wait_press(nx_avr_button_t button) {
+  nx_buttons_event_t event;
+
+  NX_ASSERT(button != BUTTON_NONE);
+
+  for (;;) {
+    if (nx_buttons_wait_event(&event, NX_COMPLETION_FOREVER) &&
+        event.type == NX_BUTTON_PRESS && event.button == button)
+      return;
+  }
+}
+
+void nx_buttons_flush(void) {
+  nx_ring_consume(&buttons.queue, nx_ring_count(&buttons.queue));
+}
+
+U32 nx_buttons_get_overruns(void) {
+  return buttons.overruns;
+}
@@ -0,0 +1,122 @@
+/** @file buttons.h
+ *  @brief Debounced button events.
+ */
+
+/* Copyright (c) 2008 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#ifndef __NXOS_BASE_DRIVERS_BUTTONS_H__
+#define __NXOS_BASE_DRIVERS_BUTTONS_H__
+
+#include "base/types.h"
+#include "base/completion.h"
+#include "base/drivers/avr.h"
+
+/** @addtogroup driver */
+/*@{*/
+
+/** @defgroup buttons Button events
+ *
+ * The buttons are read by the AVR coprocessor as a single analog
+ * value, decoded into at most one pressed button per status frame.
+ * That decoding glitches while a button goes up or down, so every
+ * frame's reading is debounced: a new state is only accepted once it
+ * has been stable for NX_BUTTONS_DEBOUNCE_MS.
+ *
+ * Changes of the debounced state are turned into events, queued until
+ * the application consumes them. Holding a button down produces
+ * repeat events, and a single hold event once it has been held long
+ * enough. Since events are queued, short presses are not missed
+ * between two polls, and a user interface can sleep until the next
+ * event instead of spinning on nx_avr_get_button().
+ *
+ * The queue holds NX_BUTTONS_QUEUE_SIZE events. When it is full, new
+ * events are dropped.
+ */
+/*@{*/
+
+/** How long a new button state must be stable to be accepted, in
+ * milliseconds.
+ */
+#define NX_BUTTONS_DEBOUNCE_MS 20
+
+/** How long a button must be held for a hold event, in milliseconds. */
+#define NX_BUTTONS_HOLD_MS 1000
+
+/** How long a button must be held before repeat events start, in
+ * milliseconds.
+ */
+#define NX_BUTTONS_REPEAT_DELAY_MS 500
+
+/** The interval between repeat events, in milliseconds. */
+#define NX_BUTTONS_REPEAT_MS 150
+
+/** The number of events the queue holds. */
+#define NX_BUTTONS_QUEUE_SIZE 16
+
+/** The kinds of button events. */
+typedef enum {
+  NX_BUTTON_PRESS = 0, /**< The button went down. */
+  NX_BUTTON_RELEASE, /**< The button went up. */
+  NX_BUTTON_HOLD, /**< The button was held for NX_BUTTONS_HOLD_MS. */
+  NX_BUTTON_REPEAT, /**< The button is still held down. */
+} nx_buttons_event_type_t;
+
+/** A button event. */
+typedef struct {
+  U32 timestamp; /**< When the event happened, in microseconds. */
+  nx_avr_button_t button; /**< The button concerned. */
+  nx_buttons_event_type_t type; /**< What happened to it. */
+} nx_buttons_event_t;
+
+/** Return the debounced state of the buttons.
+ *
+ * @return The button held down, or BUTTON_NONE.
+ */
+nx_avr_button_t nx_buttons_get_state(void);
+
+/** Take the oldest event from the queue, if any.
+ *
+ * Does not block.
+ *
+ * @param event Filled with the event.
+ * @return TRUE if there was an event, FALSE if the queue is empty.
+ */
+bool nx_buttons_get_event(nx_buttons_event_t *event);
+
+/** Wait for an event, and take it from the queue.
+ *
+ * The caller sleeps until the next event (see completion.h).
+ *
+ * @param event Filled with the event.
+ * @param timeout The longest time to wait, in milliseconds, or
+ * NX_COMPLETION_FOREVER.
+ * @return TRUE if there was an event, FALSE on timeout.
+ */
+bool nx_buttons_wait_event(nx_buttons_event_t *event, U32 timeout);
+
+/** Wait for a press of @a button, discarding other events.
+ *
+ * @param button The button to wait for.
+ */
+void nx_buttons_wait_press(nx_avr_button_t button);
+
+/** Discard the queued events.
+ *
+ * Useful before waiting for the user's answer to a new question, so
+ * that presses meant for a previous screen are not taken as answers.
+ */
+void nx_buttons_flush(void);
+
+/** Return the number of events dropped because the queue was full. */
+U32 nx_buttons_get_overruns(void);
+
+/*@}*/
+/*@}*/
+
+#endif /* __NXOS_BASE_DRIVERS_BUTTONS_H__ */
@@ -11,10 +11,14 @@
 #include "base/nxt.h"
 #include "base/interrupts.h"
 #include "base/util.h"
+#include "base/assert.h"
 #include "base/display.h"
+#include "base/completion.h"
+#include "base/lock.h"
 #include "base/drivers/aic.h"
 #include "base/drivers/_sensors.h"
 #include "base/drivers/i2c.h"
+#include "base/lib/tracing/tracing.h"
 
 /** The base clock frequency of the sensor I2C bus in Hz. */
 #define I2C_BUS_SPEED 9600
@@ -115,8 +119,25 @@ static volatile struct i2c_port {
 
 } i2c_state[NXT_N_SENSORS];
 
+/* Signaled by the interrupt handler when a port's transaction is
+ * over. Kept out of i2c_state, which is volatile.
+ */
+static nx_completion_t i2c_done[NXT_N_SENSORS];
+
+/* The requests queued on each port, oldest first. The head is on the
+ * bus while active is set. running is set from the start of any
+ * transaction until the interrupt handler has processed its end.
+ */
+static struct {
+  nx_i2c_request_t *head, *tail;
+  bool active;
+  bool running;
+  U32 completed;
+} i2c_requests[NXT_N_SENSORS];
+
 /* Forward declarations. */
 static void i2c_isr(void);
+static void i2c_txn_over(U32 sensor);
 static void i2c_log(const char *s);
 static void i2c_log_uint(U32 val);
 
@@ -124,7 +145,12 @@ static void i2c_log_uint(U32 val);
  * and set the interrupt handler.
  */
 void nx_i2c_init(void) {
+  U32 sensor;
+
   memset((void*)i2c_state, 0, sizeof(i2c_state));
+  memset(i2c_requests, 0, sizeof(i2c_requests));
+  for (sensor = 0; sensor < NXT_N_SENSORS; sensor++)
+    nx_completion_init(&i2c_done[sensor]);
   nx_interrupts_disable();
 
   /* We need power for both the PIO controller and the first TC (Timer
@@ -199,6 +225,8 @@ void nx_i2c_register(U32 sensor, U8 address, bool lego_compat) {
   p->addr[TXN_MODE_WRITE] = (address << 1) | TXN_MODE_WRITE;
   p->addr[TXN_MODE_READ] = (address << 1) | TXN_MODE_READ;
 
+  i2c_requests[sensor].completed = 0;
+
   /* Reset the bus transaction structures and parameters. */
   //memset((U8 *)i2c_state[sensor].txns, 0,
   //  I2C_MAX_TXN*sizeof(struct i2c_txn_info));
@@ -258,10 +286,22 @@ static i2c_txn_err i2c_trigger(U32 sensor) {
   return I2C_ERR_OK;
 }
 
-/** Start a new I2C transaction.
- *
- * If the I2C bus is available, a new transaction (consisting in 2 to 4
- * sub transactions) will be performed.
+/** Check the parameters of a transaction. */
+static i2c_txn_err i2c_check_txn(i2c_txn_mode mode,
+                                 const U8 *data, U32 data_size,
+                                 U8 *recv_buf, U32 recv_size)
+{
+  /* In any case, data must be initialized, and with a known data size. */
+  if (!data || !data_size)
+    return I2C_ERR_DATA;
+
+  if (mode == TXN_MODE_READ && (!recv_buf || !recv_size))
+    return I2C_ERR_DATA;
+
+  return I2C_ERR_OK;
+}
+
+/** Configure and trigger the sub transactions of a transaction.
  *
  * For a write transaction, two sub transactions will be performed. The data
  * and data_size parameters must be provided, initialized and containing the
@@ -273,28 +313,25 @@ static i2c_txn_err i2c_trigger(U32 sensor) {
  * parameters must be initialized. The recv_buf must be able to contain the
  * recv_size bytes that will be read from the bus.
  *
- * Returns an i2c_txn_err error code.
+ * Must be called with interrupts masked, on a port that isn't busy.
  */
-i2c_txn_err nx_i2c_start_transaction(U32 sensor, i2c_txn_mode mode,
-				     const U8 *data, U32 data_size,
-				     U8 *recv_buf, U32 recv_size)
+static void i2c_setup_txn(U32 sensor, i2c_txn_mode mode,
+                          const U8 *data, U32 data_size,
+                          U8 *recv_buf, U32 recv_size)
 {
   volatile struct i2c_txn_info *t;
 
-  if (sensor >= NXT_N_SENSORS)
-    return I2C_ERR_UNKNOWN_SENSOR;
-
-  if (nx_i2c_busy(sensor))
-    return I2C_ERR_NOT_READY;
-
-  /* In any case, data must be initialized, and with a known data size. */
-  if (!data || !data_size)
-    return I2C_ERR_DATA;
-
-  if (mode == TXN_MODE_READ && (!recv_buf || !recv_size))
-    return I2C_ERR_DATA;
+  /* The end of the previous transaction may not have been processed
+   * by the interrupt handler yet.
+   */
+  if (i2c_requests[sensor].running)
+    i2c_txn_over(sensor);
 
   i2c_state[sensor].bus_state = I2C_CONFIG;
+  nx_completion_reset(&i2c_done[sensor]);
+  i2c_requests[sensor].running = TRUE;
+  nx_tracing_add_event(NX_TRACE_BEGIN, NX_TRACE_TRACK_DRIVER,
+                       NX_TRACE_DRIVER_I2C0 + sensor);
 
   t = i2c_state[sensor].txns;
   i2c_state[sensor].current_txn = 0;
@@ -317,9 +354,11 @@ i2c_txn_err nx_i2c_start_transaction(U32 sensor, i2c_txn_mode mode,
 
   /* If this is a read transaction, write the device address on the bus
    * and switch to read mode, storing the received bytes in the provided
-   * buffer ; ending with a STOP.
+   * buffer ; ending with a STOP. The received bits are ORed into the
+   * buffer, so it must start cleared.
    */
   if (mode == TXN_MODE_READ) {
+    memset(recv_buf, 0, recv_size);
     i2c_add_txn(sensor, TXN_MODE_WRITE,
                 (U8*)&(i2c_state[sensor].addr[TXN_MODE_READ]), 1,
                 I2C_CONTROL_RESTART, I2C_CONTROL_NONE);
@@ -331,9 +370,137 @@ i2c_txn_err nx_i2c_start_transaction(U32 sensor, i2c_txn_mode mode,
   *AT91C_TC0_IER = AT91C_TC_CPCS;
 
   i2c_trigger(sensor);
+}
+
+/** Start a new I2C transaction.
+ *
+ * If the I2C bus is available and no requests are queued on it, a new
+ * transaction (consisting in 2 to 4 sub transactions) will be performed.
+ *
+ * Returns an i2c_txn_err error code.
+ */
+i2c_txn_err nx_i2c_start_transaction(U32 sensor, i2c_txn_mode mode,
+				     const U8 *data, U32 data_size,
+				     U8 *recv_buf, U32 recv_size)
+{
+  i2c_txn_err err;
+  U32 state;
+
+  if (sensor >= NXT_N_SENSORS)
+    return I2C_ERR_UNKNOWN_SENSOR;
+
+  err = i2c_check_txn(mode, data, data_size, recv_buf, recv_size);
+  if (err != I2C_ERR_OK)
+    return err;
+
+  /* The interrupt handler starts queued requests, so the port has to
+   * be checked in the same critical section that takes it.
+   */
+  state = nx_critical_enter();
+  if (nx_i2c_busy(sensor) || i2c_requests[sensor].head) {
+    nx_critical_exit(state);
+    return I2C_ERR_NOT_READY;
+  }
+  i2c_setup_txn(sensor, mode, data, data_size, recv_buf, recv_size);
+  nx_critical_exit(state);
+
+  return I2C_ERR_OK;
+}
+
+/** Put the request at the head of the queue on the bus. */
+static void i2c_start_request(U32 sensor) {
+  nx_i2c_request_t *req = i2c_requests[sensor].head;
+
+  i2c_requests[sensor].active = TRUE;
+  i2c_setup_txn(sensor, req->mode, req->data, req->data_size,
+                req->recv_buf, req->recv_size);
+}
+
+/** Process the end of the transaction on the bus: wake up its waiter,
+ * and complete its request if it was one.
+ */
+static void i2c_txn_over(U32 sensor) {
+  volatile struct i2c_port *p = &i2c_state[sensor];
+  nx_i2c_request_t *req;
+  i2c_txn_status status = TXN_STAT_SUCCESS;
+  U32 i;
+
+  i2c_requests[sensor].running = FALSE;
+  i2c_requests[sensor].completed++;
+  nx_tracing_add_event(NX_TRACE_END, NX_TRACE_TRACK_DRIVER,
+                       NX_TRACE_DRIVER_I2C0 + sensor);
+  nx_completion_signal(&i2c_done[sensor]);
+
+  if (!i2c_requests[sensor].active)
+    return;
+
+  for (i = 0; i < p->n_txns; i++)
+    if (p->txns[i].result == TXN_STAT_FAILED)
+      status = TXN_STAT_FAILED;
+
+  req = i2c_requests[sensor].head;
+  i2c_requests[sensor].head = req->next;
+  if (i2c_requests[sensor].head == NULL)
+    i2c_requests[sensor].tail = NULL;
+  i2c_requests[sensor].active = FALSE;
+
+  req->status = status;
+  nx_completion_signal(&req->done);
+  if (req->callback)
+    req->callback(req);
+}
+
+i2c_txn_err nx_i2c_submit(U32 sensor, nx_i2c_request_t *req)
+{
+  i2c_txn_err err;
+  U32 state;
+
+  if (sensor >= NXT_N_SENSORS || i2c_state[sensor].bus_state == I2C_OFF)
+    return I2C_ERR_UNKNOWN_SENSOR;
+
+  if (!req)
+    return I2C_ERR_DATA;
+
+  err = i2c_check_txn(req->mode, req->data, req->data_size,
+                      req->recv_buf, req->recv_size);
+  if (err != I2C_ERR_OK)
+    return err;
+
+  req->status = TXN_STAT_IN_PROGRESS;
+  req->next = NULL;
+  nx_completion_init(&req->done);
+
+  /* Also called from request callbacks, in the interrupt handler. */
+  state = nx_critical_enter();
+  if (i2c_requests[sensor].tail)
+    i2c_requests[sensor].tail->next = req;
+  else
+    i2c_requests[sensor].head = req;
+  i2c_requests[sensor].tail = req;
+
+  if (!i2c_requests[sensor].active && !nx_i2c_busy(sensor))
+    i2c_start_request(sensor);
+  nx_critical_exit(state);
+
   return I2C_ERR_OK;
 }
 
+i2c_txn_status nx_i2c_request_wait(nx_i2c_request_t *req, U32 timeout)
+{
+  NX_ASSERT(req != NULL);
+
+  nx_completion_wait(&req->done, timeout);
+  return req->status;
+}
+
+U32 nx_i2c_get_completed(U32 sensor)
+{
+  if (sensor >= NXT_N_SENSORS)
+    return 0;
+
+  return i2c_requests[sensor].completed;
+}
+
 /** Retrieve the transaction status for the given sensor.
  */
 i2c_txn_status nx_i2c_get_txn_status(U32 sensor)
@@ -373,6 +540,17 @@ bool nx_i2c_busy(U32 sensor)
     || i2c_state[sensor].current_txn < i2c_state[sensor].n_txns;
 }
 
+bool nx_i2c_wait(U32 sensor, U32 timeout)
+{
+  if (sensor >= NXT_N_SENSORS)
+    return TRUE;
+
+  if (nx_i2c_busy(sensor))
+    nx_completion_wait(&i2c_done[sensor], timeout);
+
+  return !nx_i2c_busy(sensor);
+}
+
 /** Sets the I2C bus state for the given sensor to the provided state.
  *
  * This function takes into account the lego_compat parameter of the given
@@ -732,6 +910,17 @@ static void i2c_isr(void) {
         break;
       }
 
+    /* Wake up the waiter once the whole transaction is over, including
+     * the final pause of LEGO compatible devices, and put the next
+     * queued request on the bus right away.
+     */
+    if (p->bus_state == I2C_IDLE && p->current_txn >= p->n_txns) {
+      if (i2c_requests[sensor].running)
+        i2c_txn_over(sensor);
+      if (i2c_requests[sensor].head && !i2c_requests[sensor].active)
+        i2c_start_request(sensor);
+    }
+
     /** Update CODR and SODR to reflect changes for this sensor's
      * pins. */
     if (codr)
@@ -16,6 +16,7 @@
 #define __NXOS_I2C_H__
 
 #include "base/types.h"
+#include "base/completion.h"
 
 /** @addtogroup driver */
 /*@{*/
@@ -24,6 +25,13 @@
  *
  * The I2C SoftMAC driver allows I2C communication over the NXT sensor
  * ports.
+ *
+ * A port runs one transaction at a time. nx_i2c_start_transaction()
+ * starts one if the port is free. Alternatively, transactions can be
+ * submitted as requests with nx_i2c_submit(): each port queues its
+ * requests, and the interrupt handler starts the next one as soon as
+ * the previous one is over, so a batch of requests on all four ports
+ * runs back-to-back without the caller polling in between.
  */
 /*@{*/
 
@@ -153,6 +161,84 @@ i2c_txn_status nx_i2c_get_txn_status(U32 sensor);
  */
 bool nx_i2c_busy(U32 sensor);
 
+/** Wait for the end of the transaction on port @a sensor.
+ *
+ * The caller sleeps until the interrupt handler signals the end of the
+ * transaction: under an application kernel that supports it, other
+ * tasks run in the meantime (see completion.h).
+ *
+ * @param sensor The sensor port number.
+ * @param timeout The longest time to wait, in milliseconds, or
+ * NX_COMPLETION_FOREVER.
+ *
+ * @return TRUE if the bus is ready again, FALSE on timeout.
+ */
+bool nx_i2c_wait(U32 sensor, U32 timeout);
+
+/** A queued I2C transaction.
+ *
+ * Requests are allocated by the caller, and must stay allocated until
+ * they complete. Set the public fields before nx_i2c_submit(); the
+ * others are private.
+ */
+typedef struct nx_i2c_request {
+  i2c_txn_mode mode; /**< Read or write. */
+  const U8 *data; /**< The data to send, or the command before a read. */
+  U32 data_size; /**< The size of @a data. */
+  U8 *recv_buf; /**< Receives the data read, in a read transaction. */
+  U32 recv_size; /**< The number of bytes to read. */
+
+  /** Called by the interrupt handler when the request completes, or
+   * NULL. It must return quickly, and may submit another request.
+   */
+  void (*callback)(struct nx_i2c_request *req);
+  void *arg; /**< Free for the caller's use, for example by @a callback. */
+
+  /** The result of the request, TXN_STAT_IN_PROGRESS until it
+   * completes.
+   */
+  volatile i2c_txn_status status;
+
+  nx_completion_t done; /**< Signaled when the request completes. */
+  struct nx_i2c_request *next; /**< Next request in the port's queue. */
+} nx_i2c_request_t;
+
+/** Queue request @a req on port @a sensor.
+ *
+ * The request runs after those already queued on the port, and after
+ * the transaction started with nx_i2c_start_transaction(), if any.
+ * This function returns immediately: wait for the request with
+ * nx_i2c_request_wait(), or handle its completion in its callback.
+ *
+ * @param sensor The sensor port number.
+ * @param req The request.
+ *
+ * @return I2C_ERR_OK if the request was queued. Otherwise, the
+ * appropriate error code (see i2c_txn_err).
+ */
+i2c_txn_err nx_i2c_submit(U32 sensor, nx_i2c_request_t *req);
+
+/** Wait for the completion of request @a req.
+ *
+ * The caller sleeps until the request completes (see completion.h).
+ *
+ * @param req The request.
+ * @param timeout The longest time to wait, in milliseconds, or
+ * NX_COMPLETION_FOREVER.
+ *
+ * @return The status of the request: TXN_STAT_IN_PROGRESS on timeout.
+ */
+i2c_txn_status nx_i2c_request_wait(nx_i2c_request_t *req, U32 timeout);
+
+/** Return the number of transactions completed on port @a sensor since
+ * it was registered, whether they succeeded or not.
+ *
+ * Sampled over a period of time, gives the port's transaction rate.
+ *
+ * @param sensor The sensor port number.
+ */
+U32 nx_i2c_get_completed(U32 sensor);
+
 /*@}*/
 /*@}*/
 
@@ -13,14 +13,10 @@
 #include "base/util.h"
 #include "base/display.h"
 #include "base/drivers/sensors.h"
-#include "base/drivers/systick.h"
 #include "base/drivers/i2c.h"
 
 #include "base/drivers/i2c_memory.h"
 
-/** Active waiting time before I2C transactions, in milliseconds. */
-#define NX_I2C_TXN_WAIT 10
-
 /** Initializes a remote memory unit of address 'address' on the given
  * sensor port.
  *
@@ -45,20 +41,25 @@ void nx_i2c_memory_close(U32 sensor) {
  */
 i2c_txn_err nx_i2c_memory_read(U32 sensor, U8 internal_address,
 			       U8 *buf, U32 size) {
+  nx_i2c_request_t req;
   i2c_txn_err err;
 
   if (!buf || !size || size >= I2C_MAX_DATA_SIZE)
     return I2C_ERR_DATA;
 
-  err = nx_i2c_start_transaction(sensor, TXN_MODE_READ,
-				 &internal_address, 1, buf, size);
+  memset(&req, 0, sizeof(req));
+  req.mode = TXN_MODE_READ;
+  req.data = &internal_address;
+  req.data_size = 1;
+  req.recv_buf = buf;
+  req.recv_size = size;
+
+  /* Queue behind the requests of other users of the port, if any. */
+  err = nx_i2c_submit(sensor, &req);
   if (err != I2C_ERR_OK)
     return err;
 
-  while (nx_i2c_busy(sensor))
-    nx_systick_wait_ms(NX_I2C_TXN_WAIT);
-
-  return nx_i2c_get_txn_status(sensor);
+  return nx_i2c_request_wait(&req, NX_COMPLETION_FOREVER);
 }
 
 /** Writes the given data of the given size at 'internal_address' on the
@@ -66,6 +67,7 @@ i2c_txn_err nx_i2c_memory_read(U32 sensor, U8 internal_address,
  */
 i2c_txn_err nx_i2c_memory_write(U32 sensor, U8 internal_address,
 				const U8 *data, U32 size) {
+  nx_i2c_request_t req;
   U8 buf[I2C_MAX_DATA_SIZE];
   i2c_txn_err err;
 
@@ -75,13 +77,14 @@ i2c_txn_err nx_i2c_memory_write(U32 sensor, U8 internal_address,
   buf[0] = internal_address;
   memcpy(buf+1, data, size);
 
-  err = nx_i2c_start_transaction(sensor, TXN_MODE_WRITE,
-				 buf, size+1, 0, 0);
+  memset(&req, 0, sizeof(req));
+  req.mode = TXN_MODE_WRITE;
+  req.data = buf;
+  req.data_size = size+1;
+
+  err = nx_i2c_submit(sensor, &req);
   if (err != I2C_ERR_OK)
     return err;
 
-  while (nx_i2c_busy(sensor))
-    nx_systick_wait_ms(NX_I2C_TXN_WAIT);
-
-  return nx_i2c_get_txn_status(sensor);
+  return nx_i2c_request_wait(&req, NX_COMPLETION_FOREVER);
 }
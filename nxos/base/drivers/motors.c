@@ -12,7 +12,7 @@
 #include "base/nxt.h"
 #include "base/interrupts.h"
 #include "base/assert.h"
-#include "base/drivers/systick.h"
+#include "base/timer.h"
 #include "base/drivers/aic.h"
 #include "base/drivers/_avr.h"
 
@@ -68,10 +68,9 @@ static volatile struct {
   U32 current_count;
 
   /* The target is a mode-dependent value.
-   *  - In stop and continuous mode, it is not used.
    *  - In angle mode, holds the target tachymeter count.
-   *  - In time mode, holds the remaining number of milliseconds to
-   *    run.
+   *  - In the other modes, it is not used. Time mode is ended by the
+   *    motor's timer.
    */
   U32 target;
 } motors_state[NXT_N_MOTORS] = {
@@ -80,6 +79,18 @@ static volatile struct {
   { MOTOR_STOP, TRUE, 0, 0 },
 };
 
+/* The end of timed rotations. The timers fire whether the motor
+ * turns or not, so a stalled motor still stops on time.
+ */
+static nx_timer_t motors_timers[NXT_N_MOTORS];
+
+static void motors_time_expired(void *arg) {
+  U8 motor = (U32)arg;
+
+  if (motors_state[motor].mode == MOTOR_ON_TIME)
+    nx_motors_stop(motor, motors_state[motor].brake);
+}
+
 /* Tachymeter interrupt handler, triggered by a change of value of a
  * tachymeter pin.
  */
@@ -87,17 +98,11 @@ static void motors_isr(void) {
   int i;
   U32 changes;
   U32 pins;
-  U32 time;
 
   /* Acknowledge the interrupt and grab the state of the pins. */
   changes = *AT91C_PIOA_ISR;
   pins = *AT91C_PIOA_PDSR;
 
-  /* Grab the time, as we're going to use it to check for timed
-   * rotation end.
-   */
-  time = nx_systick_get_ms();
-
   /* Check each motor's tachymeter. */
   for (i=0; i<NXT_N_MOTORS; i++) {
     if (changes & motors_pinmap[i].tach) {
@@ -117,12 +122,10 @@ static void motors_isr(void) {
 
       /* If we are in angle rotation mode, check to see if we've
        * reached the target tachymeter value. If so, shut down the
-       * motor.
+       * motor right away, every tick counts.
        */
-      if ((motors_state[i].mode == MOTOR_ON_ANGLE &&
-           motors_state[i].current_count == motors_state[i].target) ||
-          (motors_state[i].mode == MOTOR_ON_TIME &&
-           time >= motors_state[i].target))
+      if (motors_state[i].mode == MOTOR_ON_ANGLE &&
+          motors_state[i].current_count == motors_state[i].target)
         nx_motors_stop(i, motors_state[i].brake);
     }
   }
@@ -130,6 +133,12 @@ static void motors_isr(void) {
 
 void nx__motors_init(void)
 {
+  U32 i;
+
+  for (i=0; i<NXT_N_MOTORS; i++)
+    nx_timer_init(&motors_timers[i], motors_time_expired, (void*)i,
+                  NX_TIMER_IRQ);
+
   nx_interrupts_disable();
 
   /* Enable the PIO controller. */
@@ -163,6 +172,7 @@ void nx_motors_stop(U8 motor, bool brake) {
   NX_ASSERT(motor < NXT_N_MOTORS);
 
   motors_state[motor].mode = MOTOR_STOP;
+  nx_timer_cancel(&motors_timers[motor]);
   nx__avr_set_motor(motor, 0, brake);
 }
 
@@ -179,6 +189,7 @@ void nx_motors_rotate(U8 motor, S8 speed) {
    * mode and fire up the motor.
    */
   motors_state[motor].mode = MOTOR_ON_CONTINUOUS;
+  nx_timer_cancel(&motors_timers[motor]);
   nx__avr_set_motor(motor, speed, FALSE);
 }
 
@@ -215,6 +226,7 @@ void nx_motors_rotate_angle(U8 motor, S8 speed, U32 angle, bool brake) {
    */
   motors_state[motor].brake = brake;
   motors_state[motor].mode = MOTOR_ON_ANGLE;
+  nx_timer_cancel(&motors_timers[motor]);
   nx__avr_set_motor(motor, speed, FALSE);
 }
 
@@ -236,16 +248,15 @@ void nx_motors_rotate_time(U8 motor, S8 speed, U32 ms, bool brake) {
    * handler will ignore the motor while we tweak its settings.
    */
   motors_state[motor].mode = MOTOR_CONFIGURING;
+  nx_timer_cancel(&motors_timers[motor]);
 
-  /* Set the target system time. */
-  motors_state[motor].target = nx_systick_get_ms() + ms;
-
-  /* Remember the brake setting, change to angle target mode and fire
-   * up the motor.
+  /* Remember the brake setting, change to time target mode, fire up
+   * the motor and arm its timer.
    */
   motors_state[motor].brake = brake;
   motors_state[motor].mode = MOTOR_ON_TIME;
   nx__avr_set_motor(motor, speed, FALSE);
+  nx_timer_start(&motors_timers[motor], ms, 0);
 }
 
 U32 nx_motors_get_tach_count(U8 motor) {
@@ -0,0 +1,185 @@
+/* Copyright (c) 2008 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#include "base/types.h"
+#include "base/nxt.h"
+#include "base/util.h"
+#include "base/assert.h"
+#include "base/interrupts.h"
+#include "base/ring.h"
+#include "base/completion.h"
+#include "base/drivers/systick.h"
+
+#include "base/drivers/_sampler.h"
+
+static struct {
+  nx_ring_t ring; /* The samples, written by the interrupt handler. */
+  U32 period; /* The sampling period, in microseconds. */
+  nx_sampler_mode_t mode;
+  U32 overruns;
+
+  /* The window being accumulated. */
+  U32 window_start;
+  U32 sum;
+  U16 min, max, last, readings;
+
+  /* The reader sleeping in nx_sampler_wait(), if any: the number of
+   * samples it waits for, and what it waits on.
+   */
+  volatile U32 watermark;
+  nx_completion_t ready;
+} sampler_ports[NXT_N_SENSORS];
+
+/* Bit N is set while port N is being sampled. */
+static volatile U32 sampler_active = 0;
+
+/* Close the current window of port @a sensor, and queue its sample. */
+static void sampler_emit(U32 sensor, U32 timestamp) {
+  nx_sample_t sample;
+  U32 ready;
+
+  sample.timestamp = timestamp;
+  sample.min = sampler_ports[sensor].min;
+  sample.max = sampler_ports[sensor].max;
+  sample.readings = sampler_ports[sensor].readings;
+  if (sampler_ports[sensor].mode == NX_SAMPLER_AVERAGE)
+    sample.value = (sampler_ports[sensor].sum + sample.readings / 2) /
+      sample.readings;
+  else
+    sample.value = sampler_ports[sensor].last;
+
+  if (!nx_ring_put(&sampler_ports[sensor].ring, &sample, sizeof(sample)))
+    sampler_ports[sensor].overruns++;
+  sampler_ports[sensor].readings = 0;
+
+  ready = nx_ring_count(&sampler_ports[sensor].ring) / sizeof(sample);
+  if (sampler_ports[sensor].watermark != 0 &&
+      ready >= sampler_ports[sensor].watermark) {
+    sampler_ports[sensor].watermark = 0;
+    nx_completion_signal(&sampler_ports[sensor].ready);
+  }
+}
+
+/* Add a reading to the current window of port @a sensor. */
+static void sampler_feed(U32 sensor, U16 value, U32 timestamp) {
+  if (sampler_ports[sensor].readings == 0) {
+    sampler_ports[sensor].sum = 0;
+    sampler_ports[sensor].min = value;
+    sampler_ports[sensor].max = value;
+  }
+  sampler_ports[sensor].sum += value;
+  sampler_ports[sensor].min = MIN(sampler_ports[sensor].min, value);
+  sampler_ports[sensor].max = MAX(sampler_ports[sensor].max, value);
+  sampler_ports[sensor].last = value;
+  sampler_ports[sensor].readings++;
+
+  if (timestamp - sampler_ports[sensor].window_start <
+      sampler_ports[sensor].period)
+    return;
+
+  sampler_emit(sensor, timestamp);
+
+  /* Keep the windows in phase, unless the link stalled for more than
+   * a period: then start over from now rather than emit a burst of
+   * empty windows.
+   */
+  sampler_ports[sensor].window_start += sampler_ports[sensor].period;
+  if (timestamp - sampler_ports[sensor].window_start >=
+      sampler_ports[sensor].period)
+    sampler_ports[sensor].window_start = timestamp;
+}
+
+void nx__sampler_frame(const U16 *adc, U32 timestamp) {
+  U32 i;
+
+  for (i = 0; i < NXT_N_SENSORS; i++)
+    if (sampler_active & (1 << i))
+      sampler_feed(i, adc[i], timestamp);
+}
+
+bool nx__sampler_is_active(void) {
+  return sampler_active != 0;
+}
+
+void nx_sampler_start(U32 sensor, U32 rate, nx_sampler_mode_t mode,
+                      nx_sample_t *buf, U32 n_samples) {
+  NX_ASSERT(sensor < NXT_N_SENSORS);
+  NX_ASSERT(rate > 0 && rate <= NX_SAMPLER_MAX_RATE);
+  NX_ASSERT(buf != NULL && n_samples > 0);
+
+  nx_interrupts_disable();
+  sampler_active &= ~(1 << sensor);
+
+  nx_ring_init(&sampler_ports[sensor].ring, buf,
+               n_samples * sizeof(nx_sample_t));
+  sampler_ports[sensor].period = 1000000 / rate;
+  sampler_ports[sensor].mode = mode;
+  sampler_ports[sensor].overruns = 0;
+  sampler_ports[sensor].readings = 0;
+  sampler_ports[sensor].window_start = nx_systick_get_us();
+  sampler_ports[sensor].watermark = 0;
+  nx_completion_init(&sampler_ports[sensor].ready);
+
+  sampler_active |= (1 << sensor);
+  nx_interrupts_enable();
+}
+
+void nx_sampler_stop(U32 sensor) {
+  NX_ASSERT(sensor < NXT_N_SENSORS);
+
+  nx_interrupts_disable();
+  sampler_active &= ~(1 << sensor);
+  nx_interrupts_enable();
+}
+
+U32 nx_sampler_available(U32 sensor) {
+  NX_ASSERT(sensor < NXT_N_SENSORS);
+
+  if (!(sampler_active & (1 << sensor)))
+    return 0;
+  return nx_ring_count(&sampler_ports[sensor].ring) / sizeof(nx_sample_t);
+}
+
+U32 nx_sampler_read(U32 sensor, nx_sample_t *samples, U32 max) {
+  U32 n = MIN(nx_sampler_available(sensor), max);
+
+  /* Samples are put whole, so the ring holds a whole number of them. */
+  return nx_ring_read(&sampler_ports[sensor].ring, samples,
+                      n * sizeof(nx_sample_t)) / sizeof(nx_sample_t);
+}
+
+bool nx_sampler_wait(U32 sensor, U32 count, U32 timeout) {
+  NX_ASSERT(sensor < NXT_N_SENSORS);
+  NX_ASSERT(sampler_active & (1 << sensor));
+  NX_ASSERT(count > 0 && count <=
+            sampler_ports[sensor].ring.size / sizeof(nx_sample_t));
+
+  /* Check and arm the watermark atomically, so that the interrupt
+   * handler can't fill the ring in between and never signal.
+   */
+  nx_completion_reset(&sampler_ports[sensor].ready);
+  nx_interrupts_disable();
+  if (nx_sampler_available(sensor) >= count) {
+    nx_interrupts_enable();
+    return TRUE;
+  }
+  sampler_ports[sensor].watermark = count;
+  nx_interrupts_enable();
+
+  if (nx_completion_wait(&sampler_ports[sensor].ready, timeout))
+    return TRUE;
+
+  sampler_ports[sensor].watermark = 0;
+  return nx_sampler_available(sensor) >= count;
+}
+
+U32 nx_sampler_get_overruns(U32 sensor) {
+  NX_ASSERT(sensor < NXT_N_SENSORS);
+
+  return sampler_ports[sensor].overruns;
+}
@@ -0,0 +1,126 @@
+/** @file sampler.h
+ *  @brief Analog sensor sampling service.
+ */
+
+/* Copyright (c) 2008 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#ifndef __NXOS_BASE_DRIVERS_SAMPLER_H__
+#define __NXOS_BASE_DRIVERS_SAMPLER_H__
+
+#include "base/types.h"
+#include "base/completion.h"
+
+/** @addtogroup driver */
+/*@{*/
+
+/** @defgroup sampler Sensor sampling
+ *
+ * The sampler records the analog readings of sensor ports at a
+ * steady rate, into a ring of timestamped samples per port.
+ *
+ * The AVR coprocessor sends the readings of all four ports in a status
+ * frame, about every 2 milliseconds. The sampler looks at every frame
+ * that arrives intact, and groups the frames in windows of the
+ * requested sampling period. Each window produces one sample: the
+ * last reading or the average of the window's readings, the lowest
+ * and highest readings, and the time of the last frame. Since a
+ * sample never holds more than one frame's worth of news, rates above
+ * the frame rate just produce one sample per frame.
+ *
+ * Samples are read in batches, by one reader per port. A reader can
+ * sleep until a batch is ready, instead of polling. If the reader
+ * falls behind and the ring fills up, new samples are dropped and
+ * counted as overruns.
+ *
+ * The port must be in analog mode (see nx_sensors_analog_enable()).
+ */
+/*@{*/
+
+/** How a sample's value is computed from the readings of its window. */
+typedef enum {
+  NX_SAMPLER_LATEST = 0, /**< The last reading of the window. */
+  NX_SAMPLER_AVERAGE, /**< The average of the window's readings. */
+} nx_sampler_mode_t;
+
+/** A sample of an analog sensor. */
+typedef struct {
+  U32 timestamp; /**< When the last reading arrived, in microseconds. */
+  U16 value; /**< The reading, according to the sampling mode. */
+  U16 min; /**< The lowest reading of the window. */
+  U16 max; /**< The highest reading of the window. */
+  U16 readings; /**< The number of readings in the window. */
+} nx_sample_t;
+
+/** The highest sampling rate that can be requested, in Hz. */
+#define NX_SAMPLER_MAX_RATE 1000
+
+/** Start sampling port @a sensor.
+ *
+ * Any sampling already going on on the port is stopped first.
+ *
+ * @param sensor The sensor port.
+ * @param rate The sampling rate in Hz, 1 to NX_SAMPLER_MAX_RATE.
+ * @param mode How the samples are computed.
+ * @param buf The storage of the ring of samples. It must stay allocated
+ * until sampling stops.
+ * @param n_samples The number of samples that fit in @a buf.
+ */
+void nx_sampler_start(U32 sensor, U32 rate, nx_sampler_mode_t mode,
+                      nx_sample_t *buf, U32 n_samples);
+
+/** Stop sampling port @a sensor.
+ *
+ * The samples not read yet are discarded.
+ *
+ * @param sensor The sensor port.
+ */
+void nx_sampler_stop(U32 sensor);
+
+/** Return the number of samples ready to be read on port @a sensor.
+ *
+ * @param sensor The sensor port.
+ */
+U32 nx_sampler_available(U32 sensor);
+
+/** Read up to @a max samples from port @a sensor, oldest first.
+ *
+ * Does not block.
+ *
+ * @param sensor The sensor port.
+ * @param samples Filled with the samples.
+ * @param max The size of @a samples.
+ * @return The number of samples read.
+ */
+U32 nx_sampler_read(U32 sensor, nx_sample_t *samples, U32 max);
+
+/** Wait until at least @a count samples are ready on port @a sensor.
+ *
+ * The caller sleeps until the sampler signals that the batch is ready
+ * (see completion.h).
+ *
+ * @param sensor The sensor port.
+ * @param count The number of samples to wait for. At most the size of
+ * the ring.
+ * @param timeout The longest time to wait, in milliseconds, or
+ * NX_COMPLETION_FOREVER.
+ * @return TRUE if the samples are ready, FALSE on timeout.
+ */
+bool nx_sampler_wait(U32 sensor, U32 count, U32 timeout);
+
+/** Return the number of samples dropped on port @a sensor because the
+ * ring was full, since sampling started.
+ *
+ * @param sensor The sensor port.
+ */
+U32 nx_sampler_get_overruns(U32 sensor);
+
+/*@}*/
+/*@}*/
+
+#endif /* __NXOS_BASE_DRIVERS_SAMPLER_H__ */
@@ -11,8 +11,8 @@
 #include "base/types.h"
 #include "base/interrupts.h"
 #include "base/assert.h"
+#include "base/completion.h"
 #include "base/drivers/aic.h"
-#include "base/drivers/systick.h"
 
 #include "base/drivers/_sound.h"
 
@@ -33,8 +33,16 @@ static const U32 tone_pattern[16] = {
 /* When a tone is playing, this value contains the number of times the
  * previous digitized sine wave is to be played.
  */
+/* Extra time given to the tone to end, over its nominal duration,
+ * before nx_sound_freq() gives up waiting for it.
+ */
+#define TONE_END_SLACK_MS 50
+
 static volatile U32 tone_cycles;
 
+/* Signaled when the current tone ends. */
+static nx_completion_t tone_done;
+
 static void sound_isr(void) {
   if (tone_cycles--) {
     /* Tell the DMA controller to stream the static sine wave, 16
@@ -45,10 +53,13 @@ static void sound_isr(void) {
   } else {
     /* Transmit complete, disable sound again. */
     *AT91C_SSC_IDR = AT91C_SSC_ENDTX;
+    nx_completion_signal(&tone_done);
   }
 }
 
 void nx__sound_init(void) {
+  nx_completion_init(&tone_done);
+
   nx_interrupts_disable();
 
   /* Start by inhibiting all sound output. Then enable power to the
@@ -106,6 +117,7 @@ void nx_sound_freq_async(U32 freq, U32 ms) {
    */
   *AT91C_SSC_CMR = ((96109714 / 1024) / freq) + 1;
   tone_cycles = (freq * ms) / 2000 - 1;
+  nx_completion_reset(&tone_done);
 
   /* Enable handling of the transmit end interrupt. */
   *AT91C_SSC_IER = AT91C_SSC_ENDTX;
@@ -119,5 +131,5 @@ void nx_sound_freq_async(U32 freq, U32 ms) {
 
 void nx_sound_freq(U32 freq, U32 ms) {
   nx_sound_freq_async(freq, ms);
-  nx_systick_wait_ms(ms);
+  nx_completion_wait(&tone_done, ms + TONE_END_SLACK_MS);
 }
@@ -10,10 +10,14 @@
 
 #include "base/nxt.h"
 #include "base/types.h"
+#include "base/util.h"
 #include "base/interrupts.h"
+#include "base/_timer.h"
 #include "base/drivers/aic.h"
 #include "base/drivers/_avr.h"
 #include "base/drivers/_lcd.h"
+#include "base/lib/tracing/_tracing.h"
+#include "base/lib/profiler/_profiler.h"
 
 #include "base/drivers/_systick.h"
 
@@ -25,6 +29,21 @@
 /* We want a timer interrupt 1000 times per second. */
 #define SYSIRQ_FREQ 1000
 
+/* The number of PIT ticks per interrupt, and per microsecond. */
+#define PIT_TICKS_PER_MS (PIT_BASE_FREQUENCY / SYSIRQ_FREQ)
+#define PIT_TICKS_PER_US (PIT_BASE_FREQUENCY / 1000000)
+
+/* The longest period the PIT can be programmed for, in milliseconds
+ * (about 349ms).
+ */
+#define PIT_MAX_PERIOD_MS ((AT91C_PITC_PIV + 1) / PIT_TICKS_PER_MS)
+
+/* When shortening the current period, the new end must be at least
+ * this many ticks away from the counter, or the counter may run past
+ * it before the new value is written (10us).
+ */
+#define PIT_REPROGRAM_MARGIN (10 * PIT_TICKS_PER_US)
+
 /* The system IRQ processing takes place in two different interrupt
  * handlers: the main PIT interrupt handler runs at a high priority,
  * keeps the system time accurate, and triggers the lower priority
@@ -46,6 +65,14 @@
  */
 static volatile U32 systick_time;
 
+/* The number of times systick_time wrapped around, for 64-bit time. */
+static volatile U32 systick_epoch;
+
+/* The length of the PIT period, in milliseconds. This is 1 except
+ * while the system is idle, see nx_systick_idle().
+ */
+static volatile U32 systick_period = 1;
+
 /* The scheduler callback. Application kernels can set this to their own
  * callback function, to do scheduling in the high priority systick
  * interrupt.
@@ -57,28 +84,77 @@ static nx_closure_t scheduler_cb = NULL;
  */
 static bool scheduler_inhibit = FALSE;
 
+/* Set when the scheduler callback was requested. The low priority
+ * handler also runs for other background work, in which case the
+ * scheduler must not be invoked behind the application kernel's back.
+ */
+static volatile bool scheduler_pending = FALSE;
+
+/* Program the PIT for a period of @a ms milliseconds. The current
+ * period is stretched or shortened to that length, and the following
+ * ones have it too.
+ */
+static inline void systick_set_period(U32 ms) {
+  *AT91C_PITC_PIMR = ((ms * PIT_TICKS_PER_MS - 1) |
+                      AT91C_PITC_PITEN | AT91C_PITC_PITIEN);
+  systick_period = ms;
+}
+
 /* Low priority handler, called 1000 times a second by the high
- * priority handler if a scheduler callback is registered.
+ * priority handler if a scheduler callback is registered, or if there
+ * is background work to do.
  */
 static void systick_sched(void) {
   /* Acknowledge the interrupt. */
   nx_aic_clear(SCHEDULER_SYSIRQ);
 
+  nx_tracing_add_event(NX_TRACE_BEGIN, NX_TRACE_TRACK_IRQ, SCHEDULER_SYSIRQ);
+
+  /* Fire the expired software timers. This goes before the scheduler,
+   * which may switch tasks on the way out.
+   */
+  nx__timer_run();
+
   /* Call into the scheduler. */
-  if (scheduler_cb)
-    scheduler_cb();
+  if (scheduler_pending) {
+    scheduler_pending = FALSE;
+    if (scheduler_cb)
+      scheduler_cb();
+  }
+
+  /* Push the live trace to the host, if one is streaming. */
+  nx__tracing_drain();
+
+  nx_tracing_add_event(NX_TRACE_END, NX_TRACE_TRACK_IRQ, SCHEDULER_SYSIRQ);
 }
 
 /* High priority handler, called 1000 times a second */
 static void systick_isr(void) {
-  U32 status;
+  U32 status, elapsed;
   /* The PIT's value register must be read to acknowledge the
    * interrupt.
    */
   status = *AT91C_PITC_PIVR;
 
-  /* Do the system timekeeping. */
-  systick_time++;
+  /* Do the system timekeeping. If interrupts were disabled for a
+   * while, several periods may have elapsed since the last tick: the
+   * PIT counts them for us.
+   */
+  elapsed = (status >> 20) * systick_period;
+  systick_time += elapsed;
+  if (systick_time < elapsed)
+    systick_epoch++;
+
+  /* Coming out of idle, go back to ticking every millisecond. The
+   * counter just restarted, so it is far from the new period's end.
+   */
+  if (systick_period != 1)
+    systick_set_period(1);
+
+  nx_tracing_add_event(NX_TRACE_BEGIN, NX_TRACE_TRACK_IRQ, AT91C_ID_SYS);
+
+  /* Sample the interrupted code, if the profiler is running. */
+  nx__profiler_sample();
 
   /* Keeping up with the AVR link is a crucial task in the system, and
    * must absolutely be kept up with at all costs. Thus, handling it
@@ -96,6 +172,14 @@ static void systick_isr(void) {
 
   if (!scheduler_inhibit)
     nx_systick_call_scheduler();
+
+  /* The trace stream is drained, and the software timers are fired,
+   * in the low priority handler as well.
+   */
+  if (nx__tracing_drain_pending() || nx__timer_pending())
+    nx_aic_set(SCHEDULER_SYSIRQ);
+
+  nx_tracing_add_event(NX_TRACE_END, NX_TRACE_TRACK_IRQ, AT91C_ID_SYS);
 }
 
 void nx__systick_init(void) {
@@ -119,20 +203,150 @@ void nx__systick_init(void) {
   nx_interrupts_enable();
 }
 
+/* Sample the current time: the number of milliseconds accounted for
+ * by the ticks handled so far (and how many times that count wrapped
+ * around), and the PIT counter state, whose count is in @a period
+ * millisecond units.
+ *
+ * The PIT counts the periods elapsed since the last acknowledged
+ * tick, so a pending tick is accounted for in the counter state. If
+ * the tick is handled while we sample the counter, we sample again.
+ */
+static inline U32 systick_sample(U32 *epoch, U32 *piir, U32 *period) {
+  U32 time;
+
+  do {
+    *epoch = systick_epoch;
+    time = systick_time;
+    *period = systick_period;
+    *piir = *AT91C_PITC_PIIR;
+  } while (time != systick_time || *epoch != systick_epoch ||
+           *period != systick_period);
+
+  return time;
+}
+
 U32 nx_systick_get_ms(void) {
-  return systick_time;
+  U32 time, epoch, piir, period;
+
+  /* The counter may span several milliseconds when idle. */
+  time = systick_sample(&epoch, &piir, &period);
+  return (time + (piir >> 20) * period +
+          (piir & AT91C_PITC_CPIV) / PIT_TICKS_PER_MS);
+}
+
+U32 nx__systick_get_ticks(void) {
+  U32 time, epoch, piir, period;
+
+  time = systick_sample(&epoch, &piir, &period);
+  return ((time + (piir >> 20) * period) * PIT_TICKS_PER_MS +
+          (piir & AT91C_PITC_CPIV));
+}
+
+U32 nx_systick_get_us(void) {
+  U32 time, epoch, piir, period;
+
+  time = systick_sample(&epoch, &piir, &period);
+  return ((time + (piir >> 20) * period) * 1000 +
+          (piir & AT91C_PITC_CPIV) / PIT_TICKS_PER_US);
+}
+
+U64 nx_systick_get_us64(void) {
+  U32 time, epoch, piir, period;
+  U64 ms;
+
+  time = systick_sample(&epoch, &piir, &period);
+  ms = (((U64)epoch << 32) | time) + (piir >> 20) * period;
+  return ms * 1000 + (piir & AT91C_PITC_CPIV) / PIT_TICKS_PER_US;
 }
 
 void nx_systick_wait_ms(U32 ms) {
-  U32 final = systick_time + ms;
+  U32 start = systick_time;
 
-  while (systick_time < final);
+  while (systick_time - start < ms);
+}
+
+/* Busy wait for a number of PIT ticks. */
+static void systick_wait_ticks(U32 ticks) {
+  U32 start = nx__systick_get_ticks();
+
+  while (nx__systick_get_ticks() - start < ticks);
+}
+
+void nx_systick_wait_us(U32 us) {
+  /* Split long waits, so that the tick count doesn't overflow. */
+  while (us > 1000000) {
+    systick_wait_ticks(1000000 * PIT_TICKS_PER_US);
+    us -= 1000000;
+  }
+  systick_wait_ticks(us * PIT_TICKS_PER_US);
 }
 
 void nx_systick_wait_ns(U32 ns) {
-  volatile U32 x = (ns >> 7) + 1;
+  /* Round up to the next PIT tick. */
+  nx_systick_wait_us(ns / 1000);
+  systick_wait_ticks(((ns % 1000) * PIT_TICKS_PER_US + 999) / 1000);
+}
+
+void nx_systick_idle(U32 ms) {
+  U32 piir, next;
+
+  /* Let a requested scheduler call run first. The trace drain needs
+   * the low priority handler every tick.
+   */
+  if (scheduler_pending)
+    return;
+  if (nx__tracing_drain_pending())
+    ms = 1;
+
+  /* An interrupt ended the last sleep early, and the caller came back
+   * before the shortened period ran out: sleep until its end.
+   */
+  if (systick_period != 1)
+    ms = 1;
+
+  ms = MIN(ms, nx__avr_max_idle_ms());
+  ms = MIN(ms, nx__timer_next_timeout());
+  ms = MIN(ms, PIT_MAX_PERIOD_MS);
 
-  while (x--);
+  /* Stretch the current period. A tick that is already pending must
+   * be accounted for with the current period, or the handler would
+   * count it as a whole stretched period: check the counter right
+   * before the write, and leave a margin before the end of the
+   * period. Interrupts are masked, so the tick can't be handled in
+   * between; if it still slipped in before the write, put the period
+   * back.
+   */
+  if (ms > 1) {
+    piir = *AT91C_PITC_PIIR;
+    if ((piir >> 20) != 0 || (piir & AT91C_PITC_CPIV) +
+        PIT_REPROGRAM_MARGIN >= PIT_TICKS_PER_MS)
+      return;
+
+    systick_set_period(ms);
+
+    if ((*AT91C_PITC_PIIR >> 20) != 0) {
+      systick_set_period(1);
+      return;
+    }
+  }
+
+  /* Stop the processor clock. Any interrupt restarts it, even while
+   * masked.
+   */
+  *AT91C_PMC_SCDR = AT91C_PMC_PCK;
+
+  /* If another interrupt woke us up early, end the period at the next
+   * millisecond boundary, so that regular ticking resumes without
+   * losing the time elapsed so far.
+   */
+  piir = *AT91C_PITC_PIIR;
+  if (systick_period > 1 && (piir >> 20) == 0) {
+    next = (((piir & AT91C_PITC_CPIV) + PIT_REPROGRAM_MARGIN) /
+            PIT_TICKS_PER_MS) + 1;
+    if (next < systick_period)
+      systick_set_period(next);
+  }
 }
 
 void nx_systick_install_scheduler(nx_closure_t sched_cb) {
@@ -145,8 +359,10 @@ void nx_systick_call_scheduler(void) {
   /* If the application kernel set a scheduling callback, trigger the
    * lower priority IRQ in which the scheduler runs.
    */
-  if (scheduler_cb)
+  if (scheduler_cb) {
+    scheduler_pending = TRUE;
     nx_aic_set(SCHEDULER_SYSIRQ);
+  }
 }
 
 void nx_systick_mask_scheduler(void) {
@@ -30,6 +30,20 @@
 /** Return the number of milliseconds elapsed since bootup. */
 U32 nx_systick_get_ms(void);
 
+/** Return the number of microseconds elapsed since bootup.
+ *
+ * The resolution is a third of a microsecond, and the value wraps
+ * around every 71 minutes or so. It is meant for timestamping and
+ * measuring short intervals: compute differences with unsigned
+ * arithmetic, which remains correct across the wrap.
+ */
+U32 nx_systick_get_us(void);
+
+/** Return the number of microseconds elapsed since bootup, as a
+ * 64-bit value that never wraps around.
+ */
+U64 nx_systick_get_us64(void);
+
 /** Sleep for @a ms milliseconds.
  *
  * @param ms The number of milliseconds to sleep.
@@ -39,16 +53,46 @@ U32 nx_systick_get_ms(void);
  */
 void nx_systick_wait_ms(U32 ms);
 
-/** Sleep for approximately @a ns nanoseconds.
+/** Sleep for @a us microseconds.
+ *
+ * @param us The number of microseconds to sleep.
+ *
+ * @note This is a busy wait on the system timer's hardware counter,
+ * so it is accurate to a third of a microsecond (plus the call
+ * overhead), and works even with interrupts disabled.
+ */
+void nx_systick_wait_us(U32 us);
+
+/** Sleep for at least @a ns nanoseconds.
  *
  * @param ns The number of nanoseconds to sleep.
  *
- * @note This sleep routine is a busy loop whose accuracy is based
- * entirely on the instruction timings and pipeline delays in the ARM7
- * cpu. It may not be exact.
+ * @note This is a busy wait on the system timer's hardware counter,
+ * whose resolution is 333ns. Shorter delays are rounded up, and the
+ * call overhead (around a microsecond) comes on top of it.
  */
 void nx_systick_wait_ns(U32 ns);
 
+/** Stop the processor until the next interrupt, skipping up to @a ms
+ * milliseconds worth of system timer ticks.
+ *
+ * The system timer interrupt is delayed by up to @a ms milliseconds,
+ * within the limits of what the drivers (mostly the AVR link) can
+ * tolerate. Any other interrupt wakes the processor up early, in
+ * which case the timer resumes ticking from the next millisecond; a
+ * call made before that tick only sleeps until it. The system time
+ * stays accurate either way.
+ *
+ * This must be called with interrupts disabled, so that the decision
+ * to sleep can't race with an interrupt handler making work
+ * available. The interrupt that ended the sleep is serviced once
+ * interrupts are enabled again.
+ *
+ * @param ms The longest time to sleep, in milliseconds. Values below 2
+ * only stop the processor until the next tick.
+ */
+void nx_systick_idle(U32 ms);
+
 /** Install @a scheduler_cb as the scheduler callback.
  *
  * The scheduler callback will be invoked every millisecond once it is
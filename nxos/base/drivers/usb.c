@@ -243,6 +243,13 @@ static volatile struct {
   U8 current_rx_bank;
 } usb_state;
 
+/* Signaled when the last write has been acknowledged by the host, and
+ * when a packet has been read into the reception buffer. Also
+ * signaled on bus reset, so that waiters notice the disconnection.
+ */
+static nx_completion_t usb_tx_done;
+static nx_completion_t usb_rx_done;
+
 
 /* The flags in the UDP_CSR register are a little strange: writing to
  * them does not instantly change their value. Their value will change
@@ -279,6 +286,7 @@ static void usb_write_data(int endpoint, const U8 *ptr, U32 length) {
 
   /* The bus is now busy. */
   usb_state.status = USB_BUSY;
+  nx_completion_reset(&usb_tx_done);
 
   if (endpoint == 0)
     packet_size = MIN(MAX_EP0_SIZE, length);
@@ -337,6 +345,8 @@ static void usb_read_data(int endpoint) {
     usb_state.rx_data[i] = AT91C_UDP_FDR[1];
 
   usb_state.rx_len = i;
+  if (i > 0)
+    nx_completion_signal(&usb_rx_done);
 
 
   /* if we have read all the byte ... */
@@ -534,6 +544,7 @@ static U32 usb_manage_setup_packet(void) {
     while (AT91C_UDP_CSR[3] != 0);
 
     usb_state.status = USB_READY;
+    nx_completion_signal(&usb_tx_done);
     break;
 
   case USB_BREQUEST_GET_INTERFACE: /* TODO: This should respond, not stall. */
@@ -561,6 +572,8 @@ static void usb_isr(void) {
   /* End of bus reset. Starting the device setup procedure. */
   if (isr & AT91C_UDP_ENDBUSRES) {
     usb_state.status = USB_UNINITIALIZED;
+    nx_completion_signal(&usb_tx_done);
+    nx_completion_signal(&usb_rx_done);
 
     /* Disable and clear all interruptions, reverting to the base
      * state.
@@ -673,14 +686,18 @@ static void usb_isr(void) {
       }
 
 
-      /* and we will send the following data */
-      if (usb_state.tx_len[endpoint] > 0
-	  && usb_state.tx_data[endpoint] != NULL) {
-	usb_write_data(endpoint, usb_state.tx_data[endpoint],
-		      usb_state.tx_len[endpoint]);
+      /* and we will send the following data. The pending data is
+       * indexed by transmitting endpoint (0 = EP0, 1 = EP2), not by
+       * endpoint number.
+       */
+      if (usb_state.tx_len[endpoint / 2] > 0
+	  && usb_state.tx_data[endpoint / 2] != NULL) {
+	usb_write_data(endpoint, usb_state.tx_data[endpoint / 2],
+		      usb_state.tx_len[endpoint / 2]);
       } else {
         /* then it means that we sent all the data and the host has acknowledged it */
         usb_state.status = USB_READY;
+        nx_completion_signal(&usb_tx_done);
       }
       return;
     }
@@ -721,6 +738,8 @@ static inline void usb_enable(void) {
 void nx__usb_init(void) {
   nx__usb_disable();
   memset((void*)&usb_state, 0, sizeof(usb_state));
+  nx_completion_init(&usb_tx_done);
+  nx_completion_init(&usb_rx_done);
 
   nx_interrupts_disable();
 
@@ -771,14 +790,22 @@ void nx_usb_write(U8 *data, U32 length) {
   NX_ASSERT(length > 0);
 
   /* TODO: Make call asynchronous */
-  while (usb_state.status != USB_READY);
+  while (usb_state.status != USB_READY)
+    nx_usb_wait_written(NX_COMPLETION_FOREVER);
 
   /* start sending the data */
   usb_write_data(2, data, length);
 }
 
 bool nx_usb_data_written(void) {
-  return (usb_state.tx_len[2] == 0);
+  return (usb_state.tx_len[1] == 0);
+}
+
+bool nx_usb_wait_written(U32 timeout) {
+  if (usb_state.status == USB_BUSY)
+    nx_completion_wait(&usb_tx_done, timeout);
+
+  return (usb_state.status == USB_READY);
 }
 
 
@@ -791,6 +818,7 @@ void nx_usb_read(U8 *data, U32 length)
 {
   usb_state.rx_data = data;
   usb_state.rx_size = length;
+  nx_completion_reset(&usb_rx_done);
   usb_state.rx_len  = 0;
 
   if (usb_state.status > USB_UNINITIALIZED
@@ -804,3 +832,12 @@ U32 nx_usb_data_read(void)
 {
   return usb_state.rx_len;
 }
+
+
+U32 nx_usb_wait_read(U32 timeout)
+{
+  if (usb_state.rx_len == 0)
+    nx_completion_wait(&usb_rx_done, timeout);
+
+  return usb_state.rx_len;
+}
@@ -14,6 +14,7 @@
 #define __NXOS_BASE_DRIVERS_USB_H__
 
 #include "base/types.h"
+#include "base/completion.h"
 
 /** @addtogroup driver */
 /*@{*/
@@ -68,6 +69,20 @@ void nx_usb_write(U8 *data, U32 length);
  */
 bool nx_usb_data_written(void);
 
+/** Wait until the host has acknowledged all the data sent with
+ * nx_usb_write().
+ *
+ * The caller sleeps until the transfer completes: under an application
+ * kernel that supports it, other tasks run in the meantime (see
+ * completion.h).
+ *
+ * @param timeout The longest time to wait, in milliseconds, or
+ * NX_COMPLETION_FOREVER.
+ * @return TRUE if data can be written again, FALSE on timeout or if
+ * the host is gone.
+ */
+bool nx_usb_wait_written(U32 timeout);
+
 /**
  * Specify where the next read data must be put
  * @note if a packet has a size smaller than the provided one, then all the area won't be used
@@ -81,6 +96,18 @@ void nx_usb_read(U8 *data, U32 length);
  */
 U32 nx_usb_data_read(void);
 
+/** Wait for a packet to be read into the buffer given to
+ * nx_usb_read().
+ *
+ * Like nx_usb_wait_written(), the caller sleeps until the data
+ * arrives.
+ *
+ * @param timeout The longest time to wait, in milliseconds, or
+ * NX_COMPLETION_FOREVER.
+ * @return The packet size read, 0 on timeout.
+ */
+U32 nx_usb_wait_read(U32 timeout);
+
 
 /*@}*/
 /*@}*/
@@ -0,0 +1,272 @@
+/* Copyright (c) 2008 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#include "base/types.h"
+#include "base/nxt.h"
+#include "base/assert.h"
+#include "base/display.h"
+#include "base/util.h"
+#include "base/drivers/systick.h"
+#include "base/drivers/_systick.h"
+#include "base/drivers/usb.h"
+
+#include "base/lib/bench/bench.h"
+
+/* CPU cycles per system timer tick. */
+#define CYCLES_PER_TICK (NXT_CLOCK_FREQ / NX__SYSTICK_TICK_FREQ)
+
+/* Batches are grown until a sample lasts at least this many ticks
+ * (1ms), or until they reach the maximum size.
+ */
+#define MIN_SAMPLE_TICKS (NX__SYSTICK_TICK_FREQ / 1000)
+#define MAX_ITERATIONS (1 << 16)
+
+/* Number of samples taken to measure the harness' loop overhead. */
+#define OVERHEAD_SAMPLES 5
+
+/* How long to wait for the USB host to take a result line. */
+#define USB_TIMEOUT_MS 100
+
+/* Results per screen, and how long a full screen stays up. */
+#define RESULTS_PER_SCREEN 4
+#define SCREEN_DELAY_MS 2000
+
+static struct {
+  nx_bench_t *first;
+  nx_bench_t *last;
+
+  /* Cost of one iteration of an empty benchmark, in cycles. 0 until
+   * it has been measured.
+   */
+  U32 overhead;
+
+  /* Number of results on the display. */
+  U32 shown;
+
+  /* Set when the USB host stopped reading results. */
+  bool usb_stalled;
+} bench_state;
+
+/* One result line for the USB host. */
+static char bench_line[128];
+
+/* The empty benchmark. It must not be inlined into the timing loop,
+ * or the overhead would leave out the call that real benchmarks pay.
+ */
+static void __attribute__((noinline)) bench_nop(void) {
+}
+
+U32 nx_bench_get_ticks(void) {
+  return nx__systick_get_ticks();
+}
+
+U32 nx_bench_ticks_to_cycles(U32 ticks) {
+  return ticks * CYCLES_PER_TICK;
+}
+
+void nx_bench_register(nx_bench_t *bench) {
+  NX_ASSERT(bench != NULL);
+  NX_ASSERT(bench->name != NULL);
+  NX_ASSERT(bench->run != NULL || bench->timed != NULL);
+  NX_ASSERT(bench->samples <= NX_BENCH_MAX_SAMPLES);
+
+  bench->next = NULL;
+  if (bench_state.last)
+    bench_state.last->next = bench;
+  else
+    bench_state.first = bench;
+  bench_state.last = bench;
+}
+
+/* Time @a iterations runs of @a run, in ticks.
+ *
+ * The call goes through a volatile pointer, so that the compiler
+ * can't specialize the loop for a known function: the empty benchmark
+ * and the real ones pay for the same indirect call.
+ */
+static U32 bench_time_closure(nx_closure_t run, U32 iterations) {
+  nx_closure_t volatile fn = run;
+  U32 start, i;
+
+  start = nx__systick_get_ticks();
+  for (i = 0; i < iterations; i++)
+    fn();
+  return nx__systick_get_ticks() - start;
+}
+
+static U32 bench_sample(nx_bench_t *bench, U32 iterations) {
+  if (bench->timed)
+    return bench->timed(iterations);
+  return bench_time_closure(bench->run, iterations);
+}
+
+/* Convert a sample to cycles per operation, rounded. */
+static U32 bench_cost(U32 ticks, U32 iterations) {
+  return (nx_bench_ticks_to_cycles(ticks) + iterations / 2) / iterations;
+}
+
+/* Find the batch size that makes a sample last long enough. This also
+ * warms up the caller's code and data.
+ */
+static U32 bench_calibrate(nx_bench_t *bench) {
+  U32 iterations = 1;
+
+  while (bench_sample(bench, iterations) < MIN_SAMPLE_TICKS &&
+         iterations < MAX_ITERATIONS)
+    iterations <<= 1;
+
+  return iterations;
+}
+
+static void bench_measure_overhead(void) {
+  nx_bench_t nop = { "nop", NULL, NULL, bench_nop, NULL, 0, 0, NULL };
+  U32 iterations = bench_calibrate(&nop);
+  U32 i, cost, best = 0xFFFFFFFF;
+
+  for (i = 0; i < OVERHEAD_SAMPLES; i++) {
+    cost = bench_cost(bench_time_closure(bench_nop, iterations), iterations);
+    if (cost < best)
+      best = cost;
+  }
+
+  /* Never leave 0, which means "not measured". */
+  bench_state.overhead = MAX(best, 1);
+}
+
+void nx_bench_run(nx_bench_t *bench, nx_bench_result_t *result) {
+  U32 samples[NX_BENCH_MAX_SAMPLES];
+  U32 n_samples, iterations, i, j, cost;
+
+  NX_ASSERT(bench != NULL);
+  NX_ASSERT(result != NULL);
+
+  if (bench->run && bench_state.overhead == 0)
+    bench_measure_overhead();
+
+  n_samples = bench->samples ? bench->samples : NX_BENCH_DEFAULT_SAMPLES;
+  NX_ASSERT(n_samples <= NX_BENCH_MAX_SAMPLES);
+
+  if (bench->setup)
+    bench->setup();
+
+  /* Warm up. */
+  if (bench->iterations) {
+    iterations = bench->iterations;
+    bench_sample(bench, iterations);
+  } else {
+    iterations = bench_calibrate(bench);
+  }
+
+  /* Sample, keeping the samples sorted. */
+  for (i = 0; i < n_samples; i++) {
+    cost = bench_cost(bench_sample(bench, iterations), iterations);
+    if (bench->run)
+      cost = (cost > bench_state.overhead) ? cost - bench_state.overhead : 0;
+
+    for (j = i; j > 0 && samples[j-1] > cost; j--)
+      samples[j] = samples[j-1];
+    samples[j] = cost;
+  }
+
+  if (bench->teardown)
+    bench->teardown();
+
+  result->median = samples[n_samples / 2];
+  result->min = samples[0];
+  result->max = samples[n_samples - 1];
+  result->iterations = iterations;
+  result->samples = n_samples;
+}
+
+/* Append a string to the result line. */
+static char *bench_append(char *p, const char *s) {
+  char *end = bench_line + sizeof(bench_line) - 1;
+
+  while (*s && p < end)
+    *p++ = *s++;
+  *p = '\0';
+  return p;
+}
+
+static char *bench_append_uint(char *p, U32 val) {
+  char digits[11];
+  int i = sizeof(digits) - 1;
+
+  digits[i] = '\0';
+  do {
+    digits[--i] = '0' + (val % 10);
+    val /= 10;
+  } while (val > 0);
+
+  return bench_append(p, &digits[i]);
+}
+
+static void bench_send_line(void) {
+  if (!nx_usb_is_connected() || bench_state.usb_stalled)
+    return;
+
+  if (!nx_usb_wait_written(USB_TIMEOUT_MS))
+    return;
+
+  nx_usb_write((U8*)bench_line, strlen(bench_line));
+
+  /* The line buffer is reused for the next result: give up on the
+   * host if it doesn't read this one.
+   */
+  if (!nx_usb_wait_written(USB_TIMEOUT_MS))
+    bench_state.usb_stalled = TRUE;
+}
+
+void nx_bench_report(const char *name, nx_bench_result_t *result) {
+  char *p = bench_line;
+
+  NX_ASSERT(name != NULL);
+  NX_ASSERT(result != NULL);
+
+  if (bench_state.shown == RESULTS_PER_SCREEN) {
+    nx_systick_wait_ms(SCREEN_DELAY_MS);
+    nx_display_clear();
+    bench_state.shown = 0;
+  }
+  nx_display_cursor_set_pos(0, 2 * bench_state.shown);
+  nx_display_string(name);
+  nx_display_end_line();
+  nx_display_string("  ");
+  nx_display_uint(result->median);
+  nx_display_string(" cyc");
+  nx_display_end_line();
+  bench_state.shown++;
+
+  p = bench_append(p, "BENCH name=");
+  p = bench_append(p, name);
+  p = bench_append(p, " median=");
+  p = bench_append_uint(p, result->median);
+  p = bench_append(p, " min=");
+  p = bench_append_uint(p, result->min);
+  p = bench_append(p, " max=");
+  p = bench_append_uint(p, result->max);
+  p = bench_append(p, " unit=cycles iters=");
+  p = bench_append_uint(p, result->iterations);
+  p = bench_append(p, " samples=");
+  p = bench_append_uint(p, result->samples);
+  p = bench_append(p, "\n");
+  bench_send_line();
+}
+
+void nx_bench_run_all(void) {
+  nx_bench_result_t result;
+  nx_bench_t *bench;
+
+  nx_display_clear();
+  bench_state.shown = 0;
+
+  for (bench = bench_state.first; bench != NULL; bench = bench->next) {
+    nx_bench_run(bench, &result);
+    nx_bench_report(bench->name, &result);
+  }
+}
@@ -0,0 +1,146 @@
+/** @file bench.h
+ *  @brief Microbenchmark harness.
+ *
+ * Measure how many CPU cycles an operation takes.
+ */
+
+/* Copyright (c) 2008 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#ifndef __NXOS_BASE_LIB_BENCH_BENCH_H__
+#define __NXOS_BASE_LIB_BENCH_BENCH_H__
+
+#include "base/types.h"
+
+/** @addtogroup lib */
+/*@{*/
+
+/** @defgroup bench Microbenchmarks
+ *
+ * The benchmark harness runs registered operations many times, and
+ * reports how many CPU cycles one operation takes.
+ *
+ * Each benchmark is warmed up, then sampled a number of times. A
+ * sample times a batch of operations with the system timer. The batch
+ * size is calibrated so that a sample lasts at least a millisecond,
+ * which makes the timer's resolution (16 cycles) negligible. The cost
+ * of the harness' own loop is measured once, and deducted from the
+ * results.
+ *
+ * The results are the median, minimum and maximum cost over all the
+ * samples. Interrupts are left enabled while sampling, so the maximum
+ * includes the occasional interrupt handler; the median does not.
+ *
+ * Results are shown on the display, and, if a USB host is connected,
+ * sent to it as lines of text of the form:
+ *
+ * <pre>BENCH name=memcpy_1k median=2301 min=2298 max=2677 unit=cycles iters=128 samples=15</pre>
+ *
+ * Names must not contain spaces.
+ */
+/*@{*/
+
+/** The maximum number of samples per benchmark. */
+#define NX_BENCH_MAX_SAMPLES 31
+
+/** The default number of samples per benchmark. */
+#define NX_BENCH_DEFAULT_SAMPLES 15
+
+/** A benchmark.
+ *
+ * Benchmarks are statically allocated by the application, and linked
+ * into the harness by nx_bench_register(). Either @a run or @a timed
+ * must be given.
+ */
+typedef struct nx_bench {
+  const char *name; /**< Short name, without spaces. */
+
+  /** Called once before the benchmark is sampled, or NULL. */
+  nx_closure_t setup;
+
+  /** Called once after the benchmark is sampled, or NULL. */
+  nx_closure_t teardown;
+
+  /** Perform the measured operation once. */
+  nx_closure_t run;
+
+  /** Alternatively, perform the operation @a iterations times and
+   * return the elapsed system timer ticks, as read with
+   * nx_bench_get_ticks(). For operations whose timing can't be
+   * observed from outside, like the latency of a wakeup.
+   */
+  U32 (*timed)(U32 iterations);
+
+  /** Operations per sample. 0 (the default) lets the harness
+   * calibrate it, which may run the operation several thousand times:
+   * set it for operations that wear down the hardware.
+   */
+  U32 iterations;
+
+  /** Number of samples, at most NX_BENCH_MAX_SAMPLES. 0 for
+   * NX_BENCH_DEFAULT_SAMPLES.
+   */
+  U32 samples;
+
+  struct nx_bench *next; /**< Used by the harness. */
+} nx_bench_t;
+
+/** The result of a benchmark. Costs are in CPU cycles per operation. */
+typedef struct {
+  U32 median; /**< Median cost. */
+  U32 min; /**< Lowest cost. */
+  U32 max; /**< Highest cost. */
+  U32 iterations; /**< Operations per sample. */
+  U32 samples; /**< Number of samples taken. */
+} nx_bench_result_t;
+
+/** Add a benchmark to the list run by nx_bench_run_all().
+ *
+ * @param bench The benchmark. It must stay allocated while registered.
+ */
+void nx_bench_register(nx_bench_t *bench);
+
+/** Run one benchmark.
+ *
+ * @param bench The benchmark to run.
+ * @param result Filled with the result.
+ */
+void nx_bench_run(nx_bench_t *bench, nx_bench_result_t *result);
+
+/** Run all registered benchmarks in registration order, and report
+ * their results on the display and over USB.
+ */
+void nx_bench_run_all(void);
+
+/** Report a result on the display and over USB.
+ *
+ * This is used by nx_bench_run_all(), and can be used to report
+ * measurements made by other means.
+ *
+ * @param name The name of the benchmark.
+ * @param result Its result.
+ */
+void nx_bench_report(const char *name, nx_bench_result_t *result);
+
+/** Read the timer used by the harness.
+ *
+ * @return A free running tick count, for use by timed benchmarks.
+ */
+U32 nx_bench_get_ticks(void);
+
+/** Convert a tick count to CPU cycles.
+ *
+ * @param ticks A difference of nx_bench_get_ticks() values.
+ * @return The number of CPU cycles in @a ticks.
+ */
+U32 nx_bench_ticks_to_cycles(U32 ticks);
+
+/*@}*/
+/*@}*/
+
+#endif /* __NXOS_BASE_LIB_BENCH_BENCH_H__ */
@@ -6,7 +6,7 @@
 #include "base/assert.h"
 #include "base/display.h"
 #include "base/drivers/avr.h"
-#include "base/drivers/systick.h"
+#include "base/drivers/buttons.h"
 #include "base/lib/gui/gui.h"
 
 #define LCD_LINES 8
@@ -25,8 +25,11 @@ U8 nx_gui_text_menu(gui_text_menu_t menu) {
   if (menu.default_entry < count)
     current = menu.default_entry;
 
+  /* Don't take presses meant for the previous screen as answers. */
+  nx_buttons_flush();
+
   do {
-    nx_avr_button_t button;
+    nx_buttons_event_t event;
     U8 start = 0, end = count;
 
     nx_display_clear();
@@ -66,10 +69,14 @@ U8 nx_gui_text_menu(gui_text_menu_t menu) {
       nx_display_string(SCROLL_MARKER);
     nx_display_end_line();
 
-    nx_systick_wait_ms(GUI_EVENT_THROTTLE);
-    while ((button = nx_avr_get_button()) == BUTTON_NONE);
+    /* Sleep until a button is pressed. Left and right keep scrolling
+     * while held down.
+     */
+    while (!nx_buttons_wait_event(&event, NX_COMPLETION_FOREVER) ||
+           (event.type != NX_BUTTON_PRESS &&
+            event.type != NX_BUTTON_REPEAT));
 
-    switch (button) {
+    switch (event.button) {
       case BUTTON_LEFT:
         if (current > 0)
           current--;
@@ -79,15 +86,14 @@ U8 nx_gui_text_menu(gui_text_menu_t menu) {
           current++;
         break;
       case BUTTON_OK:
-        done = TRUE;
+        if (event.type == NX_BUTTON_PRESS)
+          done = TRUE;
         break;
       default:
         break;
     }
   } while (!done);
 
-
-  nx_systick_wait_ms(GUI_EVENT_AVOID_REPEAT);
   return current;
 }
 
@@ -27,14 +27,6 @@
  */
 /*@{*/
 
-/** Wait time in milliseconds before next event polling. */
-#define GUI_EVENT_THROTTLE 350
-
-/** Wait time in milliseconds after a menu entry was selected
- * to avoid stroke repeat.
- */
-#define GUI_EVENT_AVOID_REPEAT 300
-
 /** Default menu marker for active entry. */
 #define GUI_DEFAULT_TEXT_MARK "> "
 
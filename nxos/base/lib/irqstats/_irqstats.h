@@ -0,0 +1,44 @@
+/** @file _irqstats.h
+ *  @brief Interrupt statistics internal interface.
+ */
+
+/* Copyright (c) 2008 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#ifndef __NXOS_BASE_LIB_IRQSTATS__IRQSTATS_H__
+#define __NXOS_BASE_LIB_IRQSTATS__IRQSTATS_H__
+
+#include "base/lib/irqstats/irqstats.h"
+
+/** @addtogroup kernelinternal */
+/*@{*/
+
+/** @defgroup irqstatsinternal Interrupt statistics
+ *
+ * Hooks called by the interrupt dispatcher when the Baseplate is
+ * built with NX_IRQ_STATS defined. Both are called with interrupts
+ * disabled.
+ */
+/*@{*/
+
+/** Record the entry into the handler of @a vector.
+ *
+ * @param vector The AIC vector being dispatched.
+ */
+void nx__irqstats_enter(U32 vector);
+
+/** Record the exit from the handler of @a vector.
+ *
+ * @param vector The AIC vector that was dispatched.
+ */
+void nx__irqstats_exit(U32 vector);
+
+/*@}*/
+/*@}*/
+
+#endif /* __NXOS_BASE_LIB_IRQSTATS__IRQSTATS_H__ */
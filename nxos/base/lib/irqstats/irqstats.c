@@ -0,0 +1,190 @@
+/* Copyright (c) 2008 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#include "base/at91sam7s256.h"
+
+#include "base/types.h"
+#include "base/assert.h"
+#include "base/interrupts.h"
+#include "base/util.h"
+#include "base/drivers/_systick.h"
+#include "base/drivers/usb.h"
+
+#include "base/lib/irqstats/_irqstats.h"
+
+/* The AIC has 8 priority levels, so at most 8 handlers can be active
+ * at the same time.
+ */
+#define IRQSTATS_MAX_DEPTH 8
+
+/* Magic number at the start of a dump ("NXIS"). */
+#define IRQSTATS_MAGIC 0x5349584E
+
+/* Conversion of system timer ticks to nanoseconds. */
+#define TICKS_TO_NS(t) ((t) * 1000 / (NX__SYSTICK_TICK_FREQ / 1000000))
+
+/* The number of system timer ticks in a millisecond. */
+#define TICKS_PER_MS (NX__SYSTICK_TICK_FREQ / 1000)
+
+/* The raw statistics, in system timer ticks. */
+static volatile struct {
+  struct {
+    U32 count;
+    U32 min;
+    U32 max;
+    U32 total;
+    U32 nested;
+    U32 preempted;
+    U32 max_latency;
+    U16 histogram[NX_IRQSTATS_BUCKETS];
+  } vectors[NX_IRQSTATS_VECTORS];
+
+  /* The handlers currently running, innermost last. The time spent in
+   * nested handlers is accumulated in their parent's children time,
+   * and deducted from its duration.
+   */
+  struct {
+    U32 vector;
+    U32 start;
+    U32 children;
+  } active[IRQSTATS_MAX_DEPTH];
+  U32 depth;
+  U32 max_depth;
+} irqstats;
+
+/* The dump sent to the USB host. */
+static struct {
+  U32 magic;
+  U32 n_vectors;
+  U32 n_buckets;
+  U32 max_depth;
+  nx_irqstats_t vectors[NX_IRQSTATS_VECTORS];
+} irqstats_dump;
+
+void nx__irqstats_enter(U32 vector) {
+  U32 now = nx__systick_get_ticks();
+  U32 depth = irqstats.depth;
+
+  NX_ASSERT(vector < NX_IRQSTATS_VECTORS);
+  NX_ASSERT(depth < IRQSTATS_MAX_DEPTH);
+
+  if (depth > 0) {
+    irqstats.vectors[vector].nested++;
+    irqstats.vectors[irqstats.active[depth-1].vector].preempted++;
+  }
+
+  /* The system timer counts from the moment its interrupt was
+   * raised, which gives us its latency for free.
+   */
+  if (vector == AT91C_ID_SYS) {
+    U32 piir = *AT91C_PITC_PIIR;
+    U32 latency = (piir & AT91C_PITC_CPIV);
+
+    if ((piir >> 20) > 1)
+      latency += ((piir >> 20) - 1) * TICKS_PER_MS;
+    if (latency > irqstats.vectors[vector].max_latency)
+      irqstats.vectors[vector].max_latency = latency;
+  }
+
+  irqstats.active[depth].vector = vector;
+  irqstats.active[depth].start = now;
+  irqstats.active[depth].children = 0;
+  irqstats.depth = ++depth;
+  if (depth > irqstats.max_depth)
+    irqstats.max_depth = depth;
+}
+
+void nx__irqstats_exit(U32 vector) {
+  U32 now = nx__systick_get_ticks();
+  U32 depth, total, self, bucket, threshold;
+
+  NX_ASSERT(irqstats.depth > 0);
+  depth = --irqstats.depth;
+  NX_ASSERT(irqstats.active[depth].vector == vector);
+
+  total = now - irqstats.active[depth].start;
+  self = total - irqstats.active[depth].children;
+  if (depth > 0)
+    irqstats.active[depth-1].children += total;
+
+  if (irqstats.vectors[vector].count == 0 ||
+      self < irqstats.vectors[vector].min)
+    irqstats.vectors[vector].min = self;
+  if (self > irqstats.vectors[vector].max)
+    irqstats.vectors[vector].max = self;
+  irqstats.vectors[vector].total += self;
+  irqstats.vectors[vector].count++;
+
+  /* Bucket 0 is under a microsecond, the following ones double. */
+  threshold = NX__SYSTICK_TICK_FREQ / 1000000;
+  for (bucket = 0; bucket < NX_IRQSTATS_BUCKETS - 1 && self >= threshold;
+       bucket++)
+    threshold <<= 1;
+  if (irqstats.vectors[vector].histogram[bucket] != 0xFFFF)
+    irqstats.vectors[vector].histogram[bucket]++;
+}
+
+bool nx_irqstats_enabled(void) {
+#ifdef NX_IRQ_STATS
+  return TRUE;
+#else
+  return FALSE;
+#endif
+}
+
+void nx_irqstats_get(U32 vector, nx_irqstats_t *stats) {
+  U32 count, total, i;
+
+  NX_ASSERT(vector < NX_IRQSTATS_VECTORS);
+  NX_ASSERT(stats != NULL);
+
+  /* Take a coherent copy, the counters are updated from interrupt
+   * handlers.
+   */
+  nx_interrupts_disable();
+  count = irqstats.vectors[vector].count;
+  total = irqstats.vectors[vector].total;
+  stats->count = count;
+  stats->min_ns = TICKS_TO_NS(irqstats.vectors[vector].min);
+  stats->max_ns = TICKS_TO_NS(irqstats.vectors[vector].max);
+  stats->nested = irqstats.vectors[vector].nested;
+  stats->preempted = irqstats.vectors[vector].preempted;
+  stats->max_latency_ns = TICKS_TO_NS(irqstats.vectors[vector].max_latency);
+  for (i = 0; i < NX_IRQSTATS_BUCKETS; i++)
+    stats->histogram[i] = irqstats.vectors[vector].histogram[i];
+  nx_interrupts_enable();
+
+  stats->avg_ns = count ? TICKS_TO_NS(total / count) : 0;
+}
+
+U32 nx_irqstats_get_max_depth(void) {
+  return irqstats.max_depth;
+}
+
+void nx_irqstats_reset(void) {
+  nx_interrupts_disable();
+  memset((void*)irqstats.vectors, 0, sizeof(irqstats.vectors));
+  irqstats.max_depth = irqstats.depth;
+  nx_interrupts_enable();
+}
+
+void nx_irqstats_dump(void) {
+  U32 size = sizeof(irqstats_dump);
+  U32 i;
+
+  irqstats_dump.magic = IRQSTATS_MAGIC;
+  irqstats_dump.n_vectors = NX_IRQSTATS_VECTORS;
+  irqstats_dump.n_buckets = NX_IRQSTATS_BUCKETS;
+  irqstats_dump.max_depth = irqstats.max_depth;
+  for (i = 0; i < NX_IRQSTATS_VECTORS; i++)
+    nx_irqstats_get(i, &irqstats_dump.vectors[i]);
+
+  nx_usb_write((U8*)&size, sizeof(size));
+  nx_usb_write((U8*)&irqstats_dump, size);
+  nx_usb_wait_written(NX_COMPLETION_FOREVER);
+}
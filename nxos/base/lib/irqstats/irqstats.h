@@ -0,0 +1,98 @@
+/** @file irqstats.h
+ *  @brief Interrupt latency and duration statistics.
+ *
+ * Find out which interrupt handlers eat the CPU.
+ */
+
+/* Copyright (c) 2008 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#ifndef __NXOS_BASE_LIB_IRQSTATS_IRQSTATS_H__
+#define __NXOS_BASE_LIB_IRQSTATS_IRQSTATS_H__
+
+#include "base/types.h"
+
+/** @addtogroup lib */
+/*@{*/
+
+/** @defgroup irqstats Interrupt statistics
+ *
+ * When the Baseplate is built with interrupt statistics enabled
+ * (<tt>scons irq_stats=1</tt>), the interrupt dispatcher timestamps
+ * the entry and exit of every interrupt handler, and keeps per-vector
+ * statistics of handler execution time.
+ *
+ * Durations are measured as "self" time: the time spent in nested
+ * higher priority handlers is not accounted to the handler they
+ * interrupted. The time spent in the dispatcher itself is not
+ * accounted either.
+ *
+ * Interrupt latency can only be measured for the system timer, whose
+ * hardware counter tells how long ago the interrupt was raised.
+ *
+ * Without the build option, this library collects nothing, and
+ * nx_irqstats_enabled() returns FALSE.
+ */
+/*@{*/
+
+/** The number of interrupt vectors tracked (all AIC sources). */
+#define NX_IRQSTATS_VECTORS 32
+
+/** The number of buckets in duration histograms. Bucket 0 counts
+ * durations under 1 microsecond, bucket @e n counts durations between
+ * 2^(n-1) and 2^n microseconds, and the last bucket counts everything
+ * longer.
+ */
+#define NX_IRQSTATS_BUCKETS 10
+
+/** Statistics for one interrupt vector. All times are in nanoseconds. */
+typedef struct {
+  U32 count; /**< Number of times the handler ran. */
+  U32 min_ns; /**< Shortest handler run. */
+  U32 avg_ns; /**< Average handler run. */
+  U32 max_ns; /**< Longest handler run. */
+  U32 nested; /**< Runs that preempted another handler. */
+  U32 preempted; /**< Runs that were preempted by another handler. */
+  U32 max_latency_ns; /**< Worst entry latency (system timer only). */
+  U16 histogram[NX_IRQSTATS_BUCKETS]; /**< Duration histogram. */
+} nx_irqstats_t;
+
+/** Check whether interrupt statistics are being collected.
+ *
+ * @return TRUE if the Baseplate was built with interrupt statistics.
+ */
+bool nx_irqstats_enabled(void);
+
+/** Get the statistics of an interrupt vector.
+ *
+ * @param vector The AIC vector (eg. AT91C_ID_SYS).
+ * @param stats Filled with the statistics of @a vector.
+ */
+void nx_irqstats_get(U32 vector, nx_irqstats_t *stats);
+
+/** Return the deepest interrupt nesting seen.
+ *
+ * @return The maximum number of simultaneously active handlers.
+ */
+U32 nx_irqstats_get_max_depth(void);
+
+/** Clear all statistics. */
+void nx_irqstats_reset(void);
+
+/** Send the statistics of all vectors to the USB host.
+ *
+ * The data is sent in the format expected by
+ * usb_console/read_usb_dump.py, and can be decoded with its @c irq
+ * option.
+ */
+void nx_irqstats_dump(void);
+
+/*@}*/
+/*@}*/
+
+#endif /* __NXOS_BASE_LIB_IRQSTATS_IRQSTATS_H__ */
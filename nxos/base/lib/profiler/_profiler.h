@@ -0,0 +1,37 @@
+/** @file _profiler.h
+ *  @brief Sampling profiler internal interface.
+ */
+
+/* Copyright (c) 2008 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#ifndef __NXOS_BASE_LIB_PROFILER__PROFILER_H__
+#define __NXOS_BASE_LIB_PROFILER__PROFILER_H__
+
+#include "base/lib/profiler/profiler.h"
+
+/** @addtogroup kernelinternal */
+/*@{*/
+
+/** @defgroup profilerinternal Sampling profiler
+ */
+/*@{*/
+
+/** Take one sample of the interrupted code.
+ *
+ * Does nothing if the profiler is not running.
+ *
+ * @warning Must be called from the innermost interrupt handler (the
+ * high priority system timer interrupt). Do @b not call directly!
+ */
+void nx__profiler_sample(void);
+
+/*@}*/
+/*@}*/
+
+#endif /* __NXOS_BASE_LIB_PROFILER__PROFILER_H__ */
@@ -0,0 +1,198 @@
+/* Copyright (c) 2008 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#include "base/types.h"
+#include "base/assert.h"
+#include "base/interrupts.h"
+#include "base/_interrupts.h"
+#include "base/asm_decls.h"
+#include "base/memmap.h"
+#include "base/util.h"
+#include "base/drivers/usb.h"
+
+#include "base/lib/profiler/_profiler.h"
+
+/* Magic number at the start of a profile dump ("NXPF"). */
+#define PROFILER_MAGIC 0x4650584E
+
+/* Number of distinct call sites that can be recorded, and how far the
+ * call site hash table is probed before a sample is given up on. The
+ * table size must be a power of two.
+ */
+#define PROFILER_CALLSITES 64
+#define PROFILER_CALLSITE_PROBES 8
+
+/* The profile, as laid out in the profiler buffer and sent to the
+ * host. The bucket histogram follows the call site table: first the
+ * buckets of the text section, then those of the RAM text section.
+ */
+struct profile {
+  U32 magic;
+  U32 samples; /* Total number of samples. */
+  U32 samples_task; /* Samples that interrupted User or System mode. */
+  U32 samples_unknown; /* Samples outside of the kernel code. */
+  U32 callsites_lost; /* Call sites that did not fit in the table. */
+  U32 shift; /* log2 of the number of bytes per bucket. */
+  U32 text_start;
+  U32 text_buckets;
+  U32 ramtext_start;
+  U32 ramtext_buckets;
+  U32 n_callsites;
+  struct {
+    U32 addr;
+    U32 count;
+  } callsites[PROFILER_CALLSITES];
+  U16 buckets[];
+};
+
+static struct {
+  struct profile *profile;
+  U32 size; /* The size of the profile data, in bytes. */
+  volatile bool running;
+} prof = { NULL, 0, FALSE };
+
+void nx_profiler_init(U8 *buf, U32 size) {
+  struct profile *p = (struct profile*)buf;
+  U32 available, shift = 2;
+
+  NX_ASSERT(buf != NULL);
+  NX_ASSERT_MSG(((U32)buf & 0x3) == 0, "Profile buffer\nnot aligned");
+  NX_ASSERT_MSG(size > sizeof(*p) + 64, "Profile buffer\ntoo small");
+
+  prof.running = FALSE;
+
+  /* Find the finest resolution with which both code sections fit in
+   * the buffer.
+   */
+  available = (size - sizeof(*p)) / sizeof(p->buckets[0]);
+  while ((NX_TEXT_SIZE >> shift) + (NX_RAMTEXT_SIZE >> shift) + 2 > available)
+    shift++;
+
+  memset(p, 0, sizeof(*p));
+  p->magic = PROFILER_MAGIC;
+  p->shift = shift;
+  p->text_start = (U32)NX_TEXT_START;
+  p->text_buckets = (NX_TEXT_SIZE >> shift) + 1;
+  p->ramtext_start = (U32)NX_RAMTEXT_START;
+  p->ramtext_buckets = (NX_RAMTEXT_SIZE >> shift) + 1;
+  p->n_callsites = PROFILER_CALLSITES;
+
+  prof.size = sizeof(*p) + sizeof(p->buckets[0]) *
+    (p->text_buckets + p->ramtext_buckets);
+  prof.profile = p;
+
+  nx_profiler_reset();
+}
+
+void nx_profiler_reset(void) {
+  struct profile *p = prof.profile;
+  bool running = prof.running;
+
+  NX_ASSERT(p != NULL);
+
+  prof.running = FALSE;
+  p->samples = p->samples_task = p->samples_unknown = 0;
+  p->callsites_lost = 0;
+  memset(p->callsites, 0, sizeof(p->callsites));
+  memset(p->buckets, 0, prof.size - sizeof(*p));
+  prof.running = running;
+}
+
+void nx_profiler_start(void) {
+  NX_ASSERT(prof.profile != NULL);
+  prof.running = TRUE;
+}
+
+void nx_profiler_stop(void) {
+  prof.running = FALSE;
+}
+
+U32 nx_profiler_get_samples(void) {
+  return prof.profile ? prof.profile->samples : 0;
+}
+
+void nx_profiler_dump(void) {
+  bool running = prof.running;
+  U32 size = prof.size;
+
+  NX_ASSERT(prof.profile != NULL);
+
+  prof.running = FALSE;
+  nx_usb_write((U8*)&size, sizeof(size));
+  nx_usb_write((U8*)prof.profile, size);
+  nx_usb_wait_written(NX_COMPLETION_FOREVER);
+  prof.running = running;
+}
+
+/* Count a sample in the bucket covering @a pc. */
+static inline void profiler_count_pc(struct profile *p, U32 pc) {
+  U32 offset, bucket;
+
+  offset = pc - p->text_start;
+  if (offset < NX_TEXT_SIZE) {
+    bucket = offset >> p->shift;
+  } else {
+    offset = pc - p->ramtext_start;
+    if (offset >= NX_RAMTEXT_SIZE) {
+      p->samples_unknown++;
+      return;
+    }
+    bucket = p->text_buckets + (offset >> p->shift);
+  }
+
+  /* Saturate rather than wrap around. */
+  if (p->buckets[bucket] != 0xFFFF)
+    p->buckets[bucket]++;
+}
+
+/* Count a sample for the call site returning to @a lr. */
+static inline void profiler_count_callsite(struct profile *p, U32 lr) {
+  U32 i, slot;
+
+  lr &= ~0x1;
+  slot = lr >> 2;
+  for (i = 0; i < PROFILER_CALLSITE_PROBES; i++, slot++) {
+    slot &= PROFILER_CALLSITES - 1;
+    if (p->callsites[slot].addr == lr) {
+      p->callsites[slot].count++;
+      return;
+    } else if (p->callsites[slot].count == 0) {
+      p->callsites[slot].addr = lr;
+      p->callsites[slot].count = 1;
+      return;
+    }
+  }
+
+  p->callsites_lost++;
+}
+
+void nx__profiler_sample(void) {
+  struct profile *p = prof.profile;
+  U32 *frame, cpsr, lr;
+
+  if (!prof.running)
+    return;
+
+  /* The interrupted state is described by the IRQ stack frame (CPSR
+   * and PC), and by the registers that the IRQ handler saved on the
+   * interrupted task's stack, or on the Supervisor stack.
+   */
+  frame = nx__interrupts_get_irq_frame();
+  cpsr = frame[0];
+
+  if ((cpsr & 0x1F) == MODE_USR || (cpsr & 0x1F) == MODE_SYS) {
+    p->samples_task++;
+    lr = ((nx_task_stack_t*)nx__irq_saved_state)->lr;
+  } else {
+    lr = nx__irq_saved_state[13];
+  }
+
+  p->samples++;
+  profiler_count_pc(p, frame[1]);
+  profiler_count_callsite(p, lr);
+}
@@ -0,0 +1,79 @@
+/** @file profiler.h
+ *  @brief Statistical PC-sampling profiler.
+ *
+ * Find out where the CPU time goes.
+ */
+
+/* Copyright (c) 2008 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#ifndef __NXOS_BASE_LIB_PROFILER_PROFILER_H__
+#define __NXOS_BASE_LIB_PROFILER_PROFILER_H__
+
+#include "base/types.h"
+
+/** @addtogroup lib */
+/*@{*/
+
+/** @defgroup profiler Sampling profiler
+ *
+ * The profiler samples the program counter of the interrupted code on
+ * every system timer tick (1000 times a second), and counts the
+ * samples in a histogram of the kernel's code. The return address of
+ * the interrupted code is also sampled, to build a table of the most
+ * frequent call sites.
+ *
+ * The histogram can be sent over USB with nx_profiler_dump(), and
+ * usb_console/profile.py symbolizes it against the kernel ELF file to
+ * print a flat profile and a call-site table.
+ *
+ * @note Code running with interrupts disabled, and the system timer
+ * interrupt itself, are invisible to the profiler. Work that is
+ * synchronized with the system timer will also be over- or
+ * under-represented.
+ */
+/*@{*/
+
+/** Initialize the profiler.
+ *
+ * The histogram is built in the given buffer. The larger the buffer,
+ * the finer the address resolution of the histogram: a few kilobytes
+ * is usually enough to pinpoint individual functions.
+ *
+ * @param buf The buffer to use. Must be word-aligned.
+ * @param size The size of @a buf.
+ */
+void nx_profiler_init(U8 *buf, U32 size);
+
+/** Clear all samples collected so far. */
+void nx_profiler_reset(void);
+
+/** Start sampling. */
+void nx_profiler_start(void);
+
+/** Stop sampling. */
+void nx_profiler_stop(void);
+
+/** Return the number of samples collected so far.
+ *
+ * @return The number of samples.
+ */
+U32 nx_profiler_get_samples(void);
+
+/** Send the profile to the USB host.
+ *
+ * Sampling is stopped during the transfer. The data is sent in the
+ * format expected by usb_console/read_usb_dump.py: a 32-bit size,
+ * followed by the raw profile data.
+ */
+void nx_profiler_dump(void);
+
+/*@}*/
+/*@}*/
+
+#endif /* __NXOS_BASE_LIB_PROFILER_PROFILER_H__ */
@@ -0,0 +1,46 @@
+/** @file _tracing.h
+ *  @brief Data tracer internal interface.
+ */
+
+/* Copyright (c) 2008 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#ifndef __NXOS_BASE_LIB_TRACING__TRACING_H__
+#define __NXOS_BASE_LIB_TRACING__TRACING_H__
+
+#include "base/lib/tracing/tracing.h"
+
+/** @addtogroup kernelinternal */
+/*@{*/
+
+/** @defgroup tracinginternal Data tracer streaming
+ *
+ * The streaming mode of the tracer is driven by the system timer.
+ */
+/*@{*/
+
+/** Check whether the trace stream needs draining.
+ *
+ * @return TRUE if the tracer is streaming.
+ */
+bool nx__tracing_drain_pending(void);
+
+/** Push buffered trace events to the USB host.
+ *
+ * Called from the low-priority system timer interrupt. Sends at most
+ * one chunk of events at a time, and only when the USB bus is idle.
+ *
+ * @warning Called by the systick driver when appropriate. Do @b not
+ * call directly!
+ */
+void nx__tracing_drain(void);
+
+/*@}*/
+/*@}*/
+
+#endif /* __NXOS_BASE_LIB_TRACING__TRACING_H__ */
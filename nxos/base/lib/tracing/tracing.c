@@ -14,26 +14,57 @@
 #include "base/interrupts.h"
 #include "base/memmap.h"
 #include "base/util.h"
+#include "base/ring.h"
+#include "base/drivers/systick.h"
 #include "base/drivers/usb.h"
 
-#include "base/lib/tracing/tracing.h"
+#include "base/lib/tracing/_tracing.h"
+
+/* The maximum number of events pushed to the USB controller in one
+ * go while streaming. Kept small, so that the ring space held by the
+ * transfer in flight is released quickly.
+ */
+#define TRACE_CHUNK_EVENTS 64
 
 static struct {
+  /* Recording mode of the tracer. */
+  enum {
+    TRACE_OFF = 0, /* Not initialized. */
+    TRACE_LINEAR, /* Fill the buffer once. */
+    TRACE_STREAM, /* Use the buffer as a ring drained over USB. */
+  } mode;
+
   U8 *start;
   U8 *cur;
   U8 *end;
-} trace = { NULL, NULL, NULL };
+
+  /* The ring of events used in streaming mode, which reuses the
+   * trace buffer. The producers serialize by disabling interrupts,
+   * and the drain is the only consumer.
+   */
+  nx_ring_t ring;
+  U32 in_flight; /* Bytes at the tail handed to the USB driver. */
+
+  /* Events lost because the buffer was full. */
+  U32 dropped;
+  U32 dropped_reported;
+} trace = { TRACE_OFF, NULL, NULL, NULL, { NULL, 0, 0, 0 }, 0, 0, 0 };
 
 void nx_tracing_init(U8 *start, U32 size) {
   NX_ASSERT(start != NULL);
   NX_ASSERT(size > 0);
 
+  nx_interrupts_disable();
   trace.start = trace.cur = start;
   trace.end = start + size;
+  trace.dropped = trace.dropped_reported = 0;
+  trace.mode = TRACE_LINEAR;
+  nx_interrupts_enable();
 }
 
 void nx_tracing_add_data(const U8 *data, U32 size) {
   NX_ASSERT(trace.end != NULL);
+  NX_ASSERT_MSG(trace.mode == TRACE_LINEAR, "Trace streaming");
   NX_ASSERT_MSG(trace.cur + size <= trace.end,
                 "Trace buffer full");
 
@@ -44,9 +75,10 @@ void nx_tracing_add_data(const U8 *data, U32 size) {
 
 void nx_tracing_add_string(const char *str) {
   NX_ASSERT(trace.end != NULL);
+  NX_ASSERT_MSG(trace.mode == TRACE_LINEAR, "Trace streaming");
 
   while (*str) {
-    NX_ASSERT_MSG(trace.cur > trace.end,
+    NX_ASSERT_MSG(trace.cur < trace.end,
                   "Trace buffer full");
     *trace.cur++ = *str++;
   }
@@ -54,6 +86,7 @@ void nx_tracing_add_string(const char *str) {
 
 void nx_tracing_add_char(const char val) {
   NX_ASSERT(trace.end != NULL);
+  NX_ASSERT_MSG(trace.mode == TRACE_LINEAR, "Trace streaming");
   NX_ASSERT(trace.cur < trace.end);
 
   *trace.cur++ = val;
@@ -66,3 +99,151 @@ U8 *nx_tracing_get_start() {
 U32 nx_tracing_get_size() {
   return trace.cur - trace.start;
 }
+
+/* Store one event in the trace. Must be called with interrupts
+ * disabled.
+ */
+static bool trace_store(const nx_trace_event_t *ev) {
+  if (trace.mode == TRACE_STREAM) {
+    return nx_ring_put(&trace.ring, ev, sizeof(*ev));
+  } else {
+    if (trace.cur + sizeof(*ev) > trace.end)
+      return FALSE;
+
+    memcpy(trace.cur, ev, sizeof(*ev));
+    trace.cur += sizeof(*ev);
+  }
+
+  return TRUE;
+}
+
+/* Store an event, accounting for it if it is dropped. If events were
+ * dropped previously, a record saying so is inserted first, so that
+ * the host knows where the hole in the timeline is.
+ */
+static void trace_push(U32 time, nx_trace_kind_t kind,
+                       nx_trace_track_t track, U16 id) {
+  nx_trace_event_t ev;
+
+  nx_interrupts_disable();
+
+  if (trace.dropped != trace.dropped_reported) {
+    ev.time = trace.dropped - trace.dropped_reported;
+    ev.kind = NX_TRACE_DROPPED;
+    ev.track = track;
+    ev.id = 0;
+    if (trace_store(&ev))
+      trace.dropped_reported = trace.dropped;
+  }
+
+  ev.time = time;
+  ev.kind = kind;
+  ev.track = track;
+  ev.id = id;
+
+  if (trace.dropped != trace.dropped_reported || !trace_store(&ev)) {
+    trace.dropped++;
+  }
+
+  nx_interrupts_enable();
+}
+
+void nx_tracing_add_event(nx_trace_kind_t kind, nx_trace_track_t track,
+                          U16 id) {
+  if (trace.mode == TRACE_OFF)
+    return;
+
+  trace_push(nx_systick_get_us(), kind, track, id);
+}
+
+void nx_tracing_add_name(nx_trace_track_t track, U16 id, const char *name) {
+  U32 chars;
+  int i;
+
+  if (trace.mode == TRACE_OFF)
+    return;
+
+  /* Four characters per record, the last record always holds at
+   * least one NUL to terminate the name.
+   */
+  do {
+    chars = 0;
+    for (i = 0; i < 4 && name[i]; i++)
+      chars |= (U32)(U8)name[i] << (8 * i);
+    name += i;
+    trace_push(chars, NX_TRACE_NAME, track, id);
+  } while (i == 4);
+}
+
+void nx_tracing_stream_start(void) {
+  U32 start, events;
+
+  NX_ASSERT(trace.mode != TRACE_OFF);
+
+  nx_interrupts_disable();
+
+  /* The ring holds whole events, so align it on a word boundary, and
+   * size it so that no event wraps around its end.
+   */
+  start = ((U32)trace.start + 3) & ~0x3;
+  events = ((U32)trace.end - start) / sizeof(nx_trace_event_t);
+  NX_ASSERT(events > 0);
+  nx_ring_init(&trace.ring, (void*)start,
+               events * sizeof(nx_trace_event_t));
+
+  trace.in_flight = 0;
+  trace.dropped = trace.dropped_reported = 0;
+  trace.mode = TRACE_STREAM;
+
+  nx_interrupts_enable();
+
+  /* Mark the start of the stream, so that the host can check it is
+   * in sync with the record boundaries.
+   */
+  trace_push(NX_TRACE_SYNC_MAGIC, NX_TRACE_SYNC, 0, 0);
+}
+
+void nx_tracing_stream_stop(void) {
+  nx_interrupts_disable();
+  if (trace.mode == TRACE_STREAM) {
+    trace.cur = trace.start;
+    trace.mode = TRACE_LINEAR;
+  }
+  nx_interrupts_enable();
+}
+
+U32 nx_tracing_get_dropped(void) {
+  return trace.dropped;
+}
+
+bool nx__tracing_drain_pending(void) {
+  return trace.mode == TRACE_STREAM;
+}
+
+void nx__tracing_drain(void) {
+  U8 *data;
+  U32 n;
+
+  if (trace.mode != TRACE_STREAM || !nx_usb_can_write())
+    return;
+
+  /* The USB bus being idle again means that the previous chunk made
+   * it to the host, and that its space can be reused.
+   */
+  if (trace.in_flight > 0) {
+    nx_ring_consume(&trace.ring, trace.in_flight);
+    trace.in_flight = 0;
+  }
+
+  /* Send the next contiguous run of events. The producers only ever
+   * add to the ring meanwhile, so a stale view just means a smaller
+   * chunk.
+   */
+  n = nx_ring_peek(&trace.ring, &data);
+  n = MIN(n, TRACE_CHUNK_EVENTS * sizeof(nx_trace_event_t));
+  if (n == 0)
+    return;
+
+  trace.in_flight = n;
+  nx_usb_write(data, n);
+}
@@ -30,9 +30,56 @@
  * driver in the Baseplate. The tracer was used to record the bus
  * state at regular intervals, to visualize the progress of I2C
  * transactions as the driver was being debugged.
+ *
+ * In addition to raw data, the tracer can record timeline events
+ * (interrupt handlers, task switches, driver activity) as fixed size
+ * records. Instead of filling the buffer once, the tracer can also
+ * be switched into streaming mode, where the buffer becomes a ring
+ * that is drained to the USB host in the background, from the
+ * low-priority system timer interrupt. The usb_console/trace_timeline.py
+ * tool converts such a stream into a timeline viewable in Perfetto
+ * or chrome://tracing.
  */
 /*@{*/
 
+/** The kind of a timeline event. */
+typedef enum {
+  NX_TRACE_BEGIN = 1, /**< An activity on a track begins. */
+  NX_TRACE_END, /**< The current activity on a track ends. */
+  NX_TRACE_INSTANT, /**< A point event. */
+  NX_TRACE_NAME, /**< Four characters of a track name, in the time field. */
+  NX_TRACE_DROPPED, /**< Records were lost, the count is in the time field. */
+  NX_TRACE_SYNC, /**< Start of a stream, #NX_TRACE_SYNC_MAGIC in the time field. */
+} nx_trace_kind_t;
+
+/** The timeline tracks events can be recorded on. */
+typedef enum {
+  NX_TRACE_TRACK_IRQ = 0, /**< Interrupt handlers, id is the AIC vector. */
+  NX_TRACE_TRACK_TASK, /**< Application kernel tasks. */
+  NX_TRACE_TRACK_DRIVER, /**< Driver activity, id is one of nx_trace_driver_t. */
+  NX_TRACE_TRACK_USER, /**< Free for application kernel use. */
+} nx_trace_track_t;
+
+/** Well known ids on the driver track. */
+typedef enum {
+  NX_TRACE_DRIVER_AVR = 0, /**< The AVR coprocessor link. */
+  NX_TRACE_DRIVER_I2C0, /**< Software I2C, sensor port 1. The other
+                         * ports follow. */
+} nx_trace_driver_t;
+
+/** The value of the time field of a #NX_TRACE_SYNC record ("NXTR"). */
+#define NX_TRACE_SYNC_MAGIC 0x5254584E
+
+/** A timeline event, as it is stored in the trace buffer and sent to
+ * the host (little-endian).
+ */
+typedef struct {
+  U32 time; /**< Timestamp in microseconds, or record payload. */
+  U8 kind; /**< One of nx_trace_kind_t. */
+  U8 track; /**< One of nx_trace_track_t. */
+  U16 id; /**< The entity within the track. */
+} nx_trace_event_t;
+
 /** Initialize the data tracer.
  *
  * @param start Pointer to the start of the dump area.
@@ -78,6 +125,51 @@ U8 *nx_tracing_get_start(void);
  */
 U32 nx_tracing_get_size(void);
 
+/** Record a timeline event.
+ *
+ * This function may be called from any context, including interrupt
+ * handlers. It does nothing if the tracer is not initialized. If the
+ * trace buffer is full, the event is dropped and accounted for.
+ *
+ * @param kind The kind of event.
+ * @param track The track on which the event happens.
+ * @param id The entity (interrupt vector, task...) on @a track.
+ */
+void nx_tracing_add_event(nx_trace_kind_t kind, nx_trace_track_t track,
+                          U16 id);
+
+/** Give a human readable name to an entity of a track.
+ *
+ * The name is recorded as a sequence of #NX_TRACE_NAME records, and
+ * is picked up by the host tool when it decodes the trace.
+ *
+ * @param track The track of the entity.
+ * @param id The entity to name.
+ * @param name The name.
+ */
+void nx_tracing_add_name(nx_trace_track_t track, U16 id, const char *name);
+
+/** Start streaming the trace to the USB host.
+ *
+ * The trace buffer is reset, and from then on used as a ring of
+ * events, which is drained over USB in the background as fast as the
+ * host reads it. Raw data cannot be recorded while streaming.
+ */
+void nx_tracing_stream_start(void);
+
+/** Stop streaming the trace.
+ *
+ * Events still in the buffer are discarded, and the tracer goes back
+ * to recording in its buffer.
+ */
+void nx_tracing_stream_stop(void);
+
+/** Return the number of events dropped because the buffer was full.
+ *
+ * @return The number of dropped events since the last reset.
+ */
+U32 nx_tracing_get_dropped(void);
+
 /*@}*/
 /*@}*/
 
@@ -24,14 +24,63 @@
  * synchronization primitives cannot be provided. On the other hand, the
  * kernel does provide some basic functions that can be of use to
  * implement higher level primitives.
+ *
+ * The NXT has a single core, so the only concurrency to guard against
+ * is preemption by an interrupt handler. Roughly from cheapest to most
+ * expensive (see the speedtest system for cycle counts):
+ *
+ *  - A seqlock lets a task read a multi-word state that an interrupt
+ *    handler updates, without ever masking interrupts.
+ *  - nx_atomic_cmpxchg32() and nx_atomic_add32() update a single word.
+ *  - nx_critical_enter() and nx_critical_exit() protect anything
+ *    else. They nest, and can be used in interrupt handlers.
+ *  - nx_interrupts_disable() and nx_interrupts_enable() do the same
+ *    with a global nesting counter instead of a saved mask.
+ */
+/*@{*/
+
+/** @name Critical sections
+ *
+ * A critical section masks IRQ and FIQ, and restores the mask that
+ * was in effect on entry when it ends. Critical sections can therefore
+ * be nested, and entered from interrupt handlers, without the global
+ * counter of nx_interrupts_disable().
+ *
+ * @code
+ * U32 state = nx_critical_enter();
+ * ... touch state shared with an interrupt handler ...
+ * nx_critical_exit(state);
+ * @endcode
+ *
+ * @warning The same limits apply as for nx_interrupts_disable(): keep
+ * critical sections to a few microseconds.
  */
 /*@{*/
 
+/** Mask interrupts, and return the previous mask.
+ *
+ * @return The value to pass to the matching nx_critical_exit().
+ */
+U32 nx_critical_enter(void);
+
+/** Restore the interrupt mask saved by nx_critical_enter().
+ *
+ * @param state The value returned by the matching nx_critical_enter().
+ */
+void nx_critical_exit(U32 state);
+
+/*@}*/
+
 /** @name Atomic memory access
  *
- * These functions provide thin wrappers around the ARM7 atomic swapping
- * operations. These are guaranteed by the architecture to be atomic,
- * since the memory bus is kept locked for a read plus a write.
+ * nx_atomic_cas32() and nx_atomic_cas8() are thin wrappers around the
+ * ARM7 atomic swapping operations. These are guaranteed by the
+ * architecture to be atomic, since the memory bus is kept locked for a
+ * read plus a write. Despite their names, they swap unconditionally.
+ *
+ * The ARM7 has no conditional store, so real compare-and-swap and
+ * fetch-and-add are done with interrupts masked for a few
+ * instructions, running from RAM.
  **/
 /*@{*/
 
@@ -55,6 +104,24 @@ U32 nx_atomic_cas32(U32 *dest, U32 val);
  */
 U8 nx_atomic_cas8(U8 *dest, U8 val);
 
+/** Atomically replace @a old by @a val at @a dest.
+ *
+ * @param dest The address of the value to update.
+ * @param old The value expected at @a dest.
+ * @param val The new value, written only if @a dest held @a old.
+ * @return The previous value at @a dest. The update was made if and
+ * only if it is equal to @a old.
+ */
+U32 nx_atomic_cmpxchg32(volatile U32 *dest, U32 old, U32 val);
+
+/** Atomically add @a delta to the value at @a dest.
+ *
+ * @param dest The address of the value to update.
+ * @param delta The amount to add. Negate it to subtract.
+ * @return The value at @a dest before the addition.
+ */
+U32 nx_atomic_add32(volatile U32 *dest, U32 delta);
+
 /*@}*/
 
 /** @name Spinlocks
@@ -68,6 +135,13 @@ U8 nx_atomic_cas8(U8 *dest, U8 val);
  * need to synchronize between the main execution context and an
  * interrupt handler, or some other form of preemption that can break
  * free of the spinlock's infinite loop.
+ *
+ * @warning The main context may spin waiting for an interrupt handler,
+ * but never the other way around: an interrupt handler that spins on
+ * a lock held by the code it interrupted deadlocks, since that code
+ * can't run until the handler returns. Interrupt handlers must use
+ * nx_spinlock_try_acquire(), or the lock holder must use a critical
+ * section instead.
  */
 /*@{*/
 
@@ -96,7 +170,7 @@ void nx_spinlock_acquire(spinlock *lock);
  * @param lock Pointer to the spinlock to acquire.
  * @return 1 if the spinlock was acquired, 0 if it was already locked.
  */
-void nx_spinlock_try_acquire(spinlock *lock);
+bool nx_spinlock_try_acquire(spinlock *lock);
 
 /** Release @a lock.
  *
@@ -110,6 +184,86 @@ static inline void nx_spinlock_release(spinlock *lock) {
   *lock = 0;
 }
 
+/*@}*/
+
+/** @name Seqlocks
+ *
+ * A seqlock protects a multi-word state written by one writer, usually
+ * an interrupt handler, and read by code that it can preempt. The
+ * writer never waits, and readers never mask interrupts: they retry
+ * their read if a write happened meanwhile.
+ *
+ * @code
+ * do {
+ *   seq = nx_seqlock_read_begin(&lock);
+ *   copy = state;
+ * } while (nx_seqlock_read_retry(&lock, seq));
+ * @endcode
+ *
+ * Writes must be serialized, by having a single writer or by writing
+ * in a critical section.
+ *
+ * @warning A reader that preempts a writer will retry forever, since
+ * the write can't finish until the reader returns. Don't read from an
+ * interrupt handler of higher priority than the writer.
+ */
+/*@{*/
+
+/** A seqlock. The sequence count is odd while a write is in progress. */
+typedef struct {
+  volatile U32 seq; /**< Sequence count. */
+} nx_seqlock_t;
+
+/** Initial value for a seqlock. */
+#define NX_SEQLOCK_INIT { 0 }
+
+/** Compiler barrier. The ARM7 has no cache and doesn't reorder memory
+ * accesses, so only the compiler has to be kept in order.
+ */
+#define nx__seqlock_barrier() asm volatile("" ::: "memory")
+
+/** Start writing the state protected by @a lock.
+ *
+ * @param lock The seqlock.
+ */
+static inline void nx_seqlock_write_begin(nx_seqlock_t *lock) {
+  lock->seq++;
+  nx__seqlock_barrier();
+}
+
+/** Finish writing the state protected by @a lock.
+ *
+ * @param lock The seqlock.
+ */
+static inline void nx_seqlock_write_end(nx_seqlock_t *lock) {
+  nx__seqlock_barrier();
+  lock->seq++;
+}
+
+/** Start reading the state protected by @a lock.
+ *
+ * @param lock The seqlock.
+ * @return The sequence count to pass to nx_seqlock_read_retry().
+ */
+static inline U32 nx_seqlock_read_begin(nx_seqlock_t *lock) {
+  U32 seq = lock->seq;
+
+  nx__seqlock_barrier();
+  return seq;
+}
+
+/** Check whether a read must be retried.
+ *
+ * @param lock The seqlock.
+ * @param seq The value returned by nx_seqlock_read_begin().
+ * @return TRUE if the state was being written, or was written, during
+ * the read.
+ */
+static inline bool nx_seqlock_read_retry(nx_seqlock_t *lock, U32 seq) {
+  nx__seqlock_barrier();
+  return (seq & 1) || lock->seq != seq;
+}
+
 /*@}*/
 /*@}*/
 /*@}*/
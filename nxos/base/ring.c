@@ -0,0 +1,143 @@
+/* Copyright (c) 2008 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#include "base/types.h"
+#include "base/assert.h"
+#include "base/util.h"
+
+#include "base/ring.h"
+
+/* The head and tail run from 0 to twice the buffer size. This tells a
+ * full ring (head - tail == size) from an empty one (head == tail)
+ * without wasting a slot, and wraps with a comparison rather than a
+ * division, which the ARM7 doesn't have.
+ *
+ * The ARM7 has no cache and doesn't reorder memory accesses, so the
+ * only ordering to enforce is the compiler's: the data must be
+ * copied before the index that publishes it is stored.
+ */
+#define ring_barrier() asm volatile("" : : : "memory")
+
+static inline U32 ring_advance(const nx_ring_t *ring, U32 index, U32 n) {
+  index += n;
+  if (index >= 2 * ring->size)
+    index -= 2 * ring->size;
+  return index;
+}
+
+static inline U32 ring_offset(const nx_ring_t *ring, U32 index) {
+  return (index < ring->size) ? index : index - ring->size;
+}
+
+static inline U32 ring_used(const nx_ring_t *ring, U32 head, U32 tail) {
+  return (head >= tail) ? head - tail : head + 2 * ring->size - tail;
+}
+
+void nx_ring_init(nx_ring_t *ring, void *buf, U32 size) {
+  NX_ASSERT(ring != NULL);
+  NX_ASSERT(buf != NULL);
+  NX_ASSERT(size > 0 && size < 0x80000000);
+
+  ring->buf = buf;
+  ring->size = size;
+  ring->head = 0;
+  ring->tail = 0;
+}
+
+U32 nx_ring_count(const nx_ring_t *ring) {
+  return ring_used(ring, ring->head, ring->tail);
+}
+
+U32 nx_ring_space(const nx_ring_t *ring) {
+  return ring->size - ring_used(ring, ring->head, ring->tail);
+}
+
+/* Copy @a len bytes in at @a head, which the producer owns. */
+static void ring_copy_in(nx_ring_t *ring, U32 head,
+                         const U8 *data, U32 len) {
+  U32 offset = ring_offset(ring, head);
+  U32 first = MIN(len, ring->size - offset);
+
+  memcpy(ring->buf + offset, data, first);
+  if (len > first)
+    memcpy(ring->buf, data + first, len - first);
+}
+
+/* Copy @a len bytes out from @a tail, which the consumer owns. */
+static void ring_copy_out(nx_ring_t *ring, U32 tail, U8 *data, U32 len) {
+  U32 offset = ring_offset(ring, tail);
+  U32 first = MIN(len, ring->size - offset);
+
+  memcpy(data, ring->buf + offset, first);
+  if (len > first)
+    memcpy(data + first, ring->buf, len - first);
+}
+
+U32 nx_ring_write(nx_ring_t *ring, const void *data, U32 len) {
+  U32 head = ring->head;
+
+  len = MIN(len, ring->size - ring_used(ring, head, ring->tail));
+  if (len == 0)
+    return 0;
+
+  ring_copy_in(ring, head, data, len);
+  ring_barrier();
+  ring->head = ring_advance(ring, head, len);
+
+  return len;
+}
+
+U32 nx_ring_read(nx_ring_t *ring, void *data, U32 len) {
+  U32 tail = ring->tail;
+
+  len = MIN(len, ring_used(ring, ring->head, tail));
+  if (len == 0)
+    return 0;
+
+  ring_barrier();
+  ring_copy_out(ring, tail, data, len);
+  ring_barrier();
+  ring->tail = ring_advance(ring, tail, len);
+
+  return len;
+}
+
+bool nx_ring_put(nx_ring_t *ring, const void *data, U32 len) {
+  if (nx_ring_space(ring) < len)
+    return FALSE;
+
+  nx_ring_write(ring, data, len);
+  return TRUE;
+}
+
+bool nx_ring_get(nx_ring_t *ring, void *data, U32 len) {
+  if (nx_ring_count(ring) < len)
+    return FALSE;
+
+  nx_ring_read(ring, data, len);
+  return TRUE;
+}
+
+U32 nx_ring_peek(nx_ring_t *ring, U8 **data) {
+  U32 tail = ring->tail;
+  U32 offset = ring_offset(ring, tail);
+  U32 used = ring_used(ring, ring->head, tail);
+
+  ring_barrier();
+  *data = ring->buf + offset;
+  return MIN(used, ring->size - offset);
+}
+
+void nx_ring_consume(nx_ring_t *ring, U32 len) {
+  U32 tail = ring->tail;
+
+  NX_ASSERT(len <= ring_used(ring, ring->head, tail));
+
+  ring_barrier();
+  ring->tail = ring_advance(ring, tail, len);
+}
@@ -0,0 +1,156 @@
+/** @file ring.h
+ *  @brief Single producer, single consumer ring buffers.
+ */
+
+/* Copyright (c) 2008 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#ifndef __NXOS_BASE_RING_H__
+#define __NXOS_BASE_RING_H__
+
+#include "base/types.h"
+
+/** @addtogroup kernel */
+/*@{*/
+
+/** @defgroup ring Ring buffers
+ *
+ * A ring buffer carries bytes from one producer to one consumer, for
+ * example from an interrupt handler to the code processing its data.
+ *
+ * The producer only ever writes the head of the ring, and the
+ * consumer only ever writes its tail. Both are single word stores, so
+ * neither side needs to disable interrupts or to use atomic
+ * instructions: with exactly one producer and one consumer, each
+ * operation completes in a bounded number of steps, whatever the
+ * other side is doing. If there are several producers (or consumers),
+ * they must serialize among themselves, for example by disabling
+ * interrupts.
+ *
+ * Data can be moved by bytes, with nx_ring_write() and nx_ring_read()
+ * which transfer as much as possible, or by records, with
+ * nx_ring_put() and nx_ring_get() which transfer all or nothing. A
+ * record put in one call is seen by the consumer in one piece, so a
+ * small header and its payload can be queued together as a single
+ * record. The consumer can also process the data in place, with
+ * nx_ring_peek() and nx_ring_consume().
+ *
+ * The buffer can be of any size: the ring is full when it holds that
+ * many bytes, there is no wasted slot.
+ */
+/*@{*/
+
+/** A ring buffer.
+ *
+ * Rings are allocated by the caller, usually statically, and
+ * initialized with nx_ring_init(). The fields are private.
+ */
+typedef struct {
+  U8 *buf; /**< The storage. */
+  U32 size; /**< Size of the storage, in bytes. */
+  volatile U32 head; /**< Next byte to write, only set by the producer. */
+  volatile U32 tail; /**< Next byte to read, only set by the consumer. */
+} nx_ring_t;
+
+/** Initialize @a ring, empty, on top of @a buf.
+ *
+ * Neither side may use the ring while it is being initialized.
+ *
+ * @param ring The ring.
+ * @param buf The storage, which must stay allocated while the ring
+ * is in use.
+ * @param size The size of @a buf in bytes.
+ */
+void nx_ring_init(nx_ring_t *ring, void *buf, U32 size);
+
+/** Get the number of bytes waiting in @a ring.
+ *
+ * Exact for the consumer. For anyone else, it may already be out of
+ * date.
+ *
+ * @param ring The ring.
+ * @return The number of bytes that can be read.
+ */
+U32 nx_ring_count(const nx_ring_t *ring);
+
+/** Get the free space in @a ring.
+ *
+ * Exact for the producer. For anyone else, it may already be out of
+ * date.
+ *
+ * @param ring The ring.
+ * @return The number of bytes that can be written.
+ */
+U32 nx_ring_space(const nx_ring_t *ring);
+
+/** Write up to @a len bytes from @a data. Producer only.
+ *
+ * @param ring The ring.
+ * @param data The data to write.
+ * @param len The amount of data to write.
+ * @return The number of bytes written, less than @a len if the ring
+ * filled up.
+ */
+U32 nx_ring_write(nx_ring_t *ring, const void *data, U32 len);
+
+/** Read up to @a len bytes into @a data. Consumer only.
+ *
+ * @param ring The ring.
+ * @param data The buffer to read into.
+ * @param len The size of @a data.
+ * @return The number of bytes read, less than @a len if the ring
+ * emptied.
+ */
+U32 nx_ring_read(nx_ring_t *ring, void *data, U32 len);
+
+/** Write a record of @a len bytes, if there is room for all of it.
+ * Producer only.
+ *
+ * @param ring The ring.
+ * @param data The record.
+ * @param len The size of the record.
+ * @return TRUE if the record was written, FALSE if the ring is too
+ * full.
+ */
+bool nx_ring_put(nx_ring_t *ring, const void *data, U32 len);
+
+/** Read a record of @a len bytes, if that many are available.
+ * Consumer only.
+ *
+ * @param ring The ring.
+ * @param data The buffer to read the record into.
+ * @param len The size of the record.
+ * @return TRUE if the record was read, FALSE if the ring holds less.
+ */
+bool nx_ring_get(nx_ring_t *ring, void *data, U32 len);
+
+/** Get the waiting data that is contiguous in memory, without
+ * removing it. Consumer only.
+ *
+ * Once processed, the data is removed with nx_ring_consume(). Until
+ * then, the producer doesn't overwrite it.
+ *
+ * @param ring The ring.
+ * @param data Set to the start of the data.
+ * @return The number of contiguous bytes at @a data. Further data may
+ * be waiting at the start of the buffer.
+ */
+U32 nx_ring_peek(nx_ring_t *ring, U8 **data);
+
+/** Remove @a len bytes from the ring. Consumer only.
+ *
+ * @param ring The ring.
+ * @param len The number of bytes to remove, at most the count of
+ * waiting bytes.
+ */
+void nx_ring_consume(nx_ring_t *ring, U32 len);
+
+/*@}*/
+/*@}*/
+
+#endif /* __NXOS_BASE_RING_H__ */
@@ -0,0 +1,223 @@
+/* Copyright (c) 2008 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#include "base/types.h"
+#include "base/assert.h"
+#include "base/interrupts.h"
+#include "base/workqueue.h"
+#include "base/drivers/systick.h"
+
+#include "base/_timer.h"
+
+/* Timers are kept in a two level timer wheel, like Marvin's sleep
+ * alarms. The near wheel has one slot per millisecond for the next
+ * TIMER_NEAR_SPAN milliseconds, the far wheel one slot per
+ * TIMER_NEAR_SPAN milliseconds up to TIMER_FAR_SPAN milliseconds.
+ * Timers further away wait in an overflow list.
+ *
+ * Every TIMER_NEAR_SPAN milliseconds, the next far slot is cascaded
+ * into the near wheel, and every TIMER_FAR_SPAN milliseconds the
+ * overflow list is cascaded into the wheels.
+ */
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SLOTS - 1)
+#define TIMER_NEAR_SPAN TIMER_WHEEL_SLOTS
+#define TIMER_FAR_SPAN (TIMER_WHEEL_SLOTS * TIMER_WHEEL_SLOTS)
+
+/* The timer wheels. Protected by disabling interrupts. */
+static struct {
+  nx_timer_t *near[TIMER_WHEEL_SLOTS];
+  nx_timer_t *far[TIMER_WHEEL_SLOTS];
+  nx_timer_t *overflow;
+
+  U32 time; /* The time the wheels have been advanced to. */
+  U32 armed; /* The number of armed timers. */
+} timers;
+
+static void timer_link(nx_timer_t **slot, nx_timer_t *timer) {
+  timer->slot = slot;
+  timer->prev = NULL;
+  timer->next = *slot;
+  if (*slot)
+    (*slot)->prev = timer;
+  *slot = timer;
+  timers.armed++;
+}
+
+static void timer_unlink(nx_timer_t *timer) {
+  if (timer->prev)
+    timer->prev->next = timer->next;
+  else
+    *timer->slot = timer->next;
+  if (timer->next)
+    timer->next->prev = timer->prev;
+  timer->slot = NULL;
+  timers.armed--;
+}
+
+/* Arm @a timer in the slot matching its expiry time. A timer that is
+ * already due goes in the next slot to be checked.
+ */
+static void timer_add(nx_timer_t *timer) {
+  U32 delta = timer->expires - timers.time;
+  nx_timer_t **slot;
+
+  if ((S32)delta <= 0)
+    slot = &timers.near[(timers.time + 1) & TIMER_WHEEL_MASK];
+  else if (delta < TIMER_NEAR_SPAN)
+    slot = &timers.near[timer->expires & TIMER_WHEEL_MASK];
+  else if (delta < TIMER_FAR_SPAN)
+    slot = &timers.far[(timer->expires >> TIMER_WHEEL_BITS)
+                       & TIMER_WHEEL_MASK];
+  else
+    slot = &timers.overflow;
+
+  timer_link(slot, timer);
+}
+
+/* Redistribute the timers of @a slot over the wheels. */
+static void timers_cascade(nx_timer_t **slot) {
+  nx_timer_t *timer = *slot, *next;
+
+  *slot = NULL;
+  for (; timer != NULL; timer = next) {
+    next = timer->next;
+    timers.armed--;
+    timer_add(timer);
+  }
+}
+
+static void timer_work(void *arg) {
+  nx_timer_t *timer = arg;
+
+  timer->func(timer->arg);
+}
+
+void nx_timer_init(nx_timer_t *timer, void (*func)(void *arg), void *arg,
+                   nx_timer_prio_t prio) {
+  NX_ASSERT(timer != NULL);
+  NX_ASSERT(func != NULL);
+
+  timer->func = func;
+  timer->arg = arg;
+  timer->prio = prio;
+  timer->expires = 0;
+  timer->period = 0;
+  timer->slot = NULL;
+  timer->prev = timer->next = NULL;
+  nx_work_init(&timer->work, timer_work, timer);
+}
+
+void nx_timer_start(nx_timer_t *timer, U32 delay, U32 period) {
+  U32 now = nx_systick_get_ms();
+
+  nx_interrupts_disable();
+  if (timer->slot != NULL)
+    timer_unlink(timer);
+
+  /* With no timer armed, the wheels may not have been advanced for a
+   * while. Catch up, there is nothing to fire on the way.
+   */
+  if (timers.armed == 0)
+    timers.time = now;
+
+  timer->expires = now + delay;
+  timer->period = period;
+  timer_add(timer);
+  nx_interrupts_enable();
+}
+
+void nx_timer_cancel(nx_timer_t *timer) {
+  nx_interrupts_disable();
+  if (timer->slot != NULL)
+    timer_unlink(timer);
+  nx_interrupts_enable();
+}
+
+bool nx_timer_is_armed(nx_timer_t *timer) {
+  return timer->slot != NULL;
+}
+
+bool nx__timer_pending(void) {
+  return timers.armed > 0;
+}
+
+void nx__timer_run(void) {
+  U32 now = nx_systick_get_ms();
+  nx_timer_t **slot, *timer;
+  U32 t;
+
+  nx_interrupts_disable();
+
+  if (timers.armed == 0) {
+    timers.time = now;
+    nx_interrupts_enable();
+    return;
+  }
+
+  while ((S32)(now - timers.time) > 0) {
+    t = ++timers.time;
+
+    /* The overflow goes first, it may refill the far slot that is
+     * cascaded next.
+     */
+    if ((t & (TIMER_FAR_SPAN - 1)) == 0)
+      timers_cascade(&timers.overflow);
+    if ((t & TIMER_WHEEL_MASK) == 0)
+      timers_cascade(&timers.far[(t >> TIMER_WHEEL_BITS)
+                                 & TIMER_WHEEL_MASK]);
+
+    /* Callbacks run with interrupts enabled, and may arm timers. Those
+     * due right away land in the next slot, so this loop ends.
+     */
+    slot = &timers.near[t & TIMER_WHEEL_MASK];
+    while ((timer = *slot) != NULL) {
+      timer_unlink(timer);
+      if (timer->period > 0) {
+        /* Keep to the period's phase, unless the timer fell behind. */
+        timer->expires += timer->period;
+        if ((S32)(timer->expires - t) <= 0)
+          timer->expires = t + timer->period;
+        timer_add(timer);
+      }
+
+      nx_interrupts_enable();
+      if (timer->prio == NX_TIMER_IRQ)
+        timer->func(timer->arg);
+      else
+        nx_work_queue(&timer->work);
+      nx_interrupts_disable();
+    }
+  }
+
+  nx_interrupts_enable();
+}
+
+U32 nx__timer_next_timeout(void) {
+  U32 t, deadline, now;
+
+  if (timers.armed == 0)
+    return 0xFFFFFFFF;
+
+  /* Look for the next slot that holds timers, or the next cascade of
+   * a far slot that does.
+   */
+  deadline = timers.time + TIMER_NEAR_SPAN;
+  for (t = timers.time + 1; t != deadline; t++) {
+    if (timers.near[t & TIMER_WHEEL_MASK] != NULL)
+      break;
+    if ((t & TIMER_WHEEL_MASK) == 0 &&
+        (timers.far[(t >> TIMER_WHEEL_BITS) & TIMER_WHEEL_MASK] != NULL ||
+         ((t & (TIMER_FAR_SPAN - 1)) == 0 && timers.overflow != NULL)))
+      break;
+  }
+
+  now = nx_systick_get_ms();
+  return ((S32)(t - now) > 0) ? t - now : 0;
+}
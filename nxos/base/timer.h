@@ -0,0 +1,107 @@
+/** @file timer.h
+ *  @brief Software timers.
+ */
+
+/* Copyright (c) 2008 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#ifndef __NXOS_BASE_TIMER_H__
+#define __NXOS_BASE_TIMER_H__
+
+#include "base/types.h"
+#include "base/workqueue.h"
+
+/** @addtogroup kernel */
+/*@{*/
+
+/** @defgroup timer Software timers
+ *
+ * A software timer calls a function once a given time has elapsed,
+ * and optionally again at a fixed period. Timers are checked every
+ * millisecond by the low priority system timer interrupt handler, so
+ * they fire within a millisecond of their deadline.
+ *
+ * Arming and cancelling a timer takes constant time, whatever the
+ * number of timers armed: they are sorted into a timer wheel with one
+ * slot per millisecond.
+ *
+ * A timer's callback runs either directly from the system timer's
+ * handler, which is the most accurate but delays the scheduler and
+ * other timers, or from the work queue (see workqueue.h), after all
+ * the other interrupt handlers.
+ */
+/*@{*/
+
+/** Where a timer's callback runs. */
+typedef enum {
+  /** In the low priority system timer interrupt handler. The callback
+   * must be very short.
+   */
+  NX_TIMER_IRQ = 0,
+
+  /** From the work queue. */
+  NX_TIMER_WORK,
+} nx_timer_prio_t;
+
+/** A software timer.
+ *
+ * Timers are allocated by the caller, usually statically, and
+ * initialized with nx_timer_init(). The fields are private.
+ */
+typedef struct nx_timer {
+  void (*func)(void *arg); /**< The function to call. */
+  void *arg; /**< The argument given to @a func. */
+  nx_timer_prio_t prio; /**< Where @a func runs. */
+  U32 expires; /**< The system time of the next expiry. */
+  U32 period; /**< The repeat period, 0 for a one-shot timer. */
+  struct nx_timer **slot; /**< The wheel slot holding the timer. */
+  struct nx_timer *prev, *next; /**< The timers in the same slot. */
+  nx_work_t work; /**< Runs @a func for NX_TIMER_WORK timers. */
+} nx_timer_t;
+
+/** Initialize @a timer, disarmed.
+ *
+ * @param timer The timer.
+ * @param func The function to call when the timer expires.
+ * @param arg The argument given to @a func.
+ * @param prio Where @a func runs.
+ */
+void nx_timer_init(nx_timer_t *timer, void (*func)(void *arg), void *arg,
+                   nx_timer_prio_t prio);
+
+/** Arm @a timer, or rearm it if it is already armed.
+ *
+ * Safe to call from any context, including the timer's own callback.
+ *
+ * @param timer The timer.
+ * @param delay The time until the first expiry, in milliseconds.
+ * @param period The time between the following expiries, in
+ * milliseconds, or 0 for a one-shot timer.
+ */
+void nx_timer_start(nx_timer_t *timer, U32 delay, U32 period);
+
+/** Disarm @a timer. Does nothing if it isn't armed.
+ *
+ * Safe to call from any context. The callback of an NX_TIMER_WORK
+ * timer that has already expired may still be waiting to run.
+ *
+ * @param timer The timer.
+ */
+void nx_timer_cancel(nx_timer_t *timer);
+
+/** Check whether @a timer is armed.
+ *
+ * @param timer The timer.
+ * @return TRUE if @a timer will expire.
+ */
+bool nx_timer_is_armed(nx_timer_t *timer);
+
+/*@}*/
+/*@}*/
+
+#endif /* __NXOS_BASE_TIMER_H__ */
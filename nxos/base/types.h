@@ -22,6 +22,8 @@ typedef unsigned short U16; /**< Unsigned 16-bit integer. */
 typedef signed short S16; /**< Signed 16-bit integer. */
 typedef unsigned long U32; /**< Unsigned 32-bit integer. */
 typedef signed long S32; /**< Signed 32-bit integer. */
+typedef unsigned long long U64; /**< Unsigned 64-bit integer. */
+typedef signed long long S64; /**< Signed 64-bit integer. */
 
 typedef U32 size_t; /**< Abstract size type, needed by the memory allocator. */
 
@@ -0,0 +1,101 @@
+/* Copyright (c) 2008 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#include "base/at91sam7s256.h"
+
+#include "base/types.h"
+#include "base/assert.h"
+#include "base/interrupts.h"
+#include "base/drivers/aic.h"
+#include "base/lib/tracing/tracing.h"
+
+#include "base/_workqueue.h"
+
+/* The work runs in a low priority interrupt handler. Like the
+ * scheduler interrupt (see systick.c), it is stolen from a peripheral
+ * the NXT doesn't use: the third timer channel.
+ */
+#define WORK_SYSIRQ AT91C_ID_TC2
+
+/* The queued work, in queuing order. Protected by disabling
+ * interrupts.
+ */
+static struct {
+  nx_work_t *head;
+  nx_work_t *tail;
+} work_queue;
+
+/* Take the next work item off the queue, or return NULL. */
+static nx_work_t *work_pop(void) {
+  nx_work_t *work;
+
+  nx_interrupts_disable();
+  work = work_queue.head;
+  if (work != NULL) {
+    work_queue.head = work->next;
+    if (work_queue.head == NULL)
+      work_queue.tail = NULL;
+
+    /* Cleared before running, so that the work can be queued again
+     * while it runs.
+     */
+    work->pending = FALSE;
+  }
+  nx_interrupts_enable();
+
+  return work;
+}
+
+static void work_isr(void) {
+  nx_work_t *work;
+
+  nx_aic_clear(WORK_SYSIRQ);
+
+  nx_tracing_add_event(NX_TRACE_BEGIN, NX_TRACE_TRACK_IRQ, WORK_SYSIRQ);
+
+  while ((work = work_pop()) != NULL)
+    work->func(work->arg);
+
+  nx_tracing_add_event(NX_TRACE_END, NX_TRACE_TRACK_IRQ, WORK_SYSIRQ);
+}
+
+void nx__workqueue_init(void) {
+  nx_interrupts_disable();
+  nx_aic_install_isr(WORK_SYSIRQ, AIC_PRIO_LOW, AIC_TRIG_EDGE, work_isr);
+  nx_interrupts_enable();
+}
+
+void nx_work_init(nx_work_t *work, void (*func)(void *arg), void *arg) {
+  NX_ASSERT(work != NULL);
+  NX_ASSERT(func != NULL);
+
+  work->func = func;
+  work->arg = arg;
+  work->pending = FALSE;
+  work->next = NULL;
+}
+
+void nx_work_queue(nx_work_t *work) {
+  nx_interrupts_disable();
+  if (!work->pending) {
+    work->pending = TRUE;
+    work->next = NULL;
+    if (work_queue.tail)
+      work_queue.tail->next = work;
+    else
+      work_queue.head = work;
+    work_queue.tail = work;
+  }
+  nx_interrupts_enable();
+
+  nx_aic_set(WORK_SYSIRQ);
+}
+
+bool nx_work_is_pending(nx_work_t *work) {
+  return work->pending;
+}
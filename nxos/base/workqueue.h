@@ -0,0 +1,77 @@
+/** @file workqueue.h
+ *  @brief Deferred work for interrupt handlers.
+ */
+
+/* Copyright (c) 2008 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#ifndef __NXOS_BASE_WORKQUEUE_H__
+#define __NXOS_BASE_WORKQUEUE_H__
+
+#include "base/types.h"
+
+/** @addtogroup kernel */
+/*@{*/
+
+/** @defgroup workqueue Deferred work
+ *
+ * Interrupt handlers should only do what can't wait: acknowledge the
+ * hardware, and grab the data that would otherwise be lost. Anything
+ * longer delays all the interrupts of lower or equal priority.
+ *
+ * The rest of the work can be queued from the handler, and is run
+ * later from a dedicated interrupt of the lowest priority, once all
+ * the other handlers have returned. Work items run in the order they
+ * were queued, with interrupts enabled, so that they can be preempted
+ * by any other handler. They still run before any application code.
+ *
+ * Work items may themselves queue work, including themselves.
+ */
+/*@{*/
+
+/** A work item.
+ *
+ * Work items are allocated by the caller, usually statically, and
+ * initialized with nx_work_init().
+ */
+typedef struct nx_work {
+  void (*func)(void *arg); /**< The work to do. */
+  void *arg; /**< The argument given to @a func. */
+  volatile bool pending; /**< Used by the work queue. */
+  struct nx_work *next; /**< Used by the work queue. */
+} nx_work_t;
+
+/** Initialize a work item.
+ *
+ * @param work The work item.
+ * @param func The function to run.
+ * @param arg The argument given to @a func.
+ */
+void nx_work_init(nx_work_t *work, void (*func)(void *arg), void *arg);
+
+/** Queue @a work for running as soon as all interrupt handlers have
+ * returned.
+ *
+ * Safe to call from any context. Queuing work that is already pending
+ * has no effect: it will only run once.
+ *
+ * @param work The work item.
+ */
+void nx_work_queue(nx_work_t *work);
+
+/** Check whether @a work is queued and hasn't started yet.
+ *
+ * @param work The work item.
+ * @return TRUE if @a work is pending.
+ */
+bool nx_work_is_pending(nx_work_t *work);
+
+/*@}*/
+/*@}*/
+
+#endif /* __NXOS_BASE_WORKQUEUE_H__ */
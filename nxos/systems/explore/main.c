@@ -17,6 +17,7 @@
 #include "base/core.h"
 #include "base/display.h"
 #include "base/drivers/avr.h"
+#include "base/drivers/buttons.h"
 #include "base/drivers/systick.h"
 #include "base/drivers/sound.h"
 #include "base/drivers/sensors.h"
@@ -79,8 +80,8 @@ static void init(void) {
 
   nx_display_string("Press OK to start\n");
 
-  while (nx_avr_get_button() != BUTTON_OK);
-  nx_systick_wait_ms(500);
+  nx_buttons_flush();
+  nx_buttons_wait_press(BUTTON_OK);
 }
 
 static void start(void) {
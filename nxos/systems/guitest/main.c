@@ -7,6 +7,7 @@
 #include "base/core.h"
 #include "base/display.h"
 #include "base/drivers/avr.h"
+#include "base/drivers/buttons.h"
 #include "base/drivers/systick.h"
 #include "base/lib/gui/gui.h"
 
@@ -38,7 +39,8 @@ void main(void) {
         nx_display_end_line();
 
         nx_display_string("\nOk to go back");
-        while (nx_avr_get_button() != BUTTON_OK);
+        nx_buttons_flush();
+        nx_buttons_wait_press(BUTTON_OK);
 
         break;
     }
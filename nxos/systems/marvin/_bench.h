@@ -0,0 +1,24 @@
+/** @file _bench.h
+ *  @brief Marvin's scheduler benchmarks.
+ */
+
+/* Copyright (c) 2008 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#ifndef __NXOS_MARVIN__BENCH_H__
+#define __NXOS_MARVIN__BENCH_H__
+
+/** Create the benchmark tasks.
+ *
+ * Must be called instead of creating the application's tasks, before
+ * the scheduler starts. The results are reported by the harness in
+ * base/lib/bench.
+ */
+void mv__bench_init(void);
+
+#endif /* __NXOS_MARVIN__BENCH_H__ */
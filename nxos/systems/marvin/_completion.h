@@ -0,0 +1,23 @@
+/** @file _completion.h
+ *  @brief Blocking waits on base completions.
+ */
+
+/* Copyright (c) 2008 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#ifndef __NXOS_MARVIN__COMPLETION_H__
+#define __NXOS_MARVIN__COMPLETION_H__
+
+/** Install Marvin's completion operations in the baseplate.
+ *
+ * From then on, tasks waiting on a driver's completion are blocked,
+ * and woken up by the scheduler once the driver signals it.
+ */
+void mv__completion_init(void);
+
+#endif /* __NXOS_MARVIN__COMPLETION_H__ */
@@ -33,6 +33,9 @@ void mv__scheduler_run(void);
 void mv__scheduler_task_block(void);
 
 /** Set @a task to the ready state.
+ *
+ * If @a task was suspended with a wakeup alarm, the alarm is
+ * cancelled.
  *
  * @param task The task to set unblocked.
  */
@@ -46,4 +49,112 @@ void mv__scheduler_task_unblock(mv_task_t *task);
  */
 void mv__scheduler_task_suspend(U32 time);
 
+/** A queue of tasks waiting for something, like a resource or a
+ * message. The tasks are ordered by priority, and first come first
+ * served within a priority.
+ */
+typedef struct mv_wait_queue {
+  struct mv_wait *waiters; /**< Used by the scheduler. */
+  mv_task_t *owner; /**< The owner, for priority inheritance. */
+  struct mv_wait_queue *prev, *next; /**< Used by the scheduler. */
+} mv_wait_queue_t;
+
+/** Initialize @a wq as an empty wait queue, without an owner. */
+void mv__wait_queue_init(mv_wait_queue_t *wq);
+
+/** Set the owner of @a wq.
+ *
+ * The owner of a wait queue holds the resource that the waiting tasks
+ * want. It inherits the priority of the most important waiter for as
+ * long as it owns the queue, transitively if it is itself blocked on
+ * a wait queue that has an owner.
+ *
+ * @param wq The wait queue.
+ * @param owner The new owner, or NULL to release ownership.
+ */
+void mv__wait_queue_set_owner(mv_wait_queue_t *wq, mv_task_t *owner);
+
+/** Check whether tasks are waiting on @a wq.
+ *
+ * @param wq The wait queue.
+ * @return TRUE if no task is waiting on @a wq.
+ */
+bool mv__wait_queue_is_empty(mv_wait_queue_t *wq);
+
+/** Check whether the current task may block.
+ *
+ * The idle task must never block, and a task holding the scheduler
+ * lock would only be switched out once it releases it.
+ *
+ * @return TRUE if the current task can wait on a wait queue.
+ */
+bool mv__scheduler_can_block(void);
+
+/** Block the current task on @a wq.
+ *
+ * The caller must hold the scheduler lock exactly once. The lock is
+ * released while the task is blocked, and held again on return.
+ *
+ * @param wq The wait queue to block on.
+ * @param timeout The longest time to wait in milliseconds, or
+ *                MV_TIMEOUT_FOREVER.
+ * @param data If not NULL, exchanged with the waker: on entry, the
+ *             value given to the task that wakes this one up, on
+ *             return, the value it gave in exchange.
+ * @return TRUE if the task was woken up, FALSE if it timed out.
+ */
+bool mv__scheduler_wait(mv_wait_queue_t *wq, U32 timeout, void **data);
+
+/** Wake up the first task waiting on @a wq.
+ *
+ * @param wq The wait queue.
+ * @param data If not NULL, exchanged with the woken task: on entry,
+ *             the value given to it, on return, the value it gave to
+ *             mv__scheduler_wait().
+ * @return TRUE if a task was woken up, FALSE if none was waiting.
+ */
+bool mv__scheduler_wake_one(mv_wait_queue_t *wq, void **data);
+
+/** Wake up all the tasks waiting on @a wq.
+ *
+ * @param wq The wait queue.
+ */
+void mv__scheduler_wake_all(mv_wait_queue_t *wq);
+
+/** Wake up the tasks waiting on @a wq whose wait condition is met.
+ *
+ * @a match is called, in queue order, with the data each waiting task
+ * gave to mv__scheduler_wait(). The task is woken up if it returns
+ * TRUE. @a match runs with the scheduler lock held, and may update
+ * the waiter's data, eg. to give it a result.
+ *
+ * @param wq The wait queue.
+ * @param match The wait condition.
+ * @param arg The second argument of @a match.
+ */
+void mv__scheduler_wake_matching(mv_wait_queue_t *wq,
+                                 bool (*match)(void *data, void *arg),
+                                 void *arg);
+
+/** Work deferred from an interrupt handler to the scheduler. */
+typedef struct mv_deferred {
+  void (*func)(void *arg); /**< The work to do. */
+  void *arg; /**< The argument of @a func. */
+  bool pending; /**< Used by the scheduler. */
+  struct mv_deferred *next; /**< Used by the scheduler. */
+} mv_deferred_t;
+
+/** Run @a work from the scheduler as soon as possible.
+ *
+ * Interrupt handlers cannot touch the scheduler's state, since they
+ * may have interrupted a task holding the scheduler lock. Instead,
+ * they post work that the scheduler runs with the lock held, and
+ * that may wake up tasks.
+ *
+ * Posting work that is already pending has no effect.
+ *
+ * @param work The work to do. It must stay allocated until it has run.
+ */
+void mv__scheduler_defer(mv_deferred_t *work);
+
 #endif /* __NXOS_MARVIN__SCHEDULER_H__ */
@@ -0,0 +1,131 @@
+/* Copyright (c) 2008 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#include "base/types.h"
+#include "base/lib/bench/bench.h"
+
+#include "marvin/_scheduler.h"
+#include "marvin/semaphore.h"
+#include "marvin/mutex.h"
+#include "marvin/time.h"
+
+#include "marvin/_bench.h"
+
+/* Task switch: the benchmark task and a partner task of the same
+ * priority yield to each other. One operation is a round trip, ie. two
+ * task switches.
+ */
+static mv_sem_t *partner_start;
+static volatile bool partner_stop;
+
+static void partner_task(void) {
+  while (1) {
+    mv_semaphore_dec(partner_start);
+    while (!partner_stop)
+      mv_scheduler_yield(FALSE);
+  }
+}
+
+static void bench_yield_setup(void) {
+  partner_stop = FALSE;
+  mv_semaphore_inc(partner_start);
+}
+
+static void bench_yield(void) {
+  mv_scheduler_yield(FALSE);
+}
+
+static void bench_yield_teardown(void) {
+  partner_stop = TRUE;
+  mv_scheduler_yield(FALSE);
+}
+
+static nx_bench_t yield_bench = {
+  "yield_roundtrip", bench_yield_setup, bench_yield_teardown,
+  bench_yield, NULL, 0, 0, NULL,
+};
+
+/* Preemption latency: the time between a semaphore being released,
+ * and the higher priority task waiting on it starting to run.
+ */
+static mv_sem_t *responder_wakeup;
+static volatile U32 responder_woken;
+static volatile bool responder_ran;
+
+static void responder_task(void) {
+  while (1) {
+    mv_semaphore_dec(responder_wakeup);
+    responder_woken = nx_bench_get_ticks();
+    responder_ran = TRUE;
+  }
+}
+
+static U32 bench_preempt(U32 iterations) {
+  U32 total = 0, i, start;
+
+  for (i = 0; i < iterations; i++) {
+    responder_ran = FALSE;
+    start = nx_bench_get_ticks();
+    mv_semaphore_inc(responder_wakeup);
+    while (!responder_ran);
+    total += responder_woken - start;
+  }
+
+  return total;
+}
+
+static nx_bench_t preempt_bench = {
+  "preempt_latency", NULL, NULL, NULL, bench_preempt, 0, 0, NULL,
+};
+
+/* Uncontended locking, with a mutex and with a semaphore used as a
+ * mutex.
+ */
+static mv_mutex_t *bench_mutex;
+static mv_sem_t *bench_sem;
+
+static void bench_mutex_lock(void) {
+  mv_mutex_lock(bench_mutex);
+  mv_mutex_unlock(bench_mutex);
+}
+
+static nx_bench_t mutex_bench = {
+  "mutex_lock_unlock", NULL, NULL, bench_mutex_lock, NULL, 0, 0, NULL,
+};
+
+static void bench_sem_lock(void) {
+  mv_semaphore_dec(bench_sem);
+  mv_semaphore_inc(bench_sem);
+}
+
+static nx_bench_t sem_bench = {
+  "sem_dec_inc", NULL, NULL, bench_sem_lock, NULL, 0, 0, NULL,
+};
+
+static void bench_task(void) {
+  nx_bench_run_all();
+  while (1)
+    mv_time_sleep(1000);
+}
+
+void mv__bench_init(void) {
+  partner_start = mv_semaphore_create(SEM_PRIVATE);
+  responder_wakeup = mv_semaphore_create(SEM_PRIVATE);
+  bench_mutex = mv_mutex_create();
+  bench_sem = mv_semaphore_create(SEM_MUTEX);
+
+  mv_scheduler_create_task(bench_task, 1024, MV_PRIORITY_NORMAL, "bench");
+  mv_scheduler_create_task(partner_task, 512, MV_PRIORITY_NORMAL, "partner");
+  mv_scheduler_create_task(responder_task, 512, MV_PRIORITY_HIGHEST,
+                           "responder");
+
+  nx_bench_register(&yield_bench);
+  nx_bench_register(&preempt_bench);
+  nx_bench_register(&mutex_bench);
+  nx_bench_register(&sem_bench);
+}
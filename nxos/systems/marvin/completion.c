@@ -0,0 +1,65 @@
+/* Copyright (c) 2008 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#include "base/types.h"
+#include "base/completion.h"
+
+#include "marvin/scheduler.h"
+#include "marvin/_scheduler.h"
+
+#include "marvin/_completion.h"
+
+/* All the tasks waiting on a completion share one wait queue, with the
+ * completion as their wait data. There are only ever a handful of
+ * them, one per driver at most.
+ */
+static mv_wait_queue_t completion_waiters;
+
+/* Signals come from interrupt handlers, so the wakeup is deferred to
+ * the scheduler.
+ */
+static mv_deferred_t completion_wakeup;
+
+static bool completion_match(void *data,
+                             void *arg __attribute__((unused))) {
+  nx_completion_t *c = data;
+
+  return c->done;
+}
+
+static void completion_wake(void *arg __attribute__((unused))) {
+  mv__scheduler_wake_matching(&completion_waiters, completion_match, NULL);
+}
+
+static void completion_block(nx_completion_t *c, U32 timeout) {
+  void *data = c;
+
+  mv_scheduler_lock();
+  if (!c->done)
+    mv__scheduler_wait(&completion_waiters,
+                       (timeout == NX_COMPLETION_FOREVER) ?
+                       MV_TIMEOUT_FOREVER : timeout,
+                       &data);
+  mv_scheduler_unlock();
+}
+
+static void completion_signal(
+    nx_completion_t *c __attribute__((unused))) {
+  mv__scheduler_defer(&completion_wakeup);
+}
+
+static const nx_completion_ops_t completion_ops = {
+  mv__scheduler_can_block, completion_block, completion_signal,
+};
+
+void mv__completion_init(void) {
+  mv__wait_queue_init(&completion_waiters);
+  completion_wakeup.func = completion_wake;
+  completion_wakeup.arg = NULL;
+  nx_completion_install_ops(&completion_ops);
+}
@@ -0,0 +1,136 @@
+/* Copyright (c) 2008 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#include "base/types.h"
+#include "base/assert.h"
+#include "base/interrupts.h"
+#include "base/lib/memalloc/memalloc.h"
+
+#include "marvin/scheduler.h"
+#include "marvin/_scheduler.h"
+
+#include "marvin/event.h"
+
+struct mv_event {
+  /* The set bits. Shared with interrupt handlers, and protected by
+   * disabling interrupts.
+   */
+  volatile U32 bits;
+
+  mv_wait_queue_t waiters; /* Tasks waiting for bits. */
+
+  /* Wakeup of the waiters after mv_event_set_from_isr(). */
+  mv_deferred_t isr_wakeup;
+};
+
+/* What a waiting task waits for. Lives on the task's stack, and is
+ * given to the scheduler as the wait data.
+ */
+struct event_wait {
+  U32 bits;
+  U32 flags;
+  U32 result;
+};
+
+/* Check whether the bits set in @a ev satisfy @a wait, and if so
+ * record the result, and clear the bits if requested.
+ */
+static bool event_match(void *data, void *arg) {
+  struct event_wait *wait = data;
+  mv_event_t *ev = arg;
+  bool match;
+  U32 set;
+
+  nx_interrupts_disable();
+  set = ev->bits & wait->bits;
+  if (wait->flags & MV_EVENT_ALL)
+    match = (set == wait->bits);
+  else
+    match = (set != 0);
+
+  if (match) {
+    wait->result = set;
+    if (wait->flags & MV_EVENT_CLEAR)
+      ev->bits &= ~wait->bits;
+  }
+  nx_interrupts_enable();
+
+  return match;
+}
+
+static void event_wake(void *arg) {
+  mv_event_t *ev = arg;
+
+  mv__scheduler_wake_matching(&ev->waiters, event_match, ev);
+}
+
+mv_event_t *mv_event_create(void) {
+  mv_event_t *ev = nx_calloc(1, sizeof(*ev));
+
+  mv__wait_queue_init(&ev->waiters);
+  ev->isr_wakeup.func = event_wake;
+  ev->isr_wakeup.arg = ev;
+
+  return ev;
+}
+
+void mv_event_set(mv_event_t *ev, U32 bits) {
+  mv_scheduler_lock();
+
+  nx_interrupts_disable();
+  ev->bits |= bits;
+  nx_interrupts_enable();
+
+  event_wake(ev);
+
+  mv_scheduler_unlock();
+}
+
+void mv_event_set_from_isr(mv_event_t *ev, U32 bits) {
+  nx_interrupts_disable();
+  ev->bits |= bits;
+  nx_interrupts_enable();
+
+  mv__scheduler_defer(&ev->isr_wakeup);
+}
+
+void mv_event_clear(mv_event_t *ev, U32 bits) {
+  nx_interrupts_disable();
+  ev->bits &= ~bits;
+  nx_interrupts_enable();
+}
+
+U32 mv_event_get(mv_event_t *ev) {
+  return ev->bits;
+}
+
+U32 mv_event_wait(mv_event_t *ev, U32 bits, U32 flags, U32 timeout) {
+  struct event_wait wait = { bits, flags, 0 };
+  void *data = &wait;
+
+  NX_ASSERT(bits != 0);
+
+  mv_scheduler_lock();
+
+  /* If the bits aren't already set, block until a setter finds that
+   * they are, and gives us the result, or until the timeout expires.
+   */
+  if (!event_match(&wait, ev) && timeout > 0)
+    mv__scheduler_wait(&ev->waiters, timeout, &data);
+
+  mv_scheduler_unlock();
+  return wait.result;
+}
+
+void mv_event_destroy(mv_event_t *ev) {
+  mv_scheduler_lock();
+  NX_ASSERT(mv__wait_queue_is_empty(&ev->waiters));
+  NX_ASSERT(!ev->isr_wakeup.pending);
+  nx_free(ev);
+  mv_scheduler_unlock();
+}
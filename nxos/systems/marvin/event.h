@@ -0,0 +1,91 @@
+/** @file event.h
+ *  @brief Marvin's event flag groups.
+ */
+
+/* Copyright (c) 2008 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#ifndef __NXOS_MARVIN_EVENT_H__
+#define __NXOS_MARVIN_EVENT_H__
+
+#include "base/types.h"
+
+typedef struct mv_event mv_event_t;
+
+/** Flags for mv_event_wait(). */
+enum {
+  MV_EVENT_ANY = 0, /**< Wait for any of the requested bits. */
+  MV_EVENT_ALL = 1, /**< Wait for all of the requested bits. */
+  MV_EVENT_CLEAR = 2, /**< Clear the requested bits when the wait is
+                         satisfied. */
+};
+
+/** Create a new event flag group, with all 32 bits clear.
+ *
+ * An event flag group lets a task wait on several conditions at once,
+ * eg. "a byte arrived, or the transfer completed, or the user pressed
+ * cancel", each condition being one bit.
+ *
+ * @return A new event flag group.
+ */
+mv_event_t *mv_event_create(void);
+
+/** Set @a bits in @a ev, and wake up the tasks waiting for them.
+ *
+ * @param ev The event flag group.
+ * @param bits The bits to set.
+ */
+void mv_event_set(mv_event_t *ev, U32 bits);
+
+/** Set @a bits in @a ev from an interrupt handler.
+ *
+ * The bits are set immediately, the waiting tasks are woken up by the
+ * scheduler as soon as the handler returns.
+ *
+ * @param ev The event flag group.
+ * @param bits The bits to set.
+ */
+void mv_event_set_from_isr(mv_event_t *ev, U32 bits);
+
+/** Clear @a bits in @a ev.
+ *
+ * @param ev The event flag group.
+ * @param bits The bits to clear.
+ */
+void mv_event_clear(mv_event_t *ev, U32 bits);
+
+/** Return the bits currently set in @a ev.
+ *
+ * @param ev The event flag group.
+ * @return The set bits.
+ */
+U32 mv_event_get(mv_event_t *ev);
+
+/** Wait until any or all of @a bits are set in @a ev.
+ *
+ * @param ev The event flag group.
+ * @param bits The bits to wait for. Must not be 0.
+ * @param flags MV_EVENT_ANY or MV_EVENT_ALL, optionally or'ed with
+ *              MV_EVENT_CLEAR.
+ * @param timeout The longest time to wait in milliseconds, 0 to not
+ *                wait, or MV_TIMEOUT_FOREVER.
+ * @return The bits of @a bits that were set when the wait was
+ * satisfied, or 0 on timeout.
+ */
+U32 mv_event_wait(mv_event_t *ev, U32 bits, U32 flags, U32 timeout);
+
+/** Destroy @a ev and free any memory it uses.
+ *
+ * @param ev The event flag group to destroy.
+ *
+ * @warning Destroying an event flag group while tasks are waiting on
+ * it will cause Marvin to assert and crash.
+ */
+void mv_event_destroy(mv_event_t *ev);
+
+#endif /* __NXOS_MARVIN_EVENT_H__ */
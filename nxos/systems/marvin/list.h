@@ -92,10 +92,14 @@
   } \
 })
 
-/** Remove and return @a item from @a list */
+/** Remove and return @a item from @a list
+ *
+ * @a item is evaluated once: it may be @a list itself, which the
+ * removal changes.
+ */
 #define mv_list_pop(list, item) ({ \
   typeof(list) __ret_elt = (item); \
-  mv_list_remove(list, item); \
+  mv_list_remove(list, __ret_elt); \
   __ret_elt; \
 })
 
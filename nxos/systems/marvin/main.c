@@ -11,10 +11,14 @@
 #include "base/lib/memalloc/memalloc.h"
 #include "base/drivers/systick.h"
 #include "base/drivers/sound.h"
+#include "base/lib/gui/gui.h"
 
 #include "marvin/_scheduler.h"
 #include "marvin/semaphore.h"
 #include "marvin/time.h"
+#include "marvin/top.h"
+#include "marvin/pt.h"
+#include "marvin/_bench.h"
 
 static mv_sem_t *beep_res;
 
@@ -60,13 +64,75 @@ static void test_sleep(void) {
   }
 }
 
+/* A task that uses all the CPU time it gets, for the task monitor to
+ * show.
+ */
+static void busy_loop(void) {
+  volatile U32 counter = 0;
+  while(1)
+    counter++;
+}
+
+/* Protothreads that sleep for various periods and count their
+ * wakeups, for the task monitor to show the runner's load.
+ */
+#define N_TICKERS 12
+
+static mv_pt_t tickers[N_TICKERS];
+static U32 ticker_counts[N_TICKERS];
+
+static U8 ticker(mv_pt_t *pt) {
+  U32 i = pt - tickers;
+
+  MV_PT_BEGIN(pt);
+  while (1) {
+    MV_PT_SLEEP(pt, 10 * (i + 1));
+    ticker_counts[i]++;
+  }
+  MV_PT_END(pt);
+}
+
+static char *modes[] = { "Demo", "Benchmarks", "Top", NULL };
+
 void main(void) {
+  gui_text_menu_t menu;
+  U8 mode;
+  U32 i;
+
+  menu.title = "Marvin";
+  menu.entries = modes;
+  menu.default_entry = 0;
+  menu.active_mark = GUI_DEFAULT_TEXT_MARK;
+
   nx_memalloc_init();
   mv__scheduler_init();
-  beep_res = mv_semaphore_create(0);
-  mv_scheduler_create_task(beep_consumer, 512);
-  mv_scheduler_create_task(beep_producer, 512);
-  mv_scheduler_create_task(test_display, 512);
-  mv_scheduler_create_task(test_sleep, 512);
+
+  mode = nx_gui_text_menu(menu);
+  if (mode == 1) {
+    mv__bench_init();
+  } else {
+    beep_res = mv_semaphore_create(0);
+    mv_scheduler_create_task(beep_consumer, 512, MV_PRIORITY_NORMAL,
+                             "beep_c");
+    mv_scheduler_create_task(beep_producer, 512, MV_PRIORITY_NORMAL,
+                             "beep_p");
+    mv_scheduler_create_task(test_sleep, 512, MV_PRIORITY_NORMAL, "sleep");
+
+    /* The display and busy tasks never block: they get whatever CPU
+     * time the others leave.
+     */
+    if (mode == 2) {
+      mv_scheduler_create_task(busy_loop, 256, MV_PRIORITY_LOWEST, "busy");
+      mv_pt_create_runner(256, MV_PRIORITY_NORMAL, 10);
+      for (i = 0; i < N_TICKERS; i++)
+        mv_pt_start(&tickers[i], ticker, NULL);
+      mv_top_create_task(1000);
+    } else {
+      mv_scheduler_create_task(test_display, 512, MV_PRIORITY_LOWEST,
+                               "display");
+    }
+  }
+
+  nx_display_clear();
   mv__scheduler_run();
 }
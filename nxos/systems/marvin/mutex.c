@@ -0,0 +1,167 @@
+/* Copyright (c) 2008 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#include "base/types.h"
+#include "base/assert.h"
+#include "base/lib/memalloc/memalloc.h"
+
+#include "marvin/_scheduler.h"
+
+#include "marvin/mutex.h"
+
+struct mv_mutex {
+  mv_wait_queue_t waiters; /* Tasks waiting for the mutex. */
+  mv_task_t *owner; /* The owner, or NULL if unlocked. */
+  U32 count; /* The number of times the owner locked the mutex. */
+#ifdef MV_MUTEX_DEBUG
+  S32 id; /* Index in the lock order graph, or -1 if not checked. */
+#endif
+};
+
+#ifdef MV_MUTEX_DEBUG
+/* The lock order graph. Bit B of order[A] is set when mutex B was
+ * locked while holding mutex A. A cycle in this graph means that two
+ * tasks can deadlock each other.
+ */
+static struct {
+  mv_mutex_t *mutexes[MV_MUTEX_DEBUG_MAX];
+  U32 order[MV_MUTEX_DEBUG_MAX];
+  U32 n_mutexes;
+} lock_order;
+
+/* Check whether mutex @a to can be reached from mutex @a from in the
+ * lock order graph.
+ */
+static bool lock_order_reaches(U32 from, U32 to) {
+  U32 seen = 0, frontier = (1 << from), next, i;
+
+  while (frontier != 0) {
+    if (frontier & (1 << to))
+      return TRUE;
+    seen |= frontier;
+    next = 0;
+    for (i = 0; i < lock_order.n_mutexes; i++)
+      if (frontier & (1 << i))
+        next |= lock_order.order[i];
+    frontier = next & ~seen;
+  }
+
+  return FALSE;
+}
+
+/* Record that the current task is about to lock @a m, on top of the
+ * mutexes it already holds, and fail if that order was ever reversed.
+ * Called with the scheduler locked.
+ */
+static void lock_order_check(mv_mutex_t *m) {
+  mv_task_t *self = mv_scheduler_get_current_task();
+  U32 i;
+
+  if (m->id < 0)
+    return;
+
+  for (i = 0; i < lock_order.n_mutexes; i++) {
+    if (lock_order.mutexes[i] == NULL ||
+        lock_order.mutexes[i]->owner != self)
+      continue;
+    if (lock_order_reaches(m->id, i))
+      NX_FAIL("Mutex lock order\ninversion");
+    lock_order.order[i] |= (1 << m->id);
+  }
+}
+#endif
+
+mv_mutex_t *mv_mutex_create(void) {
+  mv_mutex_t *m = nx_calloc(1, sizeof(*m));
+
+  mv__wait_queue_init(&m->waiters);
+
+#ifdef MV_MUTEX_DEBUG
+  m->id = -1;
+  mv_scheduler_lock();
+  if (lock_order.n_mutexes < MV_MUTEX_DEBUG_MAX) {
+    m->id = lock_order.n_mutexes++;
+    lock_order.mutexes[m->id] = m;
+  }
+  mv_scheduler_unlock();
+#endif
+
+  return m;
+}
+
+bool mv_mutex_lock_timeout(mv_mutex_t *m, U32 timeout) {
+  mv_task_t *self = mv_scheduler_get_current_task();
+  void *data = self;
+  bool ok = TRUE;
+
+  mv_scheduler_lock();
+  if (m->owner == self) {
+    m->count++;
+  } else {
+#ifdef MV_MUTEX_DEBUG
+    lock_order_check(m);
+#endif
+    if (m->owner == NULL) {
+      m->owner = self;
+      m->count = 1;
+      mv__wait_queue_set_owner(&m->waiters, self);
+    } else if (timeout > 0) {
+      /* The previous owner hands us the mutex when it unlocks. */
+      ok = mv__scheduler_wait(&m->waiters, timeout, &data);
+    } else {
+      ok = FALSE;
+    }
+  }
+  mv_scheduler_unlock();
+
+  return ok;
+}
+
+void mv_mutex_lock(mv_mutex_t *m) {
+  mv_mutex_lock_timeout(m, MV_TIMEOUT_FOREVER);
+}
+
+bool mv_mutex_try_lock(mv_mutex_t *m) {
+  return mv_mutex_lock_timeout(m, 0);
+}
+
+void mv_mutex_unlock(mv_mutex_t *m) {
+  void *next = NULL;
+
+  mv_scheduler_lock();
+  NX_ASSERT_MSG(m->owner == mv_scheduler_get_current_task(),
+                "Mutex unlocked\nby non-owner");
+
+  if (--m->count == 0) {
+    /* Drop the inherited priority, then hand the mutex over to the
+     * most important waiter, which gets the priority of those left.
+     */
+    mv__wait_queue_set_owner(&m->waiters, NULL);
+    if (mv__scheduler_wake_one(&m->waiters, &next)) {
+      m->owner = next;
+      m->count = 1;
+      mv__wait_queue_set_owner(&m->waiters, next);
+    } else {
+      m->owner = NULL;
+    }
+  }
+
+  /* If a more important task got the mutex, it runs now. */
+  mv_scheduler_unlock();
+}
+
+void mv_mutex_destroy(mv_mutex_t *m) {
+  mv_scheduler_lock();
+  NX_ASSERT(m->owner == NULL);
+#ifdef MV_MUTEX_DEBUG
+  if (m->id >= 0)
+    lock_order.mutexes[m->id] = NULL;
+#endif
+  nx_free(m);
+  mv_scheduler_unlock();
+}
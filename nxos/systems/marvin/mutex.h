@@ -0,0 +1,83 @@
+/** @file mutex.h
+ *  @brief Marvin's mutex implementation.
+ */
+
+/* Copyright (c) 2008 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#ifndef __NXOS_MARVIN_MUTEX_H__
+#define __NXOS_MARVIN_MUTEX_H__
+
+#include "base/types.h"
+
+typedef struct mv_mutex mv_mutex_t;
+
+/** The maximum number of mutexes that can be checked for lock order
+ * problems.
+ */
+#define MV_MUTEX_DEBUG_MAX 32
+
+/** Create and return a new, unlocked mutex.
+ *
+ * Mutexes are owned by the task that locks them, and only that task
+ * may unlock them. They are recursive: the owner may lock a mutex
+ * again, and must unlock it as many times.
+ *
+ * While tasks are blocked on a mutex, its owner runs with the
+ * priority of the most important of them (priority inheritance), so
+ * that a low priority owner can't be starved by medium priority tasks
+ * while a high priority task waits.
+ *
+ * When Marvin is built with lock order checking (<tt>scons
+ * mutex_debug=1</tt>), the order in which tasks nest the first
+ * MV_MUTEX_DEBUG_MAX mutexes created is recorded, and locking mutexes
+ * in an order that may deadlock halts the brick with an error.
+ *
+ * @return A new mutex.
+ */
+mv_mutex_t *mv_mutex_create(void);
+
+/** Lock @a mutex, blocking until it is available.
+ *
+ * @param mutex The mutex.
+ */
+void mv_mutex_lock(mv_mutex_t *mutex);
+
+/** Lock @a mutex, blocking until it is available or until the timeout
+ * expires.
+ *
+ * @param mutex The mutex.
+ * @param timeout The longest time to wait in milliseconds, 0 to not
+ *                wait, or MV_TIMEOUT_FOREVER.
+ * @return TRUE if the mutex was locked, FALSE on timeout.
+ */
+bool mv_mutex_lock_timeout(mv_mutex_t *mutex, U32 timeout);
+
+/** Lock @a mutex if it is available, without blocking.
+ *
+ * @param mutex The mutex.
+ * @return TRUE if the mutex was locked.
+ */
+bool mv_mutex_try_lock(mv_mutex_t *mutex);
+
+/** Unlock @a mutex.
+ *
+ * If tasks are waiting for the mutex, ownership goes directly to the
+ * most important of them.
+ *
+ * @param mutex The mutex, which must be owned by the calling task.
+ */
+void mv_mutex_unlock(mv_mutex_t *mutex);
+
+/** Destroy @a mutex and free its memory.
+ *
+ * @param mutex The mutex, which must be unlocked.
+ */
+void mv_mutex_destroy(mv_mutex_t *mutex);
+
+#endif /* __NXOS_MARVIN_MUTEX_H__ */
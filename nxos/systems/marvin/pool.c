@@ -0,0 +1,88 @@
+/* Copyright (c) 2008 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#include "base/types.h"
+#include "base/assert.h"
+#include "base/interrupts.h"
+#include "base/lib/memalloc/memalloc.h"
+
+#include "marvin/pool.h"
+
+/* A free buffer, holding the link to the next free one. */
+struct pool_free {
+  struct pool_free *next;
+};
+
+struct mv_pool {
+  U8 *buffers; /* The buffers, one after the other. */
+  U32 size; /* The size of a buffer, rounded up to words. */
+  U32 count; /* The number of buffers. */
+  U32 available; /* The number of free buffers. */
+  struct pool_free *free; /* The free buffers. */
+};
+
+mv_pool_t *mv_pool_create(U32 size, U32 count) {
+  mv_pool_t *pool;
+  U32 i;
+
+  NX_ASSERT(size > 0);
+  NX_ASSERT(count > 0);
+
+  pool = nx_calloc(1, sizeof(*pool));
+  pool->size = (size + 3) & ~3;
+  pool->count = count;
+  pool->buffers = nx_calloc(count, pool->size);
+
+  for (i = count; i > 0; i--) {
+    struct pool_free *f = (struct pool_free*)(pool->buffers +
+                                              (i - 1) * pool->size);
+    f->next = pool->free;
+    pool->free = f;
+  }
+  pool->available = count;
+
+  return pool;
+}
+
+void *mv_pool_alloc(mv_pool_t *pool) {
+  struct pool_free *f;
+
+  nx_interrupts_disable();
+  f = pool->free;
+  if (f != NULL) {
+    pool->free = f->next;
+    pool->available--;
+  }
+  nx_interrupts_enable();
+
+  return f;
+}
+
+void mv_pool_free(mv_pool_t *pool, void *buffer) {
+  struct pool_free *f = buffer;
+
+  NX_ASSERT((U8*)buffer >= pool->buffers &&
+            (U8*)buffer < pool->buffers + pool->count * pool->size &&
+            ((U8*)buffer - pool->buffers) % pool->size == 0);
+
+  nx_interrupts_disable();
+  f->next = pool->free;
+  pool->free = f;
+  pool->available++;
+  nx_interrupts_enable();
+}
+
+U32 mv_pool_get_free(mv_pool_t *pool) {
+  return pool->available;
+}
+
+void mv_pool_destroy(mv_pool_t *pool) {
+  NX_ASSERT(pool->available == pool->count);
+  nx_free(pool->buffers);
+  nx_free(pool);
+}
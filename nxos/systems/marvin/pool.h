@@ -0,0 +1,65 @@
+/** @file pool.h
+ *  @brief Marvin's fixed size buffer pools.
+ */
+
+/* Copyright (c) 2008 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#ifndef __NXOS_MARVIN_POOL_H__
+#define __NXOS_MARVIN_POOL_H__
+
+#include "base/types.h"
+
+typedef struct mv_pool mv_pool_t;
+
+/** Create a pool of @a count buffers of @a size bytes each.
+ *
+ * Pools are meant to be used with message queues: the sender fills a
+ * buffer from a pool and sends its address, and the receiver returns
+ * it to the pool when done with it. Nothing is copied.
+ *
+ * @param size The size of a buffer in bytes.
+ * @param count The number of buffers in the pool.
+ * @return A new pool.
+ */
+mv_pool_t *mv_pool_create(U32 size, U32 count);
+
+/** Take a buffer from @a pool.
+ *
+ * This never blocks, and can be used from interrupt handlers.
+ *
+ * @param pool The pool.
+ * @return A buffer, or NULL if all of them are in use.
+ */
+void *mv_pool_alloc(mv_pool_t *pool);
+
+/** Return a buffer to @a pool.
+ *
+ * This can be used from interrupt handlers.
+ *
+ * @param pool The pool @a buffer was taken from.
+ * @param buffer The buffer.
+ */
+void mv_pool_free(mv_pool_t *pool, void *buffer);
+
+/** Return the number of buffers available in @a pool.
+ *
+ * @param pool The pool.
+ * @return The number of free buffers.
+ */
+U32 mv_pool_get_free(mv_pool_t *pool);
+
+/** Destroy @a pool and free its memory.
+ *
+ * @param pool The pool to destroy.
+ *
+ * @warning All the buffers must have been returned to the pool.
+ */
+void mv_pool_destroy(mv_pool_t *pool);
+
+#endif /* __NXOS_MARVIN_POOL_H__ */
@@ -0,0 +1,124 @@
+/* Copyright (c) 2008 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#include "base/types.h"
+#include "base/assert.h"
+#include "base/util.h"
+#include "base/drivers/systick.h"
+
+#include "marvin/scheduler.h"
+#include "marvin/event.h"
+
+#include "marvin/pt.h"
+
+static struct {
+  /* The protothreads run by the runner. Only the runner touches this
+   * list.
+   */
+  mv_pt_t *running;
+
+  /* Protothreads started since the runner last looked, protected by
+   * the scheduler lock.
+   */
+  mv_pt_t *started;
+
+  U32 poll; /* The longest sleep while protothreads wait. */
+  mv_event_t *poke; /* Wakes up the runner early. */
+} pt_state;
+
+/* Move the newly started protothreads to the running list. */
+static void pt_take_started(void) {
+  mv_pt_t *pt;
+
+  mv_scheduler_lock();
+  while (pt_state.started != NULL) {
+    pt = pt_state.started;
+    pt_state.started = pt->next;
+    pt->next = pt_state.running;
+    pt_state.running = pt;
+  }
+  mv_scheduler_unlock();
+}
+
+/* Run every protothread once. Return how long the runner may sleep
+ * before the next pass, in milliseconds.
+ */
+static U32 pt_run_all(void) {
+  mv_pt_t **link = &pt_state.running;
+  mv_pt_t *pt;
+  U32 timeout = MV_TIMEOUT_FOREVER;
+  U32 now, left;
+
+  while ((pt = *link) != NULL) {
+    switch (pt->func(pt)) {
+    case MV_PT_ENDED:
+      *link = pt->next;
+      continue;
+    case MV_PT_YIELDED:
+      timeout = 0;
+      break;
+    case MV_PT_SLEEPING:
+      now = nx_systick_get_ms();
+      left = ((S32)(pt->wakeup - now) > 0) ? pt->wakeup - now : 0;
+      timeout = MIN(timeout, left);
+      break;
+    default:
+      timeout = MIN(timeout, pt_state.poll);
+      break;
+    }
+    link = &pt->next;
+  }
+
+  return timeout;
+}
+
+static void pt_runner(void) {
+  U32 timeout;
+
+  while (1) {
+    pt_take_started();
+    timeout = pt_run_all();
+
+    if (timeout == 0)
+      mv_scheduler_yield(FALSE);
+    else
+      mv_event_wait(pt_state.poke, 1, MV_EVENT_CLEAR, timeout);
+  }
+}
+
+void mv_pt_create_runner(U32 stack, U8 priority, U32 poll) {
+  NX_ASSERT(pt_state.poke == NULL);
+  NX_ASSERT(poll > 0);
+
+  pt_state.poll = poll;
+  pt_state.poke = mv_event_create();
+  mv_scheduler_create_task(pt_runner, stack, priority, "pt");
+}
+
+void mv_pt_start(mv_pt_t *pt, mv_pt_func_t func, void *data) {
+  NX_ASSERT(pt_state.poke != NULL);
+
+  pt->lc = 0;
+  pt->func = func;
+  pt->data = data;
+
+  mv_scheduler_lock();
+  pt->next = pt_state.started;
+  pt_state.started = pt;
+  mv_scheduler_unlock();
+
+  mv_pt_poke();
+}
+
+void mv_pt_poke(void) {
+  mv_event_set(pt_state.poke, 1);
+}
+
+void mv_pt_poke_from_isr(void) {
+  mv_event_set_from_isr(pt_state.poke, 1);
+}
@@ -0,0 +1,148 @@
+/** @file pt.h
+ *  @brief Marvin's protothreads.
+ *
+ * Protothreads are stackless, cooperative tasks. A protothread is a
+ * function that is called over and over by a runner task, and uses
+ * the macros below to wait or yield: they return from the function,
+ * and the next call resumes where it left off. All the protothreads
+ * share the stack of the runner, and each costs only its mv_pt_t.
+ *
+ * They suit small polling loops and state machines:
+ *
+ * @code
+ * static U8 blink(mv_pt_t *pt) {
+ *   MV_PT_BEGIN(pt);
+ *   while (1) {
+ *     MV_PT_WAIT_UNTIL(pt, sensor_triggered());
+ *     nx_sound_freq_async(440, 100);
+ *     MV_PT_SLEEP(pt, 500);
+ *   }
+ *   MV_PT_END(pt);
+ * }
+ * @endcode
+ *
+ * Since the function returns whenever it waits, local variables don't
+ * keep their value across waits: keep state in static variables, or
+ * in a structure pointed to by the @a data field. The macros are
+ * implemented with a switch statement, so a protothread may not use
+ * switch statements around them.
+ *
+ * The runner calls all the protothreads in turn. When they all wait,
+ * it sleeps until the first sleeping one is due. If some wait for a
+ * condition, it sleeps at most for its poll period, since conditions
+ * can't be watched otherwise. Code that makes a condition true can
+ * call mv_pt_poke() to have it checked right away.
+ */
+
+/* Copyright (c) 2008 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#ifndef __NXOS_MARVIN_PT_H__
+#define __NXOS_MARVIN_PT_H__
+
+#include "base/types.h"
+#include "base/drivers/systick.h"
+
+/** The values returned by protothread functions. Use the macros
+ * instead of returning them directly.
+ */
+enum {
+  MV_PT_WAITING = 0, /**< Waiting for a condition. */
+  MV_PT_SLEEPING, /**< Sleeping until @a wakeup. */
+  MV_PT_YIELDED, /**< Ready to continue. */
+  MV_PT_ENDED, /**< Done. */
+};
+
+typedef struct mv_pt mv_pt_t;
+
+/** A protothread function. */
+typedef U8 (*mv_pt_func_t)(mv_pt_t *pt);
+
+/** A protothread. */
+struct mv_pt {
+  U16 lc; /**< Where to resume, used by the macros. */
+  U32 wakeup; /**< The end of the current sleep, used by the macros. */
+  mv_pt_func_t func; /**< The protothread function. */
+  void *data; /**< For use by the protothread. */
+  struct mv_pt *next; /**< Used by the runner. */
+};
+
+/** Start a protothread's function. */
+#define MV_PT_BEGIN(pt) switch ((pt)->lc) { case 0:
+
+/** End a protothread's function. The protothread stops when it gets
+ * here.
+ */
+#define MV_PT_END(pt) } (pt)->lc = 0; return MV_PT_ENDED
+
+/** Wait until @a cond is true. */
+#define MV_PT_WAIT_UNTIL(pt, cond)              \
+  do {                                          \
+    (pt)->lc = __LINE__; case __LINE__:         \
+    if (!(cond))                                \
+      return MV_PT_WAITING;                     \
+  } while (0)
+
+/** Wait while @a cond is true. */
+#define MV_PT_WAIT_WHILE(pt, cond) MV_PT_WAIT_UNTIL(pt, !(cond))
+
+/** Let the other protothreads and tasks run. */
+#define MV_PT_YIELD(pt)                         \
+  do {                                          \
+    (pt)->lc = __LINE__;                        \
+    return MV_PT_YIELDED;                       \
+    case __LINE__:;                             \
+  } while (0)
+
+/** Sleep for @a ms milliseconds. */
+#define MV_PT_SLEEP(pt, ms)                                     \
+  do {                                                          \
+    (pt)->wakeup = nx_systick_get_ms() + (ms);                  \
+    (pt)->lc = __LINE__; case __LINE__:                         \
+    if ((S32)(nx_systick_get_ms() - (pt)->wakeup) < 0)          \
+      return MV_PT_SLEEPING;                                    \
+  } while (0)
+
+/** Stop the protothread. */
+#define MV_PT_EXIT(pt)                          \
+  do {                                          \
+    (pt)->lc = 0;                               \
+    return MV_PT_ENDED;                         \
+  } while (0)
+
+/** Create the task that runs the protothreads.
+ *
+ * Must be called once, before the scheduler starts.
+ *
+ * @param stack The size of the shared stack in bytes. It must be
+ *              enough for the deepest protothread.
+ * @param priority The priority of the runner, and so of all the
+ *                 protothreads.
+ * @param poll The longest time in milliseconds between two checks of
+ *             a waiting protothread's condition.
+ */
+void mv_pt_create_runner(U32 stack, U8 priority, U32 poll);
+
+/** Start running @a func as a protothread.
+ *
+ * @param pt The protothread. It must stay allocated until the
+ *           protothread ends.
+ * @param func The protothread's function.
+ * @param data For use by the protothread, in its @a data field.
+ */
+void mv_pt_start(mv_pt_t *pt, mv_pt_func_t func, void *data);
+
+/** Have the runner check the waiting protothreads now. */
+void mv_pt_poke(void);
+
+/** Have the runner check the waiting protothreads, from an interrupt
+ * handler.
+ */
+void mv_pt_poke_from_isr(void);
+
+#endif /* __NXOS_MARVIN_PT_H__ */
@@ -0,0 +1,156 @@
+/* Copyright (c) 2008 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#include "base/types.h"
+#include "base/assert.h"
+#include "base/interrupts.h"
+#include "base/lib/memalloc/memalloc.h"
+
+#include "marvin/_scheduler.h"
+
+#include "marvin/queue.h"
+
+struct mv_queue {
+  /* The queued messages. The ring is shared with interrupt handlers,
+   * and protected by disabling interrupts.
+   */
+  void **ring;
+  U32 length;
+  U32 head; /* Index of the oldest message. */
+  U32 count; /* Number of queued messages. */
+
+  mv_wait_queue_t receivers; /* Tasks waiting for a message. */
+  mv_wait_queue_t senders; /* Tasks waiting for room, with their message. */
+
+  /* Delivery of messages sent by interrupt handlers. */
+  mv_deferred_t isr_delivery;
+};
+
+/* Ring operations. Must be called with interrupts disabled. */
+static inline bool ring_put(mv_queue_t *q, void *msg) {
+  if (q->count == q->length)
+    return FALSE;
+  q->ring[(q->head + q->count) % q->length] = msg;
+  q->count++;
+  return TRUE;
+}
+
+static inline bool ring_get(mv_queue_t *q, void **msg) {
+  if (q->count == 0)
+    return FALSE;
+  *msg = q->ring[q->head];
+  q->head = (q->head + 1) % q->length;
+  q->count--;
+  return TRUE;
+}
+
+/* Take the oldest message, and let the first blocked sender, if any,
+ * take the place it freed. Must be called with the scheduler locked.
+ */
+static bool queue_get(mv_queue_t *q, void **msg) {
+  void *pending;
+  bool ok;
+
+  nx_interrupts_disable();
+  ok = ring_get(q, msg);
+  if (ok && !mv__wait_queue_is_empty(&q->senders)) {
+    pending = NULL;
+    mv__scheduler_wake_one(&q->senders, &pending);
+    ring_put(q, pending);
+  }
+  nx_interrupts_enable();
+
+  return ok;
+}
+
+/* Hand the messages sent by interrupt handlers to waiting receivers. */
+static void queue_deliver(void *arg) {
+  mv_queue_t *q = arg;
+  void *msg;
+
+  while (!mv__wait_queue_is_empty(&q->receivers) && queue_get(q, &msg))
+    mv__scheduler_wake_one(&q->receivers, &msg);
+}
+
+mv_queue_t *mv_queue_create(U32 length) {
+  mv_queue_t *q;
+
+  NX_ASSERT(length > 0);
+
+  q = nx_calloc(1, sizeof(*q));
+  q->ring = nx_calloc(length, sizeof(void*));
+  q->length = length;
+  mv__wait_queue_init(&q->receivers);
+  mv__wait_queue_init(&q->senders);
+  q->isr_delivery.func = queue_deliver;
+  q->isr_delivery.arg = q;
+
+  return q;
+}
+
+bool mv_queue_send(mv_queue_t *q, void *msg, U32 timeout) {
+  bool ok;
+
+  mv_scheduler_lock();
+
+  /* Receivers only wait on an empty queue, unless an interrupt
+   * handler just sent something, which must go first.
+   */
+  if (q->count == 0 && mv__scheduler_wake_one(&q->receivers, &msg)) {
+    ok = TRUE;
+  } else {
+    nx_interrupts_disable();
+    ok = ring_put(q, msg);
+    nx_interrupts_enable();
+
+    if (!ok && timeout > 0)
+      ok = mv__scheduler_wait(&q->senders, timeout, &msg);
+  }
+
+  mv_scheduler_unlock();
+  return ok;
+}
+
+bool mv_queue_send_from_isr(mv_queue_t *q, void *msg) {
+  bool ok;
+
+  nx_interrupts_disable();
+  ok = ring_put(q, msg);
+  nx_interrupts_enable();
+
+  if (ok)
+    mv__scheduler_defer(&q->isr_delivery);
+  return ok;
+}
+
+bool mv_queue_recv(mv_queue_t *q, void **msg, U32 timeout) {
+  bool ok;
+
+  NX_ASSERT(msg != NULL);
+
+  mv_scheduler_lock();
+  ok = queue_get(q, msg);
+  if (!ok && timeout > 0)
+    ok = mv__scheduler_wait(&q->receivers, timeout, msg);
+  mv_scheduler_unlock();
+
+  return ok;
+}
+
+bool mv_queue_try_recv(mv_queue_t *q, void **msg) {
+  return mv_queue_recv(q, msg, 0);
+}
+
+void mv_queue_destroy(mv_queue_t *q) {
+  mv_scheduler_lock();
+  NX_ASSERT(mv__wait_queue_is_empty(&q->receivers));
+  NX_ASSERT(mv__wait_queue_is_empty(&q->senders));
+  nx_free(q->ring);
+  nx_free(q);
+  mv_scheduler_unlock();
+}
@@ -0,0 +1,92 @@
+/** @file queue.h
+ *  @brief Marvin's message queues.
+ */
+
+/* Copyright (c) 2008 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#ifndef __NXOS_MARVIN_QUEUE_H__
+#define __NXOS_MARVIN_QUEUE_H__
+
+#include "base/types.h"
+
+typedef struct mv_queue mv_queue_t;
+
+/** Create a queue holding up to @a length messages.
+ *
+ * Messages are pointers, which are passed from the sender to the
+ * receiver as is. To pass data around without copying it, send
+ * buffers taken from a pool (see pool.h), and have the receiver
+ * return them to the pool.
+ *
+ * Messages are received in the order they were sent. When several
+ * tasks are blocked on a queue, the highest priority one is served
+ * first. A message sent to a queue that a task is waiting on is
+ * handed directly to that task.
+ *
+ * @param length The number of messages the queue can hold.
+ * @return A new queue.
+ */
+mv_queue_t *mv_queue_create(U32 length);
+
+/** Send @a msg to @a queue.
+ *
+ * If the queue is full, block until there is room for @a msg, or
+ * until the timeout expires.
+ *
+ * @param queue The queue.
+ * @param msg The message.
+ * @param timeout The longest time to wait in milliseconds, 0 to not
+ *                wait, or MV_TIMEOUT_FOREVER.
+ * @return TRUE if @a msg was sent, FALSE if the queue stayed full.
+ */
+bool mv_queue_send(mv_queue_t *queue, void *msg, U32 timeout);
+
+/** Send @a msg to @a queue from an interrupt handler.
+ *
+ * This never blocks. Tasks waiting for the message are woken up by
+ * the scheduler once the interrupt handler returns.
+ *
+ * @param queue The queue.
+ * @param msg The message.
+ * @return TRUE if @a msg was sent, FALSE if the queue was full.
+ */
+bool mv_queue_send_from_isr(mv_queue_t *queue, void *msg);
+
+/** Receive a message from @a queue.
+ *
+ * If the queue is empty, block until a message arrives, or until the
+ * timeout expires.
+ *
+ * @param queue The queue.
+ * @param msg Where to store the received message.
+ * @param timeout The longest time to wait in milliseconds, 0 to not
+ *                wait, or MV_TIMEOUT_FOREVER.
+ * @return TRUE if a message was received, FALSE if the queue stayed
+ * empty.
+ */
+bool mv_queue_recv(mv_queue_t *queue, void **msg, U32 timeout);
+
+/** Receive a message from @a queue without blocking.
+ *
+ * @param queue The queue.
+ * @param msg Where to store the received message.
+ * @return TRUE if a message was received, FALSE if the queue was
+ * empty.
+ */
+bool mv_queue_try_recv(mv_queue_t *queue, void **msg);
+
+/** Destroy @a queue and free its memory.
+ *
+ * @param queue The queue to destroy.
+ *
+ * @warning No task may be blocked on the queue.
+ */
+void mv_queue_destroy(mv_queue_t *queue);
+
+#endif /* __NXOS_MARVIN_QUEUE_H__ */
@@ -7,35 +7,110 @@
  */
 
 #include "base/core.h"
+#include "base/util.h"
 #include "base/assert.h"
 #include "base/interrupts.h"
 #include "base/display.h"
 #include "base/drivers/systick.h"
 #include "base/drivers/avr.h"
 #include "base/lib/memalloc/memalloc.h"
+#include "base/lib/tracing/tracing.h"
 #include "base/asm_decls.h"
 
 #include "marvin/_task.h"
 #include "marvin/list.h"
+#include "marvin/_completion.h"
 
 #include "marvin/_scheduler.h"
 
 /* Time in milliseconds (actually in number of systick callbacks)
- * between context switches.
+ * between context switches among tasks of the same priority.
  */
 #define TASK_EXECUTION_QUANTUM 2
 
-/* An alarm calendar entry. */
-struct mv_alarm_entry {
+/* Sleep alarms are kept in a two level timer wheel. The near wheel
+ * has one slot per millisecond for the next ALARM_NEAR_SPAN
+ * milliseconds, the far wheel one slot per ALARM_NEAR_SPAN
+ * milliseconds up to ALARM_FAR_SPAN milliseconds. Alarms further away
+ * wait in an overflow list.
+ *
+ * Every ALARM_NEAR_SPAN milliseconds, the next far slot is cascaded
+ * into the near wheel, and every ALARM_FAR_SPAN milliseconds the
+ * overflow list is cascaded into the wheels. This makes arming,
+ * cancelling and expiring an alarm constant time, give or take a few
+ * cascades.
+ */
+#define ALARM_WHEEL_BITS 6
+#define ALARM_WHEEL_SLOTS (1 << ALARM_WHEEL_BITS)
+#define ALARM_WHEEL_MASK (ALARM_WHEEL_SLOTS - 1)
+#define ALARM_NEAR_SPAN ALARM_WHEEL_SLOTS
+#define ALARM_FAR_SPAN (ALARM_WHEEL_SLOTS * ALARM_WHEEL_SLOTS)
+
+/* The longest delay of an alarm, about 12 days. Wakeup times are
+ * compared as signed differences, so delays must stay well below 2^31
+ * milliseconds; longer ones are shortened to this.
+ */
+#define ALARM_MAX_DELAY (1 << 30)
+
+/* The longest chain of tasks blocked on each other's resources that
+ * priority inheritance follows. This only matters if the tasks are
+ * deadlocked, in which case the chain loops.
+ */
+#define PI_MAX_CHAIN 16
+
+/* Task stacks are painted with STACK_PAINT when created, so that the
+ * deepest point the stack reached can be found later. The lowest word
+ * is a guard, checked every time the task is switched out.
+ */
+#define STACK_PAINT 0xA5A5A5A5
+#define STACK_GUARD 0xDEADBEEF
+
+/* The idle task's stack. The host simulation, whose words are wider,
+ * gives it a bigger one.
+ */
+#ifndef IDLE_STACK_SIZE
+#define IDLE_STACK_SIZE 128
+#endif
+
+/* An alarm, embedded in the task it wakes up. */
+struct mv_alarm {
   U32 wakeup_time;
   mv_task_t *task;
-  struct mv_alarm_entry *prev, *next;
+  struct mv_alarm **slot; /* The wheel slot holding the alarm, if armed. */
+  struct mv_alarm *prev, *next;
+};
+
+/* The state of a task blocked on a wait queue, embedded in the task. */
+struct mv_wait {
+  mv_task_t *task;
+  mv_wait_queue_t *queue; /* The queue the task waits on, or NULL. */
+  bool woken; /* TRUE if the task was woken, FALSE if it timed out. */
+  void *data; /* Exchanged between the waiting task and its waker. */
+  struct mv_wait *prev, *next;
 };
 
 /* A task descriptor. */
 struct mv_task {
   U32 *stack_base; /* The stack base (allocated pointer). */
   U32 *stack_current; /* The current position of the stack pointer. */
+  U32 stack_size; /* The size of the stack in bytes. */
+  U16 id; /* Task number, used to identify the task in traces. */
+  U8 priority; /* Task priority, higher runs first. */
+  U8 base_priority; /* Priority before inheritance. */
+  mv_wait_queue_t *owned; /* The wait queues this task owns. */
+  struct mv_alarm alarm; /* The task's wakeup alarm. */
+  struct mv_wait wait; /* The task's place in a wait queue. */
+  const char *name; /* Task name, for humans. */
+
+  /* CPU accounting, updated on context switches. */
+  struct {
+    U32 runtime_us; /* Time spent running (wraps around). */
+    U32 switches; /* Times the task was switched in. */
+    U32 voluntary; /* Times it gave up the CPU. */
+    U32 preempted; /* Times it was switched out while ready. */
+    U32 blocked_ms; /* Time spent blocked (wraps around). */
+    U32 blocked_since; /* When the task last blocked. */
+  } stats;
 
   /** Task state. */
   enum {
@@ -51,16 +126,38 @@ struct mv_task {
 
 /* The state of the scheduler. */
 static struct {
-  struct mv_task *tasks_ready; /* All the ready tasks waiting for CPU time. */
+  /* The ready tasks waiting for CPU time, one list per priority. */
+  struct mv_task *tasks_ready[MV_SCHEDULER_PRIORITIES];
+  U32 ready_mask; /* Bit N is set when tasks_ready[N] isn't empty. */
   struct mv_task *tasks_blocked; /* Unschedulable tasks. */
 
   struct mv_task *task_current; /* The task currently consuming CPU. */
   struct mv_task *task_idle; /* The idle task. */
 
-  struct mv_alarm_entry *alarms_pending; /* A list of pending wakeup calls. */
+  /* The pending wakeup calls. */
+  struct {
+    struct mv_alarm *near[ALARM_WHEEL_SLOTS];
+    struct mv_alarm *far[ALARM_WHEEL_SLOTS];
+    struct mv_alarm *overflow;
+    U32 time; /* The time the wheels have been advanced to. */
+    U32 armed; /* The number of armed alarms. */
+  } alarms;
 
   U32 last_context_switch; /* The time of the last context switch. */
-} sched_state = { NULL, NULL, NULL, NULL, NULL, 0 };
+  U32 last_switch_us; /* The same, in microseconds, for accounting. */
+
+  /* Set when a task of higher priority than the running one became
+   * ready, and should preempt it right away.
+   */
+  bool preempt;
+
+  /* Work deferred by interrupt handlers, in posting order. Protected
+   * by disabling interrupts.
+   */
+  mv_deferred_t *deferred_head, *deferred_tail;
+
+  U16 next_task_id; /* The id given to the next created task. */
+} sched_state;
 
 /* The scheduler lock count. This is a recursive mutex that protects
  * the data in sched_state.
@@ -73,33 +170,330 @@ static U32 sched_lock = 0;
 static enum {
   CMD_NONE = 0,
   CMD_YIELD, /* The preempted task wants to yield to another task. */
+  CMD_PREEMPT, /* The scheduler was locked when it wanted to preempt the
+                  task, and it unlocked. */
   CMD_DIE,   /* The preempted tasks asked to be killed. */
 } task_command = CMD_NONE;
 
-/* Decide on the next task to run. */
-static inline void reschedule(void) {
-  if (mv_list_is_empty(sched_state.tasks_ready)) {
+/* Return the highest priority that has ready tasks. The ARM7TDMI
+ * has no count leading zeros instruction, so look up the highest set
+ * bit of the ready mask a nibble at a time.
+ */
+#if MV_SCHEDULER_PRIORITIES > 8
+#error "highest_ready_priority() only looks at the low 8 bits of the mask"
+#endif
+
+static inline U32 highest_ready_priority(void) {
+  static const U8 msb[16] = { 0, 0, 1, 1, 2, 2, 2, 2,
+                              3, 3, 3, 3, 3, 3, 3, 3 };
+  U32 mask = sched_state.ready_mask;
+
+  if (mask & 0xF0)
+    return 4 + msb[mask >> 4];
+  return msb[mask];
+}
+
+/* Add a task at the end of the ready list of its priority. */
+static inline void ready_add(mv_task_t *task) {
+  mv_list_add_tail(sched_state.tasks_ready[task->priority], task);
+  sched_state.ready_mask |= (1 << task->priority);
+}
+
+/* Add a task at the head of the ready list of its priority. */
+static inline void ready_add_head(mv_task_t *task) {
+  mv_list_add_head(sched_state.tasks_ready[task->priority], task);
+  sched_state.ready_mask |= (1 << task->priority);
+}
+
+/* Remove a task from the ready list of its priority. */
+static inline void ready_remove(mv_task_t *task) {
+  mv_list_remove(sched_state.tasks_ready[task->priority], task);
+  if (mv_list_is_empty(sched_state.tasks_ready[task->priority]))
+    sched_state.ready_mask &= ~(1 << task->priority);
+}
+
+/* Decide on the next task to run: the first one in line of the
+ * highest priority that has ready tasks.
+ *
+ * A ready task stays at the head of its list while it runs, and keeps
+ * its place when a higher priority task preempts it. It only goes to
+ * the back of the line when @a rotate is set, because its quantum
+ * expired or it yielded.
+ */
+static inline void reschedule(bool rotate) {
+  mv_task_t *current = sched_state.task_current;
+
+  if (rotate && current != NULL && current->state == READY &&
+      current == mv_list_get_head(sched_state.tasks_ready[current->priority]))
+    mv_list_rotate_forward(sched_state.tasks_ready[current->priority]);
+
+  if (sched_state.ready_mask == 0) {
     sched_state.task_current = sched_state.task_idle;
   } else {
-    sched_state.task_current = mv_list_get_head(sched_state.tasks_ready);
-    mv_list_rotate_forward(sched_state.tasks_ready);
+    U32 priority = highest_ready_priority();
+    sched_state.task_current =
+      mv_list_get_head(sched_state.tasks_ready[priority]);
+  }
+  sched_state.preempt = FALSE;
+}
+
+/* Arm @a alarm in the slot matching its wakeup time. */
+static void alarm_add(struct mv_alarm *alarm) {
+  U32 delta = alarm->wakeup_time - sched_state.alarms.time;
+  struct mv_alarm **slot;
+
+  NX_ASSERT((S32)delta >= 0);
+
+  if (delta < ALARM_NEAR_SPAN)
+    slot = &sched_state.alarms.near[alarm->wakeup_time & ALARM_WHEEL_MASK];
+  else if (delta < ALARM_FAR_SPAN)
+    slot = &sched_state.alarms.far[(alarm->wakeup_time >> ALARM_WHEEL_BITS)
+                                   & ALARM_WHEEL_MASK];
+  else
+    slot = &sched_state.alarms.overflow;
+
+  mv_list_add_tail(*slot, alarm);
+  alarm->slot = slot;
+}
+
+/* Arm the alarm of @a task to go off in @a delay milliseconds. */
+static void alarm_arm(mv_task_t *task, U32 delay) {
+  task->alarm.wakeup_time = nx_systick_get_ms() + MIN(delay, ALARM_MAX_DELAY);
+  alarm_add(&task->alarm);
+  sched_state.alarms.armed++;
+}
+
+/* Disarm @a alarm. */
+static void alarm_remove(struct mv_alarm *alarm) {
+  mv_list_remove(*alarm->slot, alarm);
+  alarm->slot = NULL;
+}
+
+/* Redistribute the alarms of @a slot over the wheels. */
+static void alarms_cascade(struct mv_alarm **slot) {
+  struct mv_alarm *list = *slot;
+
+  mv_list_init(*slot);
+  while (!mv_list_is_empty(list))
+    alarm_add(mv_list_pop_head(list));
+}
+
+/* Advance the wheels up to @a now, waking up the tasks whose alarm
+ * expired on the way.
+ */
+static void alarms_advance(U32 now) {
+  struct mv_alarm **slot;
+
+  if (sched_state.alarms.armed == 0) {
+    sched_state.alarms.time = now;
+    return;
+  }
+
+  while ((S32)(now - sched_state.alarms.time) > 0) {
+    U32 t = ++sched_state.alarms.time;
+
+    /* The overflow goes first, it may refill the far slot that is
+     * cascaded next.
+     */
+    if ((t & (ALARM_FAR_SPAN - 1)) == 0)
+      alarms_cascade(&sched_state.alarms.overflow);
+    if ((t & ALARM_WHEEL_MASK) == 0)
+      alarms_cascade(&sched_state.alarms.far[(t >> ALARM_WHEEL_BITS)
+                                             & ALARM_WHEEL_MASK]);
+
+    slot = &sched_state.alarms.near[t & ALARM_WHEEL_MASK];
+    while (!mv_list_is_empty(*slot))
+      mv__scheduler_task_unblock(mv_list_get_head(*slot)->task);
+  }
+}
+
+/* Return the number of milliseconds until the wheels must next be
+ * advanced: the next alarm expiry, or the next cascade of a far slot
+ * that holds alarms.
+ */
+static U32 alarms_next_timeout(void) {
+  U32 t, deadline, now;
+
+  if (sched_state.alarms.armed == 0)
+    return 0xFFFFFFFF;
+
+  deadline = sched_state.alarms.time + ALARM_NEAR_SPAN;
+  for (t = sched_state.alarms.time + 1; t != deadline; t++) {
+    if (!mv_list_is_empty(sched_state.alarms.near[t & ALARM_WHEEL_MASK]))
+      break;
+    if ((t & ALARM_WHEEL_MASK) == 0 &&
+        (!mv_list_is_empty(sched_state.alarms.far[(t >> ALARM_WHEEL_BITS)
+                                                  & ALARM_WHEEL_MASK]) ||
+         ((t & (ALARM_FAR_SPAN - 1)) == 0 &&
+          !mv_list_is_empty(sched_state.alarms.overflow))))
+      break;
+  }
+
+  now = nx_systick_get_ms();
+  return ((S32)(t - now) > 0) ? t - now : 0;
+}
+
+/* Run the work posted by mv__scheduler_defer(). */
+static void run_deferred(void) {
+  mv_deferred_t *work;
+
+  while (sched_state.deferred_head != NULL) {
+    nx_interrupts_disable();
+    work = sched_state.deferred_head;
+    sched_state.deferred_head = work->next;
+    if (sched_state.deferred_head == NULL)
+      sched_state.deferred_tail = NULL;
+    work->pending = FALSE;
+    nx_interrupts_enable();
+
+    work->func(work->arg);
+  }
+}
+
+/* Insert a wait node in @a wq, after the waiters of the same or
+ * higher priority.
+ */
+static void wait_insert(mv_wait_queue_t *wq, struct mv_wait *w) {
+  if (mv_list_is_empty(wq->waiters)) {
+    mv_list_init_singleton(wq->waiters, w);
+  } else if (w->task->priority > wq->waiters->task->priority) {
+    mv_list_add_head(wq->waiters, w);
+  } else {
+    struct mv_wait *ptr = wq->waiters->prev;
+
+    while (ptr->task->priority < w->task->priority)
+      ptr = ptr->prev;
+    mv_list_insert_after(ptr, w);
+  }
+  w->queue = wq;
+}
+
+static void update_priority(mv_task_t *task);
+
+/* Remove a task's wait node from its wait queue. */
+static void wait_remove(struct mv_wait *wait) {
+  mv_wait_queue_t *wq = wait->queue;
+
+  mv_list_remove(wq->waiters, wait);
+  wait->queue = NULL;
+
+  /* The owner may have been inheriting the waiter's priority. */
+  if (wq->owner != NULL)
+    update_priority(wq->owner);
+}
+
+/* Change the effective priority of @a task, moving it to the matching
+ * ready list or place in its wait queue.
+ */
+static void set_priority(mv_task_t *task, U8 priority) {
+  mv_task_t *current = sched_state.task_current;
+
+  if (task->state == READY) {
+    ready_remove(task);
+    task->priority = priority;
+    /* The running task stays first in line, see reschedule(). */
+    if (task == current)
+      ready_add_head(task);
+    else
+      ready_add(task);
+  } else {
+    task->priority = priority;
+    if (task->wait.queue != NULL) {
+      mv_list_remove(task->wait.queue->waiters, &task->wait);
+      wait_insert(task->wait.queue, &task->wait);
+    }
+  }
+
+  /* Preempt the current task if it was lowered below a ready task, or
+   * if a ready task was raised above it.
+   */
+  if (current == NULL || current == sched_state.task_idle) {
+    if (sched_state.ready_mask != 0)
+      sched_state.preempt = TRUE;
+  } else if (task == current) {
+    if (highest_ready_priority() > priority)
+      sched_state.preempt = TRUE;
+  } else if (task->state == READY && priority > current->priority) {
+    sched_state.preempt = TRUE;
+  }
+}
+
+/* Recompute the effective priority of @a task: its base priority, or
+ * the priority of the most important task waiting on a wait queue it
+ * owns. The change is propagated to the owner of what @a task itself
+ * waits on, and so on.
+ */
+static void update_priority(mv_task_t *task) {
+  mv_wait_queue_t *wq;
+  U32 hops;
+  U8 priority;
+
+  for (hops = 0; task != NULL && hops < PI_MAX_CHAIN; hops++) {
+    priority = task->base_priority;
+    wq = task->owned;
+    if (wq != NULL) {
+      do {
+        if (!mv_list_is_empty(wq->waiters) &&
+            wq->waiters->task->priority > priority)
+          priority = wq->waiters->task->priority;
+        wq = wq->next;
+      } while (wq != task->owned);
+    }
+
+    if (priority == task->priority)
+      return;
+    set_priority(task, priority);
+
+    task = task->wait.queue ? task->wait.queue->owner : NULL;
   }
 }
 
 /* Destroy the task that was just preempted. */
 static inline void destroy_running_task(void) {
-  mv_list_remove(sched_state.tasks_ready, sched_state.task_current);
+  NX_ASSERT_MSG(mv_list_is_empty(sched_state.task_current->owned),
+                "Task died owning\na resource");
+  ready_remove(sched_state.task_current);
   nx_free(sched_state.task_current->stack_base);
   nx_free(sched_state.task_current);
   sched_state.task_current = NULL;
 }
 
+/* Check that @a task hasn't overflowed its stack. By the time this
+ * notices, the overflow may well have corrupted the heap, so halt with
+ * the name of the culprit.
+ */
+static inline void check_stack(mv_task_t *task) {
+  if (task->stack_base[0] != STACK_GUARD ||
+      task->stack_current < task->stack_base)
+    nx_assert_error(__FILE__, __LINE__, "Stack overflow",
+                    task->name ? task->name : "?");
+}
+
+/* Charge the time since the last context switch to @a prev (NULL if
+ * it died), and count the switch to the current task. This only costs
+ * a read of the system timer per switch.
+ */
+static inline void account_switch(mv_task_t *prev, bool voluntary) {
+  U32 now = nx_systick_get_us();
+
+  if (prev != NULL) {
+    prev->stats.runtime_us += now - sched_state.last_switch_us;
+    if (voluntary || prev->state == BLOCKED)
+      prev->stats.voluntary++;
+    else
+      prev->stats.preempted++;
+  }
+  sched_state.task_current->stats.switches++;
+  sched_state.last_switch_us = now;
+}
+
 /* This is where most of the magic happens. This function gets called
  * every millisecond to handle scheduling decisions.
  */
 static void scheduler_cb(void) {
   U32 time = nx_systick_get_ms();
-  bool need_reschedule = FALSE;
+  bool need_reschedule = FALSE, voluntary = FALSE;
+  bool expired;
 
   /* Security mechanism: in case the system crashes, as long as the
    * scheduler is still running, the brick can be powered off.
@@ -113,13 +507,22 @@ static void scheduler_cb(void) {
 
   sched_lock = 1;
 
+  /* Check if the task quantum for the running task has expired. */
+  expired = time - sched_state.last_context_switch >= TASK_EXECUTION_QUANTUM;
+
   /* Process pending commands, if any */
   if (task_command != CMD_NONE) {
     switch (task_command) {
     case CMD_YIELD:
+      need_reschedule = TRUE;
+      voluntary = TRUE;
+      break;
+    case CMD_PREEMPT:
       need_reschedule = TRUE;
       break;
     case CMD_DIE:
+      nx_tracing_add_event(NX_TRACE_END, NX_TRACE_TRACK_TASK,
+                           sched_state.task_current->id);
       destroy_running_task();
       need_reschedule = TRUE;
       break;
@@ -128,28 +531,40 @@ static void scheduler_cb(void) {
     }
     task_command = CMD_NONE;
     nx_systick_unmask_scheduler();
-  } else {
-    /* Check if the task quantum for the running task has expired. */
-    if (time - sched_state.last_context_switch >= TASK_EXECUTION_QUANTUM)
-      need_reschedule = TRUE;
+  } else if (expired) {
+    need_reschedule = TRUE;
   }
 
   /* Wake up tasks that have scheduled alarms. */
-  while (!mv_list_is_empty(sched_state.alarms_pending) &&
-         sched_state.alarms_pending->wakeup_time <= time) {
-    struct mv_alarm_entry *a = sched_state.alarms_pending;
-    mv_list_remove(sched_state.alarms_pending, sched_state.alarms_pending);
-    mv__scheduler_task_unblock(a->task);
-    nx_free(a);
-  }
+  alarms_advance(time);
+
+  /* Run the work deferred by interrupt handlers, which may wake up
+   * tasks.
+   */
+  run_deferred();
+
+  /* A higher priority task became ready. */
+  if (sched_state.preempt)
+    need_reschedule = TRUE;
 
   /* Task switching time? */
   if (need_reschedule) {
-    if (sched_state.task_current != NULL)
-      sched_state.task_current->stack_current = mv__task_get_stack();
-    reschedule();
+    mv_task_t *prev = sched_state.task_current;
+    if (prev != NULL) {
+      prev->stack_current = mv__task_get_stack();
+      check_stack(prev);
+    }
+    reschedule(voluntary || expired);
     mv__task_set_stack(sched_state.task_current->stack_current);
     sched_state.last_context_switch = nx_systick_get_ms();
+
+    if (sched_state.task_current != prev) {
+      account_switch(prev, voluntary);
+      if (prev != NULL)
+        nx_tracing_add_event(NX_TRACE_END, NX_TRACE_TRACK_TASK, prev->id);
+      nx_tracing_add_event(NX_TRACE_BEGIN, NX_TRACE_TRACK_TASK,
+                           sched_state.task_current->id);
+    }
   }
 
   sched_lock = 0;
@@ -165,24 +580,40 @@ static void task_shutdown(void) {
 /* Build a new task descriptor for a task that will run the given
  * function when activated.
  */
-static mv_task_t *new_task(nx_closure_t func, U32 stack_size) {
+static mv_task_t *new_task(nx_closure_t func, U32 stack_size, U8 priority,
+                           const char *name) {
   mv_task_t *t;
   nx_task_stack_t *s;
+  U32 i;
 
   NX_ASSERT_MSG((stack_size & 0x3) == 0, "Stack must be\n4-byte aligned");
+  NX_ASSERT(stack_size > sizeof(*s) + sizeof(U32));
+  NX_ASSERT(priority < MV_SCHEDULER_PRIORITIES);
 
   t = nx_calloc(1, sizeof(*t));
-  t->stack_base = nx_calloc(1, stack_size);
+  t->stack_base = nx_malloc(stack_size);
+  t->stack_size = stack_size;
+  t->stack_base[0] = STACK_GUARD;
+  for (i = 1; i < stack_size / sizeof(U32); i++)
+    t->stack_base[i] = STACK_PAINT;
   t->stack_current = (U32*) ((U32)t->stack_base + stack_size - sizeof(*s));
   s = (nx_task_stack_t*)t->stack_current;
   s->pc = (U32) func;
   s->lr = (U32) task_shutdown;
   s->cpsr = MODE_SYS;
   if (s->pc & 0x1) {
-    s->pc &= 0xFFFFFFFE;
+    s->pc &= ~0x1;
     s->cpsr |= 0x20;
   }
   t->state = READY;
+  t->id = sched_state.next_task_id++;
+  t->priority = priority;
+  t->base_priority = priority;
+  t->alarm.task = t;
+  t->wait.task = t;
+  t->name = name;
+  if (name != NULL)
+    nx_tracing_add_name(NX_TRACE_TRACK_TASK, t->id, name);
 
   mv_list_init_singleton(t, t);
 
@@ -203,21 +634,36 @@ static void task_idle(void) {
      */
     if (mv_list_is_empty(sched_state.tasks_blocked))
       NX_FAIL("All tasks dead");
+
+    /* Sleep until the next alarm, or until an interrupt. Interrupts
+     * are disabled from the check to the sleep, so that a task
+     * readied in between isn't left waiting for the alarm.
+     */
+    nx_interrupts_disable();
+    if (sched_state.ready_mask == 0 && !sched_state.preempt)
+      nx_systick_idle(alarms_next_timeout());
+    nx_interrupts_enable();
+
     mv_scheduler_yield(FALSE);
   }
 }
 
 void mv__scheduler_init(void) {
-  sched_state.task_idle = new_task(task_idle, 128);
+  sched_state.task_idle = new_task(task_idle, IDLE_STACK_SIZE,
+                                   MV_PRIORITY_LOWEST, "idle");
   /* The idle task doesn't start with a rolled up task state. Rewind its
-   * current stack position.
+   * current stack position to the top of its stack.
    */
-  sched_state.task_idle->stack_current += sizeof(nx_task_stack_t);
+  sched_state.task_idle->stack_current +=
+    sizeof(nx_task_stack_t) / sizeof(U32);
   sched_state.task_current = sched_state.task_idle;
 }
 
 void mv__scheduler_run(void) {
   sched_state.last_context_switch = nx_systick_get_ms();
+  sched_state.alarms.time = sched_state.last_context_switch;
+  sched_state.last_switch_us = nx_systick_get_us();
+  mv__completion_init();
   nx_interrupts_disable();
   nx_systick_install_scheduler(scheduler_cb);
   mv__task_run_first(task_idle, sched_state.task_idle->stack_current);
@@ -226,8 +672,9 @@ void mv__scheduler_run(void) {
 void mv__scheduler_task_block(void) {
   mv_scheduler_lock();
   NX_ASSERT(sched_state.task_current->state == READY);
-  mv_list_remove(sched_state.tasks_ready, sched_state.task_current);
+  ready_remove(sched_state.task_current);
   sched_state.task_current->state = BLOCKED;
+  sched_state.task_current->stats.blocked_since = nx_systick_get_ms();
   mv_list_add_tail(sched_state.tasks_blocked, sched_state.task_current);
   mv_scheduler_unlock();
 }
@@ -235,53 +682,201 @@ void mv__scheduler_task_block(void) {
 void mv__scheduler_task_unblock(mv_task_t *task) {
   mv_scheduler_lock();
   NX_ASSERT(task->state == BLOCKED);
+  if (task->alarm.slot != NULL) {
+    alarm_remove(&task->alarm);
+    sched_state.alarms.armed--;
+  }
+  if (task->wait.queue != NULL)
+    wait_remove(&task->wait);
   mv_list_remove(sched_state.tasks_blocked, task);
   task->state = READY;
-  mv_list_add_tail(sched_state.tasks_ready, task);
+  task->stats.blocked_ms += nx_systick_get_ms() - task->stats.blocked_since;
+  ready_add(task);
+
+  /* The idle task runs below all priorities. The preemption happens
+   * when the scheduler completely unlocks.
+   */
+  if (sched_state.task_current == NULL ||
+      sched_state.task_current == sched_state.task_idle ||
+      task->priority > sched_state.task_current->priority)
+    sched_state.preempt = TRUE;
   mv_scheduler_unlock();
 }
 
+/* Unlock the scheduler, and return once the current task @a task,
+ * which is blocked, has been woken up.
+ *
+ * The unlock raises the scheduler interrupt, but the processor may
+ * not take it right away. If the caller took the lock again in the
+ * meantime, the scheduler would find itself locked and leave the task
+ * running while blocked. So wait for the switch, raising the interrupt
+ * again until it happens.
+ */
+static void unlock_and_block(mv_task_t *task) {
+  NX_ASSERT(sched_lock == 1);
+
+  mv_scheduler_unlock();
+  while (task->state == BLOCKED)
+    nx_systick_call_scheduler();
+}
+
 void mv__scheduler_task_suspend(U32 time) {
-  struct mv_alarm_entry *a;
+  mv_task_t *task;
+
   mv_scheduler_lock();
-  NX_ASSERT(sched_state.task_current->state == READY);
+  task = sched_state.task_current;
+  NX_ASSERT(task->state == READY);
+
+  mv__scheduler_task_block();
+  alarm_arm(task, time);
+
+  /* The alarm is programmed and the task configured to block. It will
+   * be preempted when the scheduler completely unlocks.
+   */
+  unlock_and_block(task);
+}
+
+void mv__wait_queue_init(mv_wait_queue_t *wq) {
+  mv_list_init(wq->waiters);
+  wq->owner = NULL;
+}
+
+void mv__wait_queue_set_owner(mv_wait_queue_t *wq, mv_task_t *owner) {
+  mv_task_t *prev;
+
+  mv_scheduler_lock();
+  prev = wq->owner;
+  if (prev != NULL) {
+    mv_list_remove(prev->owned, wq);
+    wq->owner = NULL;
+    update_priority(prev);
+  }
+  if (owner != NULL) {
+    wq->owner = owner;
+    mv_list_add_tail(owner->owned, wq);
+    update_priority(owner);
+  }
+  mv_scheduler_unlock();
+}
+
+bool mv__wait_queue_is_empty(mv_wait_queue_t *wq) {
+  return mv_list_is_empty(wq->waiters);
+}
 
-  /* Prepare the alarm descriptor. */
-  a = nx_calloc(1, sizeof(*a));
-  a->wakeup_time = nx_systick_get_ms() + time;
-  a->task = sched_state.task_current;
+bool mv__scheduler_can_block(void) {
+  return (sched_lock == 0 &&
+          sched_state.task_current != sched_state.task_idle);
+}
+
+bool mv__scheduler_wait(mv_wait_queue_t *wq, U32 timeout, void **data) {
+  mv_task_t *task = sched_state.task_current;
+  struct mv_wait *w = &task->wait;
+
+  NX_ASSERT(sched_lock == 1);
+  NX_ASSERT(task->state == READY);
+
+  w->woken = FALSE;
+  w->data = data ? *data : NULL;
 
   mv__scheduler_task_block();
+  wait_insert(wq, w);
 
-  /* If the alarm list is empty, the initialization is
-   * trivial. Otherwise, we need to locate the correct place in the list
-   * for a sorted insertion.
+  /* Lend our priority to the owner of what we wait for. */
+  if (wq->owner != NULL)
+    update_priority(wq->owner);
+  if (timeout != MV_TIMEOUT_FOREVER)
+    alarm_arm(task, timeout);
+
+  /* Block until woken up or timed out, and take the lock back for the
+   * caller.
    */
-  if (mv_list_is_empty(sched_state.alarms_pending)) {
-    mv_list_init_singleton(sched_state.alarms_pending, a);
-  } else if (a->wakeup_time <= sched_state.alarms_pending->wakeup_time) {
-    mv_list_add_head(sched_state.alarms_pending, a);
-  } else if (a->wakeup_time >= sched_state.alarms_pending->prev->wakeup_time) {
-    mv_list_add_tail(sched_state.alarms_pending, a);
-  } else {
-    struct mv_alarm_entry *ptr = sched_state.alarms_pending;
+  unlock_and_block(task);
+  mv_scheduler_lock();
 
-    while(ptr->next->wakeup_time < a->wakeup_time)
-      ptr = ptr->next;
+  if (data)
+    *data = w->data;
+  return w->woken;
+}
+
+bool mv__scheduler_wake_one(mv_wait_queue_t *wq, void **data) {
+  struct mv_wait *w;
+  void *given;
 
-    mv_list_insert_after(ptr, a);
+  mv_scheduler_lock();
+  w = mv_list_get_head(wq->waiters);
+  if (w != NULL) {
+    given = data ? *data : NULL;
+    if (data)
+      *data = w->data;
+    w->data = given;
+    w->woken = TRUE;
+    mv__scheduler_task_unblock(w->task);
   }
+  mv_scheduler_unlock();
 
-  /* The alarm is programmed and the task configured to block. It will
-   * be preempted when the scheduler completely unlocks.
+  return w != NULL;
+}
+
+void mv__scheduler_wake_all(mv_wait_queue_t *wq) {
+  mv_scheduler_lock();
+  while (!mv_list_is_empty(wq->waiters)) {
+    wq->waiters->woken = TRUE;
+    mv__scheduler_task_unblock(wq->waiters->task);
+  }
+  mv_scheduler_unlock();
+}
+
+void mv__scheduler_wake_matching(mv_wait_queue_t *wq,
+                                 bool (*match)(void *data, void *arg),
+                                 void *arg) {
+  struct mv_wait *w, *next;
+  U32 n = 0;
+
+  mv_scheduler_lock();
+
+  /* Waking a task removes it from the queue, so count the waiters
+   * first, and walk that many of them.
    */
+  w = wq->waiters;
+  if (w != NULL) {
+    do {
+      n++;
+      w = w->next;
+    } while (w != wq->waiters);
+  }
+
+  for (; n > 0; n--, w = next) {
+    next = w->next;
+    if (match(w->data, arg)) {
+      w->woken = TRUE;
+      mv__scheduler_task_unblock(w->task);
+    }
+  }
+
   mv_scheduler_unlock();
 }
 
-void mv_scheduler_create_task(nx_closure_t func, U32 stack) {
-  mv_task_t *t = new_task(func, stack);
+void mv__scheduler_defer(mv_deferred_t *work) {
+  nx_interrupts_disable();
+  if (!work->pending) {
+    work->pending = TRUE;
+    work->next = NULL;
+    if (sched_state.deferred_tail)
+      sched_state.deferred_tail->next = work;
+    else
+      sched_state.deferred_head = work;
+    sched_state.deferred_tail = work;
+  }
+  nx_interrupts_enable();
+
+  nx_systick_call_scheduler();
+}
+
+void mv_scheduler_create_task(nx_closure_t func, U32 stack, U8 priority,
+                              const char *name) {
+  mv_task_t *t = new_task(func, stack, priority, name);
   mv_scheduler_lock();
-  mv_list_add_tail(sched_state.tasks_ready, t);
+  ready_add(t);
   mv_scheduler_unlock();
 }
 
@@ -293,6 +888,72 @@ void mv_scheduler_yield(bool unlock) {
   nx_systick_call_scheduler();
 }
 
+U32 mv_task_stack_high_water(mv_task_t *task) {
+  U32 i, words = task->stack_size / sizeof(U32);
+
+  /* The stack grows down: the untouched paint is at the bottom. */
+  for (i = 1; i < words && task->stack_base[i] == STACK_PAINT; i++);
+
+  return (words - i) * sizeof(U32);
+}
+
+/* Fill in @a info with the state of @a task. */
+static void task_get_info(mv_task_t *task, mv_task_info_t *info,
+                          U32 now_ms, U32 now_us) {
+  info->name = task->name;
+  info->id = task->id;
+  info->priority = task->priority;
+  info->base_priority = task->base_priority;
+  info->running = (task == sched_state.task_current);
+  info->blocked = (task->state == BLOCKED);
+  info->runtime_us = task->stats.runtime_us;
+  info->switches = task->stats.switches;
+  info->voluntary = task->stats.voluntary;
+  info->preempted = task->stats.preempted;
+  info->blocked_ms = task->stats.blocked_ms;
+  info->stack_size = task->stack_size;
+  info->stack_used = mv_task_stack_high_water(task);
+
+  /* Include the time slice or block in progress. */
+  if (info->running)
+    info->runtime_us += now_us - sched_state.last_switch_us;
+  if (info->blocked)
+    info->blocked_ms += now_ms - task->stats.blocked_since;
+}
+
+U32 mv_scheduler_get_tasks(mv_task_info_t *info, U32 max) {
+  mv_task_t *lists[MV_SCHEDULER_PRIORITIES + 1];
+  mv_task_t *task;
+  U32 now_ms, now_us, i, n = 0;
+
+  mv_scheduler_lock();
+  now_ms = nx_systick_get_ms();
+  now_us = nx_systick_get_us();
+
+  if (n < max)
+    task_get_info(sched_state.task_idle, &info[n], now_ms, now_us);
+  n++;
+
+  for (i = 0; i < MV_SCHEDULER_PRIORITIES; i++)
+    lists[i] = sched_state.tasks_ready[MV_SCHEDULER_PRIORITIES - 1 - i];
+  lists[MV_SCHEDULER_PRIORITIES] = sched_state.tasks_blocked;
+
+  for (i = 0; i < MV_SCHEDULER_PRIORITIES + 1; i++) {
+    task = lists[i];
+    if (task == NULL)
+      continue;
+    do {
+      if (n < max)
+        task_get_info(task, &info[n], now_ms, now_us);
+      n++;
+      task = task->next;
+    } while (task != lists[i]);
+  }
+
+  mv_scheduler_unlock();
+  return n;
+}
+
 mv_task_t *mv_scheduler_get_current_task(void) {
   return sched_state.task_current;
 }
@@ -308,9 +969,11 @@ void mv_scheduler_unlock(void) {
   if (sched_lock == 1) {
     U32 delta = nx_systick_get_ms() - sched_state.last_context_switch;
     if (sched_state.task_current->state == BLOCKED ||
+        sched_state.preempt ||
+        sched_state.deferred_head != NULL ||
         delta >= TASK_EXECUTION_QUANTUM) {
       nx_systick_mask_scheduler();
-      task_command = CMD_YIELD;
+      task_command = CMD_PREEMPT;
       sched_lock--;
       nx_systick_call_scheduler();
       return;
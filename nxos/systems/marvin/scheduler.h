@@ -17,22 +17,53 @@
 
 typedef struct mv_task mv_task_t;
 
+/** The number of task priority levels. */
+#define MV_SCHEDULER_PRIORITIES 8
+
+/** Task priorities.
+ *
+ * The scheduler always runs a ready task of the highest priority. A
+ * task that becomes ready preempts the running task immediately if
+ * its priority is higher. Tasks of the same priority share the CPU
+ * in a round-robin fashion.
+ *
+ * Any value between MV_PRIORITY_LOWEST and MV_PRIORITY_HIGHEST may be
+ * used.
+ */
+enum {
+  MV_PRIORITY_LOWEST = 0, /**< Background work. */
+  MV_PRIORITY_NORMAL = 3, /**< The usual priority of tasks. */
+  MV_PRIORITY_HIGHEST = MV_SCHEDULER_PRIORITIES - 1, /**< Hard deadlines. */
+};
+
+/** Timeout value for waits that never time out. */
+#define MV_TIMEOUT_FOREVER 0xFFFFFFFF
+
 /** Create a new task executing @a func, with @a stack bytes of stack.
  *
  * The task is placed in the ready state and enqueued for CPU time.
  *
  * @param func The function the new task should execute.
  * @param stack The size of the task stack in bytes.
+ * @param priority The priority of the task, from MV_PRIORITY_LOWEST
+ *                 to MV_PRIORITY_HIGHEST.
+ * @param name A short name for the task, shown by the task statistics
+ *             and traces, or NULL. The string is not copied.
  *
  * @warning The stack should have sizeof(nx_task_stack_t) bytes
- * available for task switching at all times.
+ * available for task switching at all times. Marvin halts with a
+ * "Stack overflow" error if it finds that a task went past the end of
+ * its stack, but only when switching tasks, by which time other data
+ * may have been overwritten.
  *
  * @warning Currently this function can only be run before the scheduler
  * starts up.
  *
- * @note The usual size for the task stack is 1k, ie. 1024 bytes.
+ * @note The usual size for the task stack is 1k, ie. 1024 bytes. Use
+ * mv_task_stack_high_water() to find how much a task really needs.
  */
-void mv_scheduler_create_task(nx_closure_t func, U32 stack);
+void mv_scheduler_create_task(nx_closure_t func, U32 stack, U8 priority,
+                              const char *name);
 
 /** Explicitely yield the CPU.
  *
@@ -44,6 +75,50 @@ void mv_scheduler_create_task(nx_closure_t func, U32 stack);
  */
 void mv_scheduler_yield(bool unlock);
 
+/** A snapshot of a task's state and CPU accounting.
+ *
+ * Times wrap around, and are meant to be compared between snapshots:
+ * the run time every 71 minutes, the blocked time every 49 days.
+ */
+typedef struct {
+  const char *name; /**< The task's name, or NULL. */
+  U16 id; /**< The task's number. */
+  U8 priority; /**< Current priority, including inheritance. */
+  U8 base_priority; /**< Priority given at creation. */
+  bool running; /**< TRUE for the task that took the snapshot. */
+  bool blocked; /**< TRUE if the task is blocked. */
+  U32 runtime_us; /**< CPU time used, in microseconds. */
+  U32 switches; /**< Times the task was switched in. */
+  U32 voluntary; /**< Times it blocked or yielded. */
+  U32 preempted; /**< Times it was preempted. */
+  U32 blocked_ms; /**< Time spent blocked, in milliseconds. */
+  U32 stack_size; /**< Size of the task's stack, in bytes. */
+  U32 stack_used; /**< The most stack the task ever used, in bytes. */
+} mv_task_info_t;
+
+/** Take a snapshot of all the tasks, including the idle task.
+ *
+ * The idle task comes first, followed by the ready tasks by decreasing
+ * priority, and the blocked tasks.
+ *
+ * @param info Filled with up to @a max task snapshots.
+ * @param max The size of @a info.
+ * @return The number of tasks, which may be more than @a max.
+ */
+U32 mv_scheduler_get_tasks(mv_task_info_t *info, U32 max);
+
+/** Return the most stack @a task ever used.
+ *
+ * Stacks are painted with a pattern when tasks are created, and this
+ * looks for the deepest overwritten word. A task could write the
+ * pattern itself, or skip over stack it reserved without writing it,
+ * so leave some margin when sizing stacks after this.
+ *
+ * @param task The task.
+ * @return The high water mark of the stack, in bytes.
+ */
+U32 mv_task_stack_high_water(mv_task_t *task);
+
 /** Return a handle to the current task.
  *
  * @return The mv_task_t handle of the current task.
@@ -46,6 +46,16 @@ mv_sem_t *mv_semaphore_create(S32 count);
  */
 void mv_semaphore_dec(mv_sem_t *sem);
 
+/** Acquire one resource of @a sem, waiting at most @a timeout
+ * milliseconds for one to become available.
+ *
+ * @param sem The semaphore to decrement.
+ * @param timeout The longest time to wait in milliseconds, 0 to not
+ *                wait, or MV_TIMEOUT_FOREVER.
+ * @return TRUE if a resource was acquired, FALSE on timeout.
+ */
+bool mv_semaphore_dec_timeout(mv_sem_t *sem, U32 timeout);
+
 /** Attempt to acquire one resource of @a sem.
  *
  * The function call will not block. The return value indicates whether
@@ -0,0 +1,485 @@
+/* Copyright (c) 2008 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+/* Host backend for Marvin's scheduler. This stands in for task.S, and
+ * for the parts of the Baseplate that the scheduler, semaphores and
+ * time use: the system timer, interrupt masking, memory allocation,
+ * tracing and assertions.
+ *
+ * Each task runs in a ucontext with a stack of its own on the host. The
+ * scheduler still believes it manages the tasks' stacks: the stack
+ * pointer it saves and restores is used as the key of the task's
+ * context. A new task is recognized by its stack pointer not having a
+ * context yet, and is started from the frame that the scheduler built
+ * on its stack.
+ *
+ * Interrupts are delivered at the points where they could be taken on
+ * the brick: when interrupts are enabled, when the scheduler interrupt
+ * is triggered, and when virtual time passes.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <ucontext.h>
+
+#include "base/types.h"
+#include "base/core.h"
+#include "base/assert.h"
+#include "base/interrupts.h"
+#include "base/drivers/systick.h"
+#include "base/drivers/avr.h"
+#include "base/lib/memalloc/memalloc.h"
+#include "base/lib/tracing/tracing.h"
+
+#include "marvin/_task.h"
+#include "marvin/_scheduler.h"
+
+#include "marvin/sim/sim.h"
+
+/* Host stack given to every task. Host code, like printf, needs far
+ * more than the stack sizes tuned for the brick.
+ */
+#define HOST_STACK_SIZE (64 * 1024)
+
+/* The longest the idle task sleeps in one go, like the PIT's longest
+ * period.
+ */
+#define IDLE_MAX_MS 1000
+
+#define FNV_OFFSET 2166136261UL
+#define FNV_PRIME 16777619UL
+
+/* The CPSR's Thumb bit, which new_task() moves out of the entry
+ * point's address.
+ */
+#define CPSR_THUMB 0x20
+
+/* A task's execution context on the host. */
+struct sim_context {
+  U32 *key; /* The task's stack pointer, as saved by the scheduler. */
+  U32 index; /* Creation order, stable from run to run. */
+  nx_closure_t func; /* The task function. */
+  nx_closure_t exit; /* Called if @a func returns. */
+  bool dead; /* Set once the task function returned. */
+  ucontext_t uc;
+  void *stack;
+  struct sim_context *next;
+};
+
+static struct {
+  U64 now; /* Virtual time, in microseconds. */
+  U64 end; /* When the run stops. */
+  bool running; /* FALSE outside of sim_run(). */
+  bool ticked; /* A millisecond boundary passed since the last tick. */
+  U64 period_end; /* End of the period shortened by an early wake. */
+
+  /* Interrupt masking: the nx_interrupts_disable() nesting count, and
+   * whether an interrupt handler is running.
+   */
+  U32 irq_disabled;
+  bool in_irq;
+
+  nx_closure_t scheduler_cb;
+  bool scheduler_inhibit;
+  bool scheduler_pending;
+
+  sim_event_t *events; /* Armed events, in time order. */
+
+  struct sim_context *contexts;
+  struct sim_context *current;
+  struct sim_context *next_ctx; /* Set by mv__task_set_stack(). */
+  struct sim_context *zombie; /* A dead context to free. */
+  U32 n_contexts;
+  ucontext_t host; /* Where sim_run() returns to. */
+
+  U64 switch_start; /* Host time at which the last switch started. */
+  sim_stats_t stats;
+} sim;
+
+static U64 host_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (U64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Stop the run, from whatever context is current. */
+static void sim_finish(void) {
+  setcontext(&sim.host);
+}
+
+/*
+ * Task contexts.
+ */
+
+/* Free the context of a task that died on its way out. */
+static void reap(void) {
+  struct sim_context **ptr;
+
+  sim.stats.switch_host_ns += host_ns() - sim.switch_start;
+
+  if (sim.zombie == NULL)
+    return;
+  for (ptr = &sim.contexts; *ptr != sim.zombie; ptr = &(*ptr)->next);
+  *ptr = sim.zombie->next;
+  free(sim.zombie->stack);
+  free(sim.zombie);
+  sim.zombie = NULL;
+}
+
+static void context_entry(void) {
+  struct sim_context *ctx = sim.current;
+
+  reap();
+  ctx->func();
+
+  /* Like returning into task_shutdown() on the brick. The stack the
+   * key points to is freed by the scheduler, so a new task may come
+   * back with the same key.
+   */
+  ctx->dead = TRUE;
+  if (ctx->exit)
+    ctx->exit();
+  NX_FAIL("Dead task\nrescheduled");
+}
+
+static struct sim_context *context_new(U32 *key, nx_closure_t func,
+                                       nx_closure_t exit) {
+  struct sim_context *ctx = calloc(1, sizeof(*ctx));
+
+  NX_ASSERT(ctx != NULL);
+  ctx->key = key;
+  ctx->index = sim.n_contexts++;
+  ctx->func = func;
+  ctx->exit = exit;
+  ctx->stack = malloc(HOST_STACK_SIZE);
+  NX_ASSERT(ctx->stack != NULL);
+
+  getcontext(&ctx->uc);
+  ctx->uc.uc_stack.ss_sp = ctx->stack;
+  ctx->uc.uc_stack.ss_size = HOST_STACK_SIZE;
+  ctx->uc.uc_link = NULL;
+  makecontext(&ctx->uc, context_entry, 0);
+
+  ctx->next = sim.contexts;
+  sim.contexts = ctx;
+  return ctx;
+}
+
+/* Find the context of the task whose stack pointer is @a key, or
+ * create it from the initial frame that new_task() built there.
+ */
+static struct sim_context *context_get(U32 *key) {
+  struct sim_context *ctx;
+  nx_task_stack_t *s = (nx_task_stack_t*)key;
+  U32 pc;
+
+  for (ctx = sim.contexts; ctx != NULL; ctx = ctx->next)
+    if (ctx->key == key && !ctx->dead)
+      return ctx;
+
+  pc = s->pc;
+  if (s->cpsr & CPSR_THUMB)
+    pc |= 1;
+  return context_new(key, (nx_closure_t)pc, (nx_closure_t)s->lr);
+}
+
+static void switch_to(struct sim_context *next) {
+  struct sim_context *prev = sim.current;
+
+  sim.stats.switches++;
+  sim.stats.schedule_hash =
+    ((sim.stats.schedule_hash ^ next->index) * FNV_PRIME) & 0xFFFFFFFF;
+  sim.stats.schedule_hash =
+    ((sim.stats.schedule_hash ^ (U32)sim.now) * FNV_PRIME) & 0xFFFFFFFF;
+
+  if (prev->dead)
+    sim.zombie = prev;
+  sim.current = next;
+  sim.switch_start = host_ns();
+  swapcontext(&prev->uc, &next->uc);
+  reap();
+}
+
+void mv__task_run_first(nx_closure_t func, U32 *stack) {
+  sim.current = context_new(stack, func, NULL);
+  sim.switch_start = host_ns();
+  swapcontext(&sim.host, &sim.current->uc);
+}
+
+U32 *mv__task_get_stack(void) {
+  return sim.current->key;
+}
+
+void mv__task_set_stack(U32 *stack) {
+  sim.next_ctx = context_get(stack);
+}
+
+/*
+ * Interrupts.
+ */
+
+/* Take the interrupts that are due, if they are not masked. This runs
+ * the simulated device handlers, the system tick, and the scheduler,
+ * and switches tasks if the scheduler decided to.
+ */
+static void deliver_interrupts(void) {
+  sim_event_t *event;
+  U64 start;
+
+  if (!sim.running || sim.irq_disabled > 0 || sim.in_irq)
+    return;
+
+  while (TRUE) {
+    if (sim.now >= sim.end)
+      sim_finish();
+
+    sim.in_irq = TRUE;
+    sim.irq_disabled++;
+
+    while (sim.events != NULL && sim.events->when <= sim.now) {
+      event = sim.events;
+      sim.events = event->next;
+      event->armed = FALSE;
+      event->fire(event);
+    }
+
+    if (sim.ticked) {
+      sim.ticked = FALSE;
+      if (!sim.scheduler_inhibit)
+        nx_systick_call_scheduler();
+    }
+
+    if (!sim.scheduler_pending) {
+      sim.irq_disabled--;
+      sim.in_irq = FALSE;
+      return;
+    }
+
+    sim.scheduler_pending = FALSE;
+    sim.next_ctx = sim.current;
+    start = host_ns();
+    sim.scheduler_cb();
+    sim.stats.sched_host_ns += host_ns() - start;
+    sim.stats.sched_calls++;
+
+    sim.irq_disabled--;
+    sim.in_irq = FALSE;
+
+    if (sim.next_ctx != sim.current)
+      switch_to(sim.next_ctx);
+  }
+}
+
+void nx_interrupts_disable(void) {
+  sim.irq_disabled++;
+}
+
+void nx_interrupts_enable(void) {
+  NX_ASSERT(sim.irq_disabled > 0);
+  if (--sim.irq_disabled == 0)
+    deliver_interrupts();
+}
+
+void sim_event_arm(sim_event_t *event, U64 when) {
+  sim_event_t **ptr;
+
+  if (event->armed) {
+    for (ptr = &sim.events; *ptr != event; ptr = &(*ptr)->next);
+    *ptr = event->next;
+  }
+
+  /* After the events due at the same time, so that they are raised in
+   * arming order.
+   */
+  for (ptr = &sim.events; *ptr != NULL && (*ptr)->when <= when;
+       ptr = &(*ptr)->next);
+  event->when = when;
+  event->armed = TRUE;
+  event->next = *ptr;
+  *ptr = event;
+}
+
+/*
+ * Virtual time.
+ */
+
+/* Move the clock to @a t, noting the ticks passed on the way. */
+static void advance_to(U64 t) {
+  if (t / 1000 != sim.now / 1000)
+    sim.ticked = TRUE;
+  sim.now = t;
+}
+
+/* Return the next time something happens after now: a tick, an
+ * event, or the end of the run.
+ */
+static U64 next_deadline(void) {
+  U64 next = (sim.now / 1000 + 1) * 1000;
+
+  if (sim.events != NULL && sim.events->when > sim.now &&
+      sim.events->when < next)
+    next = sim.events->when;
+  if (sim.end < next)
+    next = sim.end;
+  return next;
+}
+
+void sim_burn(U32 us) {
+  U64 left = us, step;
+
+  while (left > 0) {
+    step = next_deadline() - sim.now;
+    if (step > left)
+      step = left;
+    advance_to(sim.now + step);
+    left -= step;
+
+    if (sim.now >= sim.end)
+      sim_finish();
+    deliver_interrupts();
+  }
+}
+
+U64 sim_now_us(void) {
+  return sim.now;
+}
+
+U32 nx_systick_get_ms(void) {
+  return sim.now / 1000;
+}
+
+U32 nx_systick_get_us(void) {
+  return sim.now;
+}
+
+U64 nx_systick_get_us64(void) {
+  return sim.now;
+}
+
+/* Called by the idle task with interrupts disabled: skip ahead to the
+ * end of the sleep, or to the next event.
+ */
+void nx_systick_idle(U32 ms) {
+  U64 target;
+
+  if (sim.scheduler_pending || sim.ticked || ms == 0)
+    return;
+  if (sim.events != NULL && sim.events->when <= sim.now)
+    return;
+
+  /* Like the PIT on the brick, a sleep ended early by an interrupt
+   * leaves the period running until the next millisecond boundary.
+   * Coming back before then only sleeps until it.
+   */
+  if (sim.now < sim.period_end) {
+    sim.stats.idle_reentries++;
+    ms = 1;
+  }
+
+  if (ms > IDLE_MAX_MS)
+    ms = IDLE_MAX_MS;
+  target = (sim.now / 1000 + ms) * 1000;
+  if (sim.events != NULL && sim.events->when < target) {
+    target = sim.events->when;
+    if (ms > 1 && target / 1000 != sim.now / 1000) {
+      sim.stats.idle_early++;
+      sim.period_end = (target / 1000 + 1) * 1000;
+    }
+  }
+  if (sim.end < target)
+    target = sim.end;
+
+  sim.stats.idle_sleeps++;
+  advance_to(target);
+}
+
+void nx_systick_install_scheduler(nx_closure_t scheduler_cb) {
+  sim.scheduler_cb = scheduler_cb;
+}
+
+void nx_systick_call_scheduler(void) {
+  if (sim.scheduler_cb) {
+    sim.scheduler_pending = TRUE;
+    deliver_interrupts();
+  }
+}
+
+void nx_systick_mask_scheduler(void) {
+  sim.scheduler_inhibit = TRUE;
+}
+
+void nx_systick_unmask_scheduler(void) {
+  sim.scheduler_inhibit = FALSE;
+}
+
+/*
+ * The rest of the Baseplate.
+ */
+
+void nx_core_halt(void) {
+  fprintf(stderr, "halted\n");
+  exit(1);
+}
+
+nx_avr_button_t nx_avr_get_button(void) {
+  return BUTTON_NONE;
+}
+
+void nx_assert_error(const char *file, const int line,
+                     const char *expr, const char *msg) {
+  fprintf(stderr, "%s:%d: %s: %s\n", file, line, expr, msg);
+  abort();
+}
+
+void *nx_malloc(U32 size) {
+  void *ptr = malloc(size);
+
+  NX_ASSERT(ptr != NULL);
+  return ptr;
+}
+
+void *nx_calloc(U32 nelem, U32 elem_size) {
+  void *ptr = calloc(nelem, elem_size);
+
+  NX_ASSERT(ptr != NULL);
+  return ptr;
+}
+
+void nx_free(void *ptr) {
+  free(ptr);
+}
+
+void nx_tracing_add_event(nx_trace_kind_t kind __attribute__((unused)),
+                          nx_trace_track_t track __attribute__((unused)),
+                          U16 id __attribute__((unused))) {
+}
+
+void nx_tracing_add_name(nx_trace_track_t track __attribute__((unused)),
+                         U16 id __attribute__((unused)),
+                         const char *name __attribute__((unused))) {
+}
+
+/*
+ * Running.
+ */
+
+void sim_run(U64 duration_us) {
+  sim.end = sim.now + duration_us;
+  sim.stats.schedule_hash = FNV_OFFSET;
+  sim.running = TRUE;
+  mv__scheduler_run();
+
+  /* Leave the tasks frozen while the caller inspects them. */
+  sim.running = FALSE;
+}
+
+const sim_stats_t *sim_get_stats(void) {
+  return &sim.stats;
+}
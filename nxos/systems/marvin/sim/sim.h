@@ -0,0 +1,78 @@
+/** @file sim.h
+ *  @brief Host simulation of the platform under Marvin's scheduler.
+ */
+
+/* Copyright (c) 2008 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#ifndef __NXOS_MARVIN_SIM_SIM_H__
+#define __NXOS_MARVIN_SIM_SIM_H__
+
+#include "base/types.h"
+
+/* The simulation replaces task.S and the parts of the Baseplate that
+ * the scheduler uses: tasks run in ucontexts, and time is virtual. It
+ * only advances when a task burns CPU time with sim_burn(), or when
+ * the idle task sleeps until the next event. Everything else,
+ * including the scheduler itself, takes no time, so that a run only
+ * depends on the workload and its seed.
+ */
+
+/** A simulated interrupt: @a fire runs in interrupt context at the
+ * given virtual time, or as soon as interrupts are enabled after it.
+ */
+typedef struct sim_event {
+  U64 when; /**< When the interrupt is raised, in microseconds. */
+  void (*fire)(struct sim_event *event); /**< The interrupt handler. */
+  bool armed; /**< Used by the simulation. */
+  struct sim_event *next; /**< Used by the simulation. */
+} sim_event_t;
+
+/** Counters kept by the simulation. */
+typedef struct {
+  U32 sched_calls; /**< Times the scheduler callback ran. */
+  U32 switches; /**< Context switches it made. */
+  U64 sched_host_ns; /**< Host time spent in the scheduler callback. */
+  U64 switch_host_ns; /**< Host time spent switching ucontexts. */
+  U32 schedule_hash; /**< Hash of the sequence of switches. */
+  U32 idle_sleeps; /**< Times the idle task slept. */
+  U32 idle_early; /**< Sleeps ended early by an interrupt. */
+  U32 idle_reentries; /**< Sleeps started before the shortened period
+                           of an early wake ran out. */
+} sim_stats_t;
+
+/** Run Marvin's scheduler for @a duration_us of virtual time.
+ *
+ * The tasks must have been created beforehand. Returns once the time
+ * is up, with the tasks frozen in place.
+ *
+ * @param duration_us The length of the run, in microseconds.
+ */
+void sim_run(U64 duration_us);
+
+/** Return the virtual time, in microseconds since the start. */
+U64 sim_now_us(void);
+
+/** Use @a us of CPU time in the calling task.
+ *
+ * Interrupts and preemption happen while burning: the call returns
+ * once the task has actually been running for @a us.
+ */
+void sim_burn(U32 us);
+
+/** Raise @a event at virtual time @a when.
+ *
+ * @param event The event. Rearming an armed event moves it.
+ * @param when The time to raise it at, in microseconds.
+ */
+void sim_event_arm(sim_event_t *event, U64 when);
+
+/** Return the simulation's counters. */
+const sim_stats_t *sim_get_stats(void);
+
+#endif /* __NXOS_MARVIN_SIM_SIM_H__ */
@@ -0,0 +1,442 @@
+/* Copyright (c) 2008 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+/* Workload generator and report for the scheduler simulation.
+ *
+ * A workload mixes three kinds of tasks, with parameters drawn from a
+ * seeded generator:
+ *
+ *  - periodic tasks, which sleep until their next release and then
+ *    burn some CPU time, like a control loop;
+ *  - event tasks, which wait on a semaphore signalled by a simulated
+ *    interrupt, through deferred work like a driver's completion;
+ *  - CPU hogs of equal priority, which never block.
+ *
+ * Noise interrupts can be added too, which wake the idle task without
+ * making any task ready, like a motor tachometer or the USB link. The
+ * idle task then goes back to sleep before the next tick.
+ *
+ * The report gives the wake-up latency distribution of every periodic
+ * and event task, the CPU share of the hogs, and the context switch
+ * counts. All of it only depends on the command line, and is
+ * reproduced exactly by another run with the same arguments. The one
+ * exception is the HOST line, the cost of the scheduler measured on
+ * the host, which is left out of comparisons between runs.
+ *
+ * Usage: marvin-sim [-s seed] [-d duration_ms] [-p periodic]
+ *                   [-e event] [-c hogs] [-P hog_priority] [-n noise]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "base/types.h"
+#include "base/assert.h"
+#include "base/drivers/systick.h"
+
+#include "marvin/scheduler.h"
+#include "marvin/_scheduler.h"
+#include "marvin/semaphore.h"
+#include "marvin/time.h"
+
+#include "marvin/sim/sim.h"
+
+#define MAX_TASKS 16
+#define TASK_STACK_SIZE 512
+
+/* Releases of an event task not yet handled. Further ones are lost,
+ * like interrupts that come in too fast.
+ */
+#define EVENT_BACKLOG 64
+
+/* Noise interrupt sources, and the range of the time between two
+ * interrupts of a source.
+ */
+#define MAX_NOISE 4
+#define NOISE_GAP_MIN_US 300
+#define NOISE_GAP_MAX_US 5000
+
+/* Latency samples kept per task. */
+#define MAX_SAMPLES (1 << 16)
+
+typedef enum {
+  TASK_PERIODIC,
+  TASK_EVENT,
+  TASK_HOG,
+} task_kind_t;
+
+typedef struct {
+  task_kind_t kind;
+  char name[16];
+  U8 priority;
+  U32 period_ms; /* Periodic tasks: the release period. */
+  U32 gap_min_us, gap_max_us; /* Event tasks: time between interrupts. */
+  U32 burn_min_us, burn_max_us; /* CPU time used per release. */
+
+  /* Event tasks: the interrupt, the deferred work it posts, and the
+   * semaphore the work signals.
+   */
+  sim_event_t irq;
+  mv_deferred_t work;
+  mv_sem_t *sem;
+  U64 backlog[EVENT_BACKLOG];
+  U32 raised, signalled, handled;
+
+  U32 releases;
+  U32 missed; /* Releases lost to overruns or a full backlog. */
+  U32 *latency;
+  U32 n_latency;
+} task_t;
+
+static struct {
+  U32 seed;
+  U32 duration_ms;
+  U32 n_periodic, n_event, n_hog;
+  U8 hog_priority;
+  U32 n_noise;
+} config = { 1, 10000, 3, 2, 3, MV_PRIORITY_NORMAL - 1, 0 };
+
+static task_t tasks[MAX_TASKS];
+static U32 n_tasks;
+
+static sim_event_t noise[MAX_NOISE];
+static U32 noise_raised;
+
+/* The generator is shared by the workload setup and the tasks. The
+ * tasks draw from it in the order they run, which is deterministic.
+ */
+static U32 rng_state;
+
+static U32 rng_next(void) {
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 17;
+  rng_state ^= rng_state << 5;
+  rng_state &= 0xFFFFFFFF;
+  return rng_state;
+}
+
+static U32 rng_range(U32 min, U32 max) {
+  return min + rng_next() % (max - min + 1);
+}
+
+static void record_latency(task_t *t, U64 latency) {
+  if (t->n_latency < MAX_SAMPLES)
+    t->latency[t->n_latency++] = latency;
+}
+
+static void periodic_main(task_t *t) {
+  U32 next = nx_systick_get_ms() + t->period_ms;
+  U32 now;
+
+  while (1) {
+    now = nx_systick_get_ms();
+    if (next > now)
+      mv_time_sleep(next - now);
+    t->releases++;
+    record_latency(t, sim_now_us() - (U64)next * 1000);
+    sim_burn(rng_range(t->burn_min_us, t->burn_max_us));
+
+    /* Skip the releases that an overrun went past. */
+    next += t->period_ms;
+    while ((U64)next * 1000 <= sim_now_us()) {
+      next += t->period_ms;
+      t->missed++;
+    }
+  }
+}
+
+/* The simulated interrupt of an event task. */
+static void event_irq(sim_event_t *event) {
+  task_t *t = (task_t*)((U8*)event - __builtin_offsetof(task_t, irq));
+
+  if (t->raised - t->handled < EVENT_BACKLOG) {
+    t->backlog[t->raised % EVENT_BACKLOG] = sim_now_us();
+    t->raised++;
+    mv__scheduler_defer(&t->work);
+  } else {
+    t->missed++;
+  }
+
+  sim_event_arm(event, sim_now_us() +
+                rng_range(t->gap_min_us, t->gap_max_us));
+}
+
+/* Deferred work of an event task. The work is posted once however
+ * many interrupts came in before it ran, so catch up on all of them.
+ */
+static void event_work(void *arg) {
+  task_t *t = arg;
+
+  while (t->signalled != t->raised) {
+    t->signalled++;
+    mv_semaphore_inc(t->sem);
+  }
+}
+
+static void event_main(task_t *t) {
+  while (1) {
+    mv_semaphore_dec(t->sem);
+    t->releases++;
+    record_latency(t, sim_now_us() -
+                   t->backlog[t->handled % EVENT_BACKLOG]);
+    t->handled++;
+    sim_burn(rng_range(t->burn_min_us, t->burn_max_us));
+  }
+}
+
+static void noise_irq(sim_event_t *event) {
+  noise_raised++;
+  sim_event_arm(event, sim_now_us() +
+                rng_range(NOISE_GAP_MIN_US, NOISE_GAP_MAX_US));
+}
+
+static void hog_main(task_t *t) {
+  while (1)
+    sim_burn(rng_range(t->burn_min_us, t->burn_max_us));
+}
+
+static void task_main(task_t *t) {
+  switch (t->kind) {
+  case TASK_PERIODIC:
+    periodic_main(t);
+    break;
+  case TASK_EVENT:
+    event_main(t);
+    break;
+  case TASK_HOG:
+    hog_main(t);
+    break;
+  }
+}
+
+/* Task functions take no argument: give each task slot its own. */
+#define TASK_ENTRY(n) \
+  static void task_entry_##n(void) { task_main(&tasks[n]); }
+
+TASK_ENTRY(0) TASK_ENTRY(1) TASK_ENTRY(2) TASK_ENTRY(3)
+TASK_ENTRY(4) TASK_ENTRY(5) TASK_ENTRY(6) TASK_ENTRY(7)
+TASK_ENTRY(8) TASK_ENTRY(9) TASK_ENTRY(10) TASK_ENTRY(11)
+TASK_ENTRY(12) TASK_ENTRY(13) TASK_ENTRY(14) TASK_ENTRY(15)
+
+static const nx_closure_t task_entries[MAX_TASKS] = {
+  task_entry_0, task_entry_1, task_entry_2, task_entry_3,
+  task_entry_4, task_entry_5, task_entry_6, task_entry_7,
+  task_entry_8, task_entry_9, task_entry_10, task_entry_11,
+  task_entry_12, task_entry_13, task_entry_14, task_entry_15,
+};
+
+static task_t *task_add(task_kind_t kind, const char *prefix, U32 n) {
+  task_t *t = &tasks[n_tasks];
+
+  NX_ASSERT(n_tasks < MAX_TASKS);
+  t->kind = kind;
+  snprintf(t->name, sizeof(t->name), "%s%lu", prefix, n);
+  t->latency = calloc(MAX_SAMPLES, sizeof(U32));
+  NX_ASSERT(t->latency != NULL);
+  n_tasks++;
+  return t;
+}
+
+/* Draw the workload's tasks from the generator. */
+static void workload_create(void) {
+  static const U32 periods[] = { 5, 10, 20, 50, 100 };
+  task_t *t;
+  U32 i;
+
+  for (i = 0; i < config.n_periodic; i++) {
+    t = task_add(TASK_PERIODIC, "periodic", i);
+    t->priority = rng_range(MV_PRIORITY_NORMAL, MV_PRIORITY_HIGHEST);
+    t->period_ms = periods[rng_next() % (sizeof(periods) /
+                                         sizeof(periods[0]))];
+    /* Between 2% and 10% of the CPU. */
+    t->burn_min_us = t->period_ms * 20;
+    t->burn_max_us = t->period_ms * 100;
+  }
+
+  for (i = 0; i < config.n_event; i++) {
+    t = task_add(TASK_EVENT, "event", i);
+    t->priority = rng_range(MV_PRIORITY_NORMAL, MV_PRIORITY_HIGHEST);
+    t->gap_min_us = rng_range(500, 2000);
+    t->gap_max_us = t->gap_min_us * rng_range(2, 20);
+    t->burn_min_us = rng_range(20, 100);
+    t->burn_max_us = t->burn_min_us * rng_range(1, 4);
+    t->sem = mv_semaphore_create(0);
+    t->work.func = event_work;
+    t->work.arg = t;
+    t->irq.fire = event_irq;
+    sim_event_arm(&t->irq, rng_range(t->gap_min_us, t->gap_max_us));
+  }
+
+  for (i = 0; i < config.n_hog; i++) {
+    t = task_add(TASK_HOG, "hog", i);
+    t->priority = config.hog_priority;
+    t->burn_min_us = 100;
+    t->burn_max_us = 700;
+  }
+
+  for (i = 0; i < config.n_noise; i++) {
+    noise[i].fire = noise_irq;
+    sim_event_arm(&noise[i], rng_range(NOISE_GAP_MIN_US, NOISE_GAP_MAX_US));
+  }
+
+  for (i = 0; i < n_tasks; i++)
+    mv_scheduler_create_task(task_entries[i], TASK_STACK_SIZE,
+                             tasks[i].priority, tasks[i].name);
+}
+
+static int compare_u32(const void *a, const void *b) {
+  U32 x = *(const U32*)a, y = *(const U32*)b;
+
+  return (x > y) - (x < y);
+}
+
+static const char *kind_name(task_kind_t kind) {
+  switch (kind) {
+  case TASK_PERIODIC:
+    return "periodic";
+  case TASK_EVENT:
+    return "event";
+  default:
+    return "hog";
+  }
+}
+
+static void report_latency(task_t *t) {
+  U32 *s = t->latency, n = t->n_latency;
+
+  if (n == 0) {
+    printf("LATENCY name=%s samples=0\n", t->name);
+    return;
+  }
+
+  qsort(s, n, sizeof(U32), compare_u32);
+  printf("LATENCY name=%s samples=%lu min=%lu p50=%lu p90=%lu p99=%lu "
+         "max=%lu unit=us\n", t->name, n, s[0], s[n / 2],
+         s[(n * 9) / 10], s[(n * 99) / 100], s[n - 1]);
+}
+
+static void report(void) {
+  const sim_stats_t *stats = sim_get_stats();
+  mv_task_info_t info[MAX_TASKS + 1];
+  U32 n_info, i, j, switches = 0, preempted = 0;
+  double sum = 0, sum_sq = 0, share, min_share = 1, max_share = 0;
+  U32 hogs = 0;
+
+  n_info = mv_scheduler_get_tasks(info, MAX_TASKS + 1);
+  NX_ASSERT(n_info <= MAX_TASKS + 1);
+
+  printf("SIM seed=%lu duration_ms=%lu tasks=%lu\n", config.seed,
+         config.duration_ms, n_tasks);
+
+  for (i = 0; i < n_tasks; i++) {
+    task_t *t = &tasks[i];
+
+    for (j = 0; j < n_info; j++)
+      if (info[j].name == t->name)
+        break;
+    NX_ASSERT(j < n_info);
+
+    printf("TASK name=%s kind=%s prio=%u period_ms=%lu runtime_us=%lu "
+           "switches=%lu voluntary=%lu preempted=%lu releases=%lu "
+           "missed=%lu\n", t->name, kind_name(t->kind), t->priority,
+           t->period_ms, info[j].runtime_us, info[j].switches,
+           info[j].voluntary, info[j].preempted, t->releases, t->missed);
+    switches += info[j].switches;
+    preempted += info[j].preempted;
+
+    if (t->kind == TASK_HOG) {
+      share = (double)info[j].runtime_us / (config.duration_ms * 1000.0);
+      sum += share;
+      sum_sq += share * share;
+      if (share < min_share)
+        min_share = share;
+      if (share > max_share)
+        max_share = share;
+      hogs++;
+    }
+  }
+
+  for (i = 0; i < n_tasks; i++)
+    if (tasks[i].kind != TASK_HOG)
+      report_latency(&tasks[i]);
+
+  /* Jain's fairness index: 1 when the hogs got equal shares, 1/n when
+   * one of them got everything.
+   */
+  if (hogs > 0 && sum_sq > 0)
+    printf("FAIRNESS hogs=%lu jain=%.4f min_share=%.4f max_share=%.4f\n",
+           hogs, (sum * sum) / (hogs * sum_sq), min_share, max_share);
+
+  printf("SWITCHES total=%lu preempted=%lu sched_calls=%lu "
+         "hash=%08lx\n", switches, preempted, stats->sched_calls,
+         stats->schedule_hash);
+
+  printf("IDLE sleeps=%lu early=%lu reentered=%lu noise=%lu\n",
+         stats->idle_sleeps, stats->idle_early, stats->idle_reentries,
+         noise_raised);
+
+  printf("HOST sched_ns=%llu switch_ns=%llu\n",
+         stats->sched_calls ? stats->sched_host_ns / stats->sched_calls : 0,
+         stats->switches ? stats->switch_host_ns / stats->switches : 0);
+}
+
+static void usage(const char *argv0) {
+  fprintf(stderr, "usage: %s [-s seed] [-d duration_ms] [-p periodic] "
+          "[-e event] [-c hogs] [-P hog_priority] [-n noise]\n", argv0);
+  exit(2);
+}
+
+int main(int argc, char *argv[]) {
+  int opt;
+
+  while ((opt = getopt(argc, argv, "s:d:p:e:c:P:n:")) != -1) {
+    switch (opt) {
+    case 's':
+      config.seed = strtoul(optarg, NULL, 0);
+      break;
+    case 'd':
+      config.duration_ms = strtoul(optarg, NULL, 0);
+      break;
+    case 'p':
+      config.n_periodic = strtoul(optarg, NULL, 0);
+      break;
+    case 'e':
+      config.n_event = strtoul(optarg, NULL, 0);
+      break;
+    case 'c':
+      config.n_hog = strtoul(optarg, NULL, 0);
+      break;
+    case 'P':
+      config.hog_priority = strtoul(optarg, NULL, 0);
+      break;
+    case 'n':
+      config.n_noise = strtoul(optarg, NULL, 0);
+      break;
+    default:
+      usage(argv[0]);
+    }
+  }
+
+  if (config.n_periodic + config.n_event + config.n_hog == 0 ||
+      config.n_periodic + config.n_event + config.n_hog > MAX_TASKS ||
+      config.hog_priority >= MV_SCHEDULER_PRIORITIES ||
+      config.n_noise > MAX_NOISE ||
+      config.duration_ms == 0)
+    usage(argv[0]);
+
+  /* xorshift gets stuck on 0. */
+  rng_state = config.seed ? config.seed : 1;
+
+  mv__scheduler_init();
+  workload_create();
+  sim_run((U64)config.duration_ms * 1000);
+  report();
+
+  return 0;
+}
@@ -0,0 +1,220 @@
+/* Copyright (c) 2008 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#include "base/types.h"
+#include "base/assert.h"
+#include "base/display.h"
+#include "base/util.h"
+#include "base/drivers/systick.h"
+#include "base/drivers/avr.h"
+#include "base/drivers/usb.h"
+
+#include "marvin/scheduler.h"
+#include "marvin/time.h"
+
+#include "marvin/top.h"
+
+/* Magic number at the start of a dump ("MVTS"). */
+#define TOP_MAGIC 0x5354564D
+
+/* Length of the task names in a dump, and on the display. */
+#define TOP_NAME_LEN 12
+#define TOP_DISPLAY_NAME_LEN 8
+
+/* The display has room for a header and 7 tasks. */
+#define TOP_DISPLAY_TASKS 7
+
+/* The last snapshot, and the run times of the previous one, to
+ * compute CPU shares.
+ */
+static struct {
+  mv_task_info_t tasks[MV_TOP_MAX_TASKS];
+  U32 n_tasks;
+
+  struct {
+    U16 id;
+    U32 runtime_us;
+  } prev[MV_TOP_MAX_TASKS];
+  U32 n_prev;
+
+  U32 period;
+  bool show_stacks; /* Show stack usage instead of CPU shares. */
+} top_state;
+
+/* The dump sent to the USB host. */
+static struct {
+  U32 magic;
+  U32 n_tasks;
+  U32 time_us;
+  struct {
+    char name[TOP_NAME_LEN];
+    U16 id;
+    U8 priority;
+    U8 base_priority;
+    U8 running;
+    U8 blocked;
+    U16 reserved;
+    U32 runtime_us;
+    U32 switches;
+    U32 voluntary;
+    U32 preempted;
+    U32 blocked_ms;
+    U32 stack_size;
+    U32 stack_used;
+  } tasks[MV_TOP_MAX_TASKS];
+} top_dump;
+
+static void top_snapshot(void) {
+  top_state.n_tasks = mv_scheduler_get_tasks(top_state.tasks,
+                                             MV_TOP_MAX_TASKS);
+  if (top_state.n_tasks > MV_TOP_MAX_TASKS)
+    top_state.n_tasks = MV_TOP_MAX_TASKS;
+}
+
+/* Return the run time of task @a id in the previous snapshot, or 0 if
+ * it is new.
+ */
+static U32 top_prev_runtime(U16 id) {
+  U32 i;
+
+  for (i = 0; i < top_state.n_prev; i++) {
+    if (top_state.prev[i].id == id)
+      return top_state.prev[i].runtime_us;
+  }
+  return 0;
+}
+
+/* Display @a name in exactly @a len characters. */
+static void top_display_name(const char *name, U32 len) {
+  char buf[TOP_DISPLAY_NAME_LEN + 1];
+  U32 i;
+
+  NX_ASSERT(len <= TOP_DISPLAY_NAME_LEN);
+
+  if (name == NULL)
+    name = "?";
+  for (i = 0; i < len && name[i] != '\0'; i++)
+    buf[i] = name[i];
+  for (; i < len; i++)
+    buf[i] = ' ';
+  buf[len] = '\0';
+  nx_display_string(buf);
+}
+
+void mv_top_show(void) {
+  U32 delta[MV_TOP_MAX_TASKS];
+  U32 total = 0, share, i;
+  mv_task_info_t *t;
+
+  top_snapshot();
+
+  for (i = 0; i < top_state.n_tasks; i++) {
+    t = &top_state.tasks[i];
+    delta[i] = t->runtime_us - top_prev_runtime(t->id);
+    total += delta[i];
+  }
+
+  nx_display_clear();
+  nx_display_string(top_state.show_stacks ? "task    stack" : "task     cpu");
+  nx_display_end_line();
+
+  for (i = 0; i < top_state.n_tasks && i < TOP_DISPLAY_TASKS; i++) {
+    t = &top_state.tasks[i];
+
+    if (top_state.show_stacks) {
+      top_display_name(t->name, TOP_DISPLAY_NAME_LEN - 1);
+      nx_display_uint(t->stack_used);
+      nx_display_string("/");
+      nx_display_uint(t->stack_size);
+    } else {
+      share = (total >= 100) ? MIN(delta[i] / (total / 100), 100) : 0;
+
+      top_display_name(t->name, TOP_DISPLAY_NAME_LEN);
+      if (share < 100)
+        nx_display_string(" ");
+      if (share < 10)
+        nx_display_string(" ");
+      nx_display_uint(share);
+      nx_display_string("% ");
+      nx_display_string(t->running ? "*" : (t->blocked ? "B" : "R"));
+    }
+    nx_display_end_line();
+  }
+
+  for (i = 0; i < top_state.n_tasks; i++) {
+    top_state.prev[i].id = top_state.tasks[i].id;
+    top_state.prev[i].runtime_us = top_state.tasks[i].runtime_us;
+  }
+  top_state.n_prev = top_state.n_tasks;
+}
+
+void mv_top_dump(void) {
+  U32 size = sizeof(top_dump);
+  mv_task_info_t *t;
+  U32 i, j;
+
+  top_snapshot();
+
+  memset(&top_dump, 0, sizeof(top_dump));
+  top_dump.magic = TOP_MAGIC;
+  top_dump.n_tasks = top_state.n_tasks;
+  top_dump.time_us = nx_systick_get_us();
+  for (i = 0; i < top_state.n_tasks; i++) {
+    t = &top_state.tasks[i];
+    for (j = 0; t->name && j < TOP_NAME_LEN - 1 && t->name[j]; j++)
+      top_dump.tasks[i].name[j] = t->name[j];
+    top_dump.tasks[i].id = t->id;
+    top_dump.tasks[i].priority = t->priority;
+    top_dump.tasks[i].base_priority = t->base_priority;
+    top_dump.tasks[i].running = t->running;
+    top_dump.tasks[i].blocked = t->blocked;
+    top_dump.tasks[i].runtime_us = t->runtime_us;
+    top_dump.tasks[i].switches = t->switches;
+    top_dump.tasks[i].voluntary = t->voluntary;
+    top_dump.tasks[i].preempted = t->preempted;
+    top_dump.tasks[i].blocked_ms = t->blocked_ms;
+    top_dump.tasks[i].stack_size = t->stack_size;
+    top_dump.tasks[i].stack_used = t->stack_used;
+  }
+
+  nx_usb_write((U8*)&size, sizeof(size));
+  nx_usb_write((U8*)&top_dump, size);
+  nx_usb_wait_written(NX_COMPLETION_FOREVER);
+}
+
+static void top_task(void) {
+  U32 next = nx_systick_get_ms();
+  nx_avr_button_t button, prev_button = BUTTON_NONE;
+
+  while (1) {
+    /* Poll the buttons often, refresh the display every period. */
+    button = nx_avr_get_button();
+    if (button != prev_button) {
+      if (button == BUTTON_OK && nx_usb_is_connected()) {
+        mv_top_dump();
+      } else if (button == BUTTON_LEFT || button == BUTTON_RIGHT) {
+        top_state.show_stacks = !top_state.show_stacks;
+        next = nx_systick_get_ms();
+      }
+      prev_button = button;
+    }
+
+    if ((S32)(nx_systick_get_ms() - next) >= 0) {
+      mv_top_show();
+      next += top_state.period;
+    }
+
+    mv_time_sleep(50);
+  }
+}
+
+void mv_top_create_task(U32 period) {
+  NX_ASSERT(period > 0);
+  top_state.period = period;
+  mv_scheduler_create_task(top_task, 512, MV_PRIORITY_HIGHEST, "top");
+}
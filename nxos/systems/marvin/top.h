@@ -0,0 +1,49 @@
+/** @file top.h
+ *  @brief Marvin's task monitor.
+ */
+
+/* Copyright (c) 2008 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#ifndef __NXOS_MARVIN_TOP_H__
+#define __NXOS_MARVIN_TOP_H__
+
+#include "base/types.h"
+
+/** The most tasks the monitor keeps track of. */
+#define MV_TOP_MAX_TASKS 16
+
+/** Show the tasks on the display, with the share of CPU time each
+ * task used since the previous call.
+ *
+ * One line per task, up to 7 tasks: the name, the CPU share, and
+ * whether the task is running (*), ready (R) or blocked (B). In the
+ * stack view, the name, and the most stack the task used out of its
+ * stack size, in bytes.
+ */
+void mv_top_show(void);
+
+/** Send the statistics of all the tasks to the USB host.
+ *
+ * The dump is sent with the read_usb_dump.py protocol, and decoded by
+ * 'read_usb_dump.py tasks'. This blocks until the host has read it.
+ */
+void mv_top_dump(void);
+
+/** Create a task that refreshes the display every @a period
+ * milliseconds, and sends a dump to the USB host when OK is pressed.
+ * The left and right arrows switch between the CPU and stack views.
+ *
+ * The task runs at the highest priority, so that it gets to run even
+ * when other tasks hog the CPU.
+ *
+ * @param period The refresh period in milliseconds.
+ */
+void mv_top_create_task(U32 period);
+
+#endif /* __NXOS_MARVIN_TOP_H__ */
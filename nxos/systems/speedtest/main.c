@@ -1,68 +1,293 @@
+/* Copyright (c) 2008 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+/* Microbenchmarks of the Baseplate's basic operations.
+ *
+ * The results are shown on screen, and sent to the USB host if one
+ * is connected (see base/lib/bench/bench.h for the format).
+ */
+
 #include "base/types.h"
 #include "base/display.h"
 #include "base/util.h"
+#include "base/assert.h"
+#include "base/interrupts.h"
+#include "base/lock.h"
+#include "base/ring.h"
 #include "base/drivers/systick.h"
-#include "base/drivers/motors.h"
-#include "base/drivers/sensors.h"
-#include "base/drivers/radar.h"
+#include "base/drivers/buttons.h"
+#include "base/lib/bench/bench.h"
+#include "base/lib/fs/fs.h"
+#include "base/lib/memalloc/memalloc.h"
 
-S32 A = 0;
+/* memcpy of 1KiB, word aligned. */
+static U32 copy_src[256], copy_dst[256];
 
-static U32 prng_get(void) {
-  static U32 val = 42;
-  val = (val + 134289) % 1031;
-  return val;
+static void bench_memcpy(void) {
+  memcpy(copy_dst, copy_src, sizeof(copy_dst));
 }
 
-void main(void) {
-  U32 start = nx_systick_get_ms();
-  U32 end = start + 60000;
-  U32 loopcount = 1;
+static nx_bench_t memcpy_bench = {
+  "memcpy_1k", NULL, NULL, bench_memcpy, NULL, 0, 0, NULL,
+};
+
+/* Ring buffer throughput: 64 bytes written and read back in bulk, and
+ * a record the size of a trace event put and got. The ring's size
+ * isn't a multiple of either, so that the copies regularly wrap
+ * around its end.
+ */
+static nx_ring_t bench_ring;
+static U8 ring_storage[250];
+static U8 ring_data[64];
+
+static void bench_ring_setup(void) {
+  nx_ring_init(&bench_ring, ring_storage, sizeof(ring_storage));
+}
+
+static void bench_ring_bulk(void) {
+  nx_ring_write(&bench_ring, ring_data, sizeof(ring_data));
+  nx_ring_read(&bench_ring, ring_data, sizeof(ring_data));
+}
+
+static nx_bench_t ring_bulk_bench = {
+  "ring_bulk_64", bench_ring_setup, NULL, bench_ring_bulk, NULL,
+  0, 0, NULL,
+};
+
+static void bench_ring_record(void) {
+  nx_ring_put(&bench_ring, ring_data, 8);
+  nx_ring_get(&bench_ring, ring_data, 8);
+}
+
+static nx_bench_t ring_record_bench = {
+  "ring_record_8", bench_ring_setup, NULL, bench_ring_record, NULL,
+  0, 0, NULL,
+};
+
+/* Locking primitives, cheapest to most expensive. The values are
+ * volatile so that the seqlock read isn't optimized away.
+ */
+static volatile U32 lock_word;
+static volatile U32 lock_state[4];
+static nx_seqlock_t bench_seqlock = NX_SEQLOCK_INIT;
 
-  /* Initialize sensors */
-  nx_sensors_analog_enable(2);
-  nx_radar_init(3);
+static void bench_seqlock_read(void) {
+  U32 seq;
 
   do {
-    U32 light = nx_sensors_analog_get(2);
-    U32 us = nx_radar_read_distance(3, 0);
-    U32 angle = nx_motors_get_tach_count(1) % 360;
-    U32 rn = (prng_get() % 100) + 1;
-
-    nx_display_cursor_set_pos(0,0);
-
-    nx_display_uint(angle);
-    nx_display_string("     ");
-    nx_display_end_line();
-    nx_display_uint((light + us + angle)*100/rn);
-    nx_display_string("     ");
-    nx_display_end_line();
-
-    nx_motors_rotate(1, rn);
-    nx_motors_rotate(2, rn);
-
-    if (rn > 50)
-      A = MIN(A+1, 100);
-    else if (rn < 50)
-      A = MAX(A-1, -100);
-
-    if (A>=0)
-      nx_display_uint(A);
-    else
-      nx_display_uint(-A);
-    nx_display_string("     ");
-    nx_display_end_line();
-    nx_motors_rotate(0, A);
-    nx_display_uint(loopcount);
-    nx_display_string("     ");
-    loopcount++;
-  } while(nx_systick_get_ms() < end);
-
-  nx_display_end_line();
-  nx_display_string("Done!");
-  nx_motors_stop(0, TRUE);
-  nx_motors_stop(1, TRUE);
-  nx_motors_stop(2, TRUE);
-
-  nx_systick_wait_ms(10000);
+    seq = nx_seqlock_read_begin(&bench_seqlock);
+    lock_state[0];
+    lock_state[3];
+  } while (nx_seqlock_read_retry(&bench_seqlock, seq));
+}
+
+static nx_bench_t seqlock_read_bench = {
+  "seqlock_read", NULL, NULL, bench_seqlock_read, NULL, 0, 0, NULL,
+};
+
+static void bench_seqlock_write(void) {
+  nx_seqlock_write_begin(&bench_seqlock);
+  lock_state[0] = lock_word;
+  lock_state[3] = lock_word;
+  nx_seqlock_write_end(&bench_seqlock);
+}
+
+static nx_bench_t seqlock_write_bench = {
+  "seqlock_write", NULL, NULL, bench_seqlock_write, NULL, 0, 0, NULL,
+};
+
+static void bench_swap(void) {
+  nx_atomic_cas32((U32*)&lock_word, 1);
+}
+
+static nx_bench_t swap_bench = {
+  "atomic_swap", NULL, NULL, bench_swap, NULL, 0, 0, NULL,
+};
+
+static void bench_cmpxchg(void) {
+  nx_atomic_cmpxchg32(&lock_word, 1, 1);
+}
+
+static nx_bench_t cmpxchg_bench = {
+  "atomic_cmpxchg", NULL, NULL, bench_cmpxchg, NULL, 0, 0, NULL,
+};
+
+static void bench_add(void) {
+  nx_atomic_add32(&lock_word, 1);
+}
+
+static nx_bench_t add_bench = {
+  "atomic_add", NULL, NULL, bench_add, NULL, 0, 0, NULL,
+};
+
+static void bench_critical(void) {
+  nx_critical_exit(nx_critical_enter());
+}
+
+static nx_bench_t critical_bench = {
+  "critical_section", NULL, NULL, bench_critical, NULL, 0, 0, NULL,
+};
+
+static void bench_interrupts(void) {
+  nx_interrupts_disable();
+  nx_interrupts_enable();
+}
+
+static nx_bench_t interrupts_bench = {
+  "interrupts_disable", NULL, NULL, bench_interrupts, NULL, 0, 0, NULL,
+};
+
+/* Drawing a full line of text into the display buffer. The LCD
+ * itself is refreshed asynchronously, and isn't measured.
+ */
+static void bench_display(void) {
+  nx_display_cursor_set_pos(0, 7);
+  nx_display_string("0123456789abcdef");
+}
+
+static void bench_display_teardown(void) {
+  nx_display_cursor_set_pos(0, 7);
+  nx_display_string("                ");
+}
+
+static nx_bench_t display_bench = {
+  "display_string", NULL, bench_display_teardown, bench_display, NULL,
+  0, 0, NULL,
+};
+
+/* nx_malloc/nx_free of a small block. */
+static void bench_malloc_setup(void) {
+  nx_memalloc_init();
+}
+
+static void bench_malloc(void) {
+  nx_free(nx_malloc(64));
+}
+
+static void bench_malloc_teardown(void) {
+  nx_memalloc_destroy();
+}
+
+static nx_bench_t malloc_bench = {
+  "malloc_free_64", bench_malloc_setup, bench_malloc_teardown,
+  bench_malloc, NULL, 0, 0, NULL,
+};
+
+/* File system read and write of one flash page. Every write burns a
+ * flash page, so the write benchmark is kept short.
+ */
+static fs_fd_t bench_fd;
+
+static void bench_fs_write_setup(void) {
+  fs_err_t err = nx_fs_open("bench_w", FS_FILE_MODE_CREATE, &bench_fd);
+
+  NX_ASSERT(err == FS_ERR_NO_ERROR);
+}
+
+static void bench_fs_write(void) {
+  U32 i;
+
+  for (i = 0; i < EFC_PAGE_BYTES; i++)
+    nx_fs_write(bench_fd, (U8)i);
+  nx_fs_flush(bench_fd);
+}
+
+static void bench_fs_teardown(void) {
+  nx_fs_unlink(bench_fd);
+}
+
+static nx_bench_t fs_write_bench = {
+  "fs_write_page", bench_fs_write_setup, bench_fs_teardown,
+  bench_fs_write, NULL, 1, 7, NULL,
+};
+
+static void bench_fs_read_setup(void) {
+  U32 i;
+  fs_err_t err = nx_fs_open("bench_r", FS_FILE_MODE_CREATE, &bench_fd);
+
+  NX_ASSERT(err == FS_ERR_NO_ERROR);
+  for (i = 0; i < EFC_PAGE_BYTES; i++)
+    nx_fs_write(bench_fd, (U8)i);
+  nx_fs_flush(bench_fd);
+}
+
+static void bench_fs_read(void) {
+  U32 i;
+  U8 byte;
+
+  nx_fs_seek(bench_fd, 0);
+  for (i = 0; i < EFC_PAGE_BYTES; i++)
+    nx_fs_read(bench_fd, &byte);
+}
+
+static nx_bench_t fs_read_bench = {
+  "fs_read_page", bench_fs_read_setup, bench_fs_teardown,
+  bench_fs_read, NULL, 0, 0, NULL,
+};
+
+/* Round trip through the scheduler interrupt: the fixed cost of
+ * every preemptive context switch, without the scheduler's own
+ * decision making.
+ */
+static volatile bool sched_ran;
+
+static void bench_sched_cb(void) {
+  sched_ran = TRUE;
+}
+
+static void bench_sched_setup(void) {
+  nx_systick_install_scheduler(bench_sched_cb);
+}
+
+static U32 bench_sched(U32 iterations) {
+  U32 start = nx_bench_get_ticks();
+  U32 i;
+
+  for (i = 0; i < iterations; i++) {
+    sched_ran = FALSE;
+    nx_systick_call_scheduler();
+    while (!sched_ran);
+  }
+
+  return nx_bench_get_ticks() - start;
+}
+
+static void bench_sched_teardown(void) {
+  nx_systick_install_scheduler(NULL);
+}
+
+static nx_bench_t sched_bench = {
+  "sched_irq", bench_sched_setup, bench_sched_teardown, NULL, bench_sched,
+  0, 0, NULL,
+};
+
+void main(void) {
+  nx_bench_register(&memcpy_bench);
+  nx_bench_register(&ring_bulk_bench);
+  nx_bench_register(&ring_record_bench);
+  nx_bench_register(&seqlock_read_bench);
+  nx_bench_register(&seqlock_write_bench);
+  nx_bench_register(&swap_bench);
+  nx_bench_register(&cmpxchg_bench);
+  nx_bench_register(&add_bench);
+  nx_bench_register(&critical_bench);
+  nx_bench_register(&interrupts_bench);
+  nx_bench_register(&display_bench);
+  nx_bench_register(&malloc_bench);
+  nx_bench_register(&sched_bench);
+
+  if (nx_fs_init() == FS_ERR_NO_ERROR) {
+    nx_bench_register(&fs_read_bench);
+    nx_bench_register(&fs_write_bench);
+  }
+
+  nx_bench_run_all();
+
+  nx_buttons_flush();
+  nx_buttons_wait_press(BUTTON_CANCEL);
 }
@@ -16,20 +16,18 @@
 
 #include "main.h"
 
+/* How long to wait for a line from the host, in milliseconds. */
+#define USB_READ_TIMEOUT 2000
+
 static void usb_readline(U8 *buf) {
   size_t len;
-  int i = 0;
 
   nx_usb_read(buf, RCMD_BUF_LEN*sizeof(char));
-  for (i=0; i<10 && !nx_usb_data_read(); i++) {
-    nx_systick_wait_ms(200);
-  }
-
-  if (i >= 10) {
+  len = nx_usb_wait_read(USB_READ_TIMEOUT);
+  if (len == 0) {
     return;
   }
 
-  len = nx_usb_data_read();
   if (len+1 < RCMD_BUF_LEN) {
     buf[len+1] = '\0';
   } else {
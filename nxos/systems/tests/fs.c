@@ -11,7 +11,7 @@
 #include "base/assert.h"
 #include "base/display.h"
 #include "base/util.h"
-#include "base/drivers/avr.h"
+#include "base/drivers/buttons.h"
 #include "base/drivers/_efc.h"
 #include "base/drivers/systick.h"
 #include "base/lib/fs/fs.h"
@@ -25,6 +25,12 @@ union U32tochar {
   char chars[32];
 };
 
+/* Wait for a fresh press on OK, to step through a test. */
+static void wait_ok(void) {
+  nx_buttons_flush();
+  nx_buttons_wait_press(BUTTON_OK);
+}
+
 static bool spawn_file(char *filename, size_t bytes) {
   fs_err_t err;
   fs_fd_t fd;
@@ -75,7 +81,7 @@ void fs_test_dump(void) {
   spawn_file("test3", 200);
 
   nx_fs_dump();
-  while (nx_avr_get_button() != BUTTON_OK);
+  wait_ok();
   destroy();
 }
 
@@ -111,8 +117,7 @@ void fs_test_defrag_empty(void) {
   nx_display_string("done.\n");
 
   nx_fs_dump();
-  while (nx_avr_get_button() != BUTTON_OK);
-  nx_systick_wait_ms(500);
+  wait_ok();
 
   destroy();
 }
@@ -132,20 +137,17 @@ void fs_test_defrag_simple(void) {
   remove_file("test4");
 
   nx_fs_dump();
-  while (nx_avr_get_button() != BUTTON_OK);
-  nx_systick_wait_ms(500);
+  wait_ok();
 
   nx_display_clear();
   nx_display_string("Defrag: ");
   nx_fs_defrag_simple();
   nx_display_string("done.\n");
-  while (nx_avr_get_button() != BUTTON_OK);
-  nx_systick_wait_ms(500);
+  wait_ok();
 
   nx_display_clear();
   nx_fs_dump();
-  while (nx_avr_get_button() != BUTTON_OK);
-  nx_systick_wait_ms(500);
+  wait_ok();
 
   destroy();
 }
@@ -178,20 +180,17 @@ void fs_test_defrag_for_file(void) {
   spawn_file_at("test42", 1020, 42);
 
   nx_fs_dump();
-  while (nx_avr_get_button() != BUTTON_OK);
-  nx_systick_wait_ms(500);
+  wait_ok();
 
   nx_display_clear();
   nx_display_string("Defrag: ");
   nx_display_uint(nx_fs_defrag_for_file_by_name("test1"));
   nx_display_string(" done.\n");
-  while (nx_avr_get_button() != BUTTON_OK);
-  nx_systick_wait_ms(500);
+  wait_ok();
 
   nx_display_clear();
   nx_fs_dump();
-  while (nx_avr_get_button() != BUTTON_OK);
-  nx_systick_wait_ms(500);
+  wait_ok();
 
   destroy();
 }
@@ -209,8 +208,7 @@ void fs_test_defrag_best_overall(void) {
   remove_file("test4");
 
   nx_fs_dump();
-  while (nx_avr_get_button() != BUTTON_OK);
-  nx_systick_wait_ms(500);
+  wait_ok();
 
   nx_display_clear();
   nx_display_string("Defrag: ");
@@ -221,13 +219,11 @@ void fs_test_defrag_best_overall(void) {
   }
   nx_display_end_line();
 
-  while (nx_avr_get_button() != BUTTON_OK);
-  nx_systick_wait_ms(500);
+  wait_ok();
 
   nx_display_clear();
   nx_fs_dump();
-  while (nx_avr_get_button() != BUTTON_OK);
-  nx_systick_wait_ms(500);
+  wait_ok();
 
   destroy();
 }
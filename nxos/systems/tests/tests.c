@@ -18,11 +18,14 @@
 #include "base/drivers/systick.h"
 /* TODO: evil, decide if necessary. */
 #include "base/drivers/_avr.h"
+#include "base/drivers/buttons.h"
 #include "base/drivers/sound.h"
 #include "base/drivers/sensors.h"
+#include "base/drivers/sampler.h"
 #include "base/drivers/motors.h"
 #include "base/drivers/usb.h"
 #include "base/drivers/radar.h"
+#include "base/drivers/i2c.h"
 #include "base/drivers/bt.h"
 #include "base/drivers/_uart.h"
 
@@ -288,32 +291,44 @@ void tests_tachy(void) {
 void tests_sensors(void) {
   U32 i, sensor;
   const U32 display_seconds = 15;
+  nx_sample_t samples[NXT_N_SENSORS][4];
+  nx_sample_t sample;
   hello();
 
+  /* Average the readings over each refresh of the display, and show
+   * their range.
+   */
   for (sensor=0; sensor<NXT_N_SENSORS; sensor++) {
     nx_sensors_analog_enable(sensor);
+    nx_sampler_start(sensor, 4, NX_SAMPLER_AVERAGE, samples[sensor], 4);
   }
 
   for (i=0; i<(display_seconds*4); i++) {
+    nx_sampler_wait(NXT_N_SENSORS - 1, 1, 500);
+
     nx_display_clear();
     nx_display_cursor_set_pos(0,0);
     nx_display_string("- Sensor  info -\n"
 		      "----------------\n");
 
     for (sensor=0; sensor<NXT_N_SENSORS; sensor++){
-      nx_display_string("Port ");
+      nx_display_string("P");
       nx_display_uint(sensor);
-      nx_display_string(": ");
-
-
-      nx_display_uint(nx_sensors_analog_get(sensor));
+      nx_display_string(" ");
+
+      if (nx_sampler_read(sensor, &sample, 1) == 1) {
+        nx_display_uint(sample.value);
+        nx_display_string(" ");
+        nx_display_uint(sample.min);
+        nx_display_string("-");
+        nx_display_uint(sample.max);
+      }
       nx_display_end_line();
     }
-
-    nx_systick_wait_ms(250);
   }
 
   for (sensor=0; sensor<NXT_N_SENSORS; sensor++) {
+    nx_sampler_stop(sensor);
     nx_sensors_analog_disable(sensor);
   }
 
@@ -369,6 +384,58 @@ void tests_sysinfo(void) {
   goodbye();
 }
 
+void tests_avr_link(void) {
+  U32 i;
+  const U32 display_seconds = 15;
+  nx_avr_link_stats_t stats;
+  hello();
+
+  nx_avr_reset_link_stats();
+
+  for (i=0; i<(display_seconds*4); i++) {
+    nx_avr_get_link_stats(&stats);
+
+    nx_display_clear();
+    nx_display_cursor_set_pos(0,0);
+    nx_display_string("--- AVR link ---\n");
+
+    nx_display_string("Frames: ");
+    nx_display_uint(stats.frames);
+    nx_display_end_line();
+
+    nx_display_string("Per sec: ");
+    nx_display_uint(stats.frames_per_sec);
+    nx_display_end_line();
+
+    nx_display_string("Bad sums: ");
+    nx_display_uint(stats.checksum_failures);
+    nx_display_end_line();
+
+    nx_display_string("TWI err: ");
+    nx_display_uint(stats.twi_errors);
+    nx_display_end_line();
+
+    nx_display_string("Resyncs: ");
+    nx_display_uint(stats.resyncs);
+    nx_display_end_line();
+
+    nx_display_string("Resets: ");
+    nx_display_uint(stats.resets);
+    nx_display_end_line();
+
+    nx_display_string("Lat: ");
+    nx_display_uint(stats.latency_us);
+    nx_display_string("/");
+    nx_display_uint(stats.max_latency_us);
+    nx_display_string("us");
+    nx_display_end_line();
+
+    nx_systick_wait_ms(250);
+  }
+
+  goodbye();
+}
+
 
 
 static void tests_bt_list_known_devices(void) {
@@ -532,12 +599,16 @@ static int tests_command(char *buffer) {
     tests_display();
   else if (streq(buffer, "sysinfo"))
     tests_sysinfo();
+  else if (streq(buffer, "avrlink"))
+    tests_avr_link();
   else if (streq(buffer, "sensors"))
     tests_sensors();
   else if (streq(buffer, "tachy"))
     tests_tachy();
   else if (streq(buffer, "radar"))
     tests_radar();
+  else if (streq(buffer, "i2c"))
+    tests_i2c();
   else if (streq(buffer, "bt"))
     tests_bt();
   else if (streq(buffer, "bt2"))
@@ -725,18 +796,12 @@ void tests_usb(void) {
 
     nx_usb_read((U8 *)&buffer, NX_USB_PACKET_SIZE * sizeof(char));
 
-    for (i = 0 ; i < 500 && !nx_usb_data_read(); i++)
-    {
-      nx_systick_wait_ms(200);
-    }
-
-    if (i >= 500)
+    lng = nx_usb_wait_read(100000);
+    if (lng == 0)
       break;
 
     nx_display_clear();
 
-    lng = nx_usb_data_read();
-
     if ((lng+1) < NX_USB_PACKET_SIZE)
       buffer[lng+1] = '\0';
     else
@@ -807,6 +872,7 @@ void tests_radar(void) {
   U32 sensor = 0;
   U8 interval, reading;
   S8 object;
+  nx_buttons_event_t event;
 
   hello();
 
@@ -829,9 +895,10 @@ void tests_radar(void) {
   nx_radar_info(sensor);
   interval = nx_radar_read_value(sensor, RADAR_INTERVAL);
 
-  while (nx_avr_get_button() != BUTTON_OK);
+  nx_buttons_flush();
+  nx_buttons_wait_press(BUTTON_OK);
 
-  while (nx_avr_get_button() != BUTTON_RIGHT) {
+  while (TRUE) {
     nx_display_clear();
     nx_display_cursor_set_pos(0, 0);
 
@@ -849,13 +916,97 @@ void tests_radar(void) {
       }
     }
 
-    nx_systick_wait_ms((interval > 0) ? interval * 500 : 1000);
+    /* Refresh at the radar's interval, until a press on right. */
+    if (nx_buttons_wait_event(&event, (interval > 0) ? interval * 500 : 1000)
+        && event.type == NX_BUTTON_PRESS && event.button == BUTTON_RIGHT)
+      break;
   }
 
   nx_radar_close(sensor);
   goodbye();
 }
 
+/* Two requests in flight per port: while one is on the bus, the next
+ * one is already queued behind it.
+ */
+#define I2C_TEST_DEPTH 2
+#define I2C_TEST_MS 5000
+
+void tests_i2c(void) {
+  nx_i2c_request_t reqs[NXT_N_SENSORS][I2C_TEST_DEPTH];
+  U8 readings[NXT_N_SENSORS][I2C_TEST_DEPTH];
+  U8 cmd = 0x42; /* The radar's first reading. */
+  U32 start[NXT_N_SENSORS], done[NXT_N_SENSORS], failed[NXT_N_SENSORS];
+  U32 sensor, i, begin, end, total = 0;
+
+  hello();
+
+  nx_display_clear();
+  nx_display_cursor_set_pos(0, 0);
+  nx_display_string("I2C throughput\n");
+
+  memset(reqs, 0, sizeof(reqs));
+  for (sensor=0; sensor<NXT_N_SENSORS; sensor++) {
+    nx_radar_init(sensor);
+    failed[sensor] = 0;
+
+    for (i=0; i<I2C_TEST_DEPTH; i++) {
+      reqs[sensor][i].mode = TXN_MODE_READ;
+      reqs[sensor][i].data = &cmd;
+      reqs[sensor][i].data_size = 1;
+      reqs[sensor][i].recv_buf = &readings[sensor][i];
+      reqs[sensor][i].recv_size = 1;
+      nx_i2c_submit(sensor, &reqs[sensor][i]);
+    }
+  }
+
+  /* Take the requests back in order, and resubmit them at once. */
+  begin = nx_systick_get_ms();
+  for (sensor=0; sensor<NXT_N_SENSORS; sensor++)
+    start[sensor] = nx_i2c_get_completed(sensor);
+  end = begin + I2C_TEST_MS;
+  i = 0;
+  while (nx_systick_get_ms() < end) {
+    for (sensor=0; sensor<NXT_N_SENSORS; sensor++) {
+      if (nx_i2c_request_wait(&reqs[sensor][i], NX_COMPLETION_FOREVER)
+          != TXN_STAT_SUCCESS)
+        failed[sensor]++;
+      nx_i2c_submit(sensor, &reqs[sensor][i]);
+    }
+    i = (i + 1) % I2C_TEST_DEPTH;
+  }
+
+  /* Count what completed within the run, not the requests drained
+   * after it.
+   */
+  for (sensor=0; sensor<NXT_N_SENSORS; sensor++)
+    done[sensor] = nx_i2c_get_completed(sensor) - start[sensor];
+  end = nx_systick_get_ms();
+
+  for (sensor=0; sensor<NXT_N_SENSORS; sensor++) {
+    for (i=0; i<I2C_TEST_DEPTH; i++)
+      nx_i2c_request_wait(&reqs[sensor][i], NX_COMPLETION_FOREVER);
+
+    nx_display_string("Port ");
+    nx_display_uint(sensor + 1);
+    nx_display_string(": ");
+    nx_display_uint(done[sensor]);
+    nx_display_string("/");
+    nx_display_uint(failed[sensor]);
+    nx_display_end_line();
+
+    total += done[sensor];
+    nx_radar_close(sensor);
+  }
+
+  nx_display_string("Txn/s: ");
+  nx_display_uint(total * 1000 / (end - begin));
+  nx_display_end_line();
+
+  nx_systick_wait_ms(5000);
+  goodbye();
+}
+
 void tests_fs(void) {
   hello();
   fs_test_infos();
@@ -883,6 +1034,7 @@ void tests_all(void) {
   tests_tachy();
   tests_sensors();
   tests_sysinfo();
+  tests_avr_link();
   tests_radar();
   tests_fs();
 
@@ -17,11 +17,13 @@ void tests_motor(void);
 void tests_sound(void);
 void tests_display(void);
 void tests_sysinfo(void);
+void tests_avr_link(void);
 void tests_sensors(void);
 void tests_tachy(void);
 void tests_usb(void);
 void tests_usb_hardcore(void);
 void tests_radar(void);
+void tests_i2c(void);
 void tests_bt(void);
 void tests_bt2(void);
 void tests_fs(void);
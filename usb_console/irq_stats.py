@@ -0,0 +1,54 @@
+#!/usr/bin/env python
+
+# Interrupt statistics beautifier, for dumps sent by nx_irqstats_dump()
+# (see base/lib/irqstats/irqstats.h).
+import struct
+
+VECTOR_NAMES = {
+    1: "SYS (systick)",
+    2: "PIOA (tachos)",
+    4: "ADC",
+    5: "SPI (LCD)",
+    6: "US0",
+    7: "US1 (bluetooth)",
+    8: "SSC (sound)",
+    9: "TWI (AVR link)",
+    10: "PWMC (scheduler)",
+    11: "UDP (USB)",
+    12: "TC0 (I2C)",
+    13: "TC1",
+    14: "TC2 (work queue)",
+}
+
+def beautify(data, size):
+    raw = struct.pack("%dB" % size, *data)
+    magic, n_vectors, n_buckets, max_depth = struct.unpack_from("<4L", raw)
+    if magic != 0x5349584E:
+        print("Not an interrupt statistics dump")
+        return
+    vector = struct.Struct("<7L%dH" % n_buckets)
+
+    print("Maximum nesting depth: %d" % max_depth)
+    print("")
+    print("%-18s %8s %9s %9s %9s %7s %7s %9s" %
+          ("vector", "count", "min(us)", "avg(us)", "max(us)",
+           "nested", "preempt", "lat(us)"))
+    histograms = []
+    for i in range(n_vectors):
+        fields = vector.unpack_from(raw, 16 + i * vector.size)
+        count, min_ns, avg_ns, max_ns, nested, preempted, latency = fields[:7]
+        if not count:
+            continue
+        name = VECTOR_NAMES.get(i, "vector %d" % i)
+        print("%-18s %8d %9.2f %9.2f %9.2f %7d %7d %9.2f" %
+              (name, count, min_ns / 1000.0, avg_ns / 1000.0,
+               max_ns / 1000.0, nested, preempted, latency / 1000.0))
+        histograms.append((name, fields[7:]))
+
+    print("")
+    print("Duration histograms (microseconds):")
+    labels = ["<1"] + ["<%d" % (1 << b) for b in range(1, n_buckets - 1)] + \
+        [">=%d" % (1 << (n_buckets - 2))]
+    print("%-18s %s" % ("", " ".join("%6s" % l for l in labels)))
+    for name, hist in histograms:
+        print("%-18s %s" % (name, " ".join("%6d" % h for h in hist)))
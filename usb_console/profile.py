@@ -0,0 +1,200 @@
+#!/usr/bin/env python
+
+# Receive a profile from the brick's sampling profiler (see
+# base/lib/profiler/profiler.h), symbolize it against the application
+# kernel's ELF file, and print a flat profile and a call-site table.
+#
+# The profile is sent by nx_profiler_dump(), using the same protocol
+# as read_usb_dump.py: a U32 data size, followed by the data.
+#
+# Usage: profile.py [options] kernel.elf
+
+import optparse
+import struct
+import subprocess
+import sys
+
+NXOS_INTERFACE = 0
+
+PROFILE_MAGIC = 0x4650584E
+HEADER = struct.Struct("<11L")
+CALLSITE = struct.Struct("<LL")
+
+
+def read_brick():
+    from nxt.lowlevel import get_device
+
+    sys.stderr.write("Looking for NXT... ")
+    brick = get_device(0x0694, 0xFF00, timeout=60)
+    if not brick:
+        sys.stderr.write("not found!\n")
+        sys.exit(1)
+    brick.open(NXOS_INTERFACE)
+    sys.stderr.write("ok. Waiting for profile... ")
+
+    read_size = brick.read(4, 60000)
+    if not read_size:
+        sys.stderr.write("timeout!\n")
+        sys.exit(1)
+    size = struct.unpack("<L", read_size)[0]
+    data = brick.read(size, 10000)
+    if not data or len(data) != size:
+        sys.stderr.write("short read!\n")
+        sys.exit(1)
+    if not isinstance(data, bytes):
+        data = bytes(bytearray(ord(c) for c in data))
+    sys.stderr.write("ok, %d bytes.\n" % size)
+    brick.close()
+    return data
+
+
+class Symbols(object):
+    """Function lookup in an ELF file, using the toolchain's nm and
+    addr2line."""
+
+    def __init__(self, elf, prefix):
+        self.elf = elf
+        self.prefix = prefix
+        out = subprocess.Popen([prefix + "nm", "-n", "--defined-only", elf],
+                               stdout=subprocess.PIPE).communicate()[0]
+        self.syms = []
+        for line in out.decode("ascii", "replace").splitlines():
+            fields = line.split()
+            if len(fields) != 3 or fields[1] not in "TtWw":
+                continue
+            # Skip ARM mapping symbols ($a, $t, $d).
+            if fields[2].startswith("$"):
+                continue
+            self.syms.append((int(fields[0], 16), fields[2]))
+        self.addrs = [a for a, n in self.syms]
+
+    def function(self, addr):
+        import bisect
+        i = bisect.bisect_right(self.addrs, addr) - 1
+        if i < 0:
+            return "0x%08x" % addr
+        return self.syms[i][1]
+
+    def lines(self, addrs):
+        if not addrs:
+            return {}
+        proc = subprocess.Popen([self.prefix + "addr2line", "-f", "-s",
+                                 "-e", self.elf] +
+                                ["0x%x" % a for a in addrs],
+                                stdout=subprocess.PIPE)
+        out = proc.communicate()[0].decode("ascii", "replace").splitlines()
+        result = {}
+        for i, a in enumerate(addrs):
+            func, where = out[2 * i:2 * i + 2]
+            if func == "??":
+                func = self.function(a)
+            result[a] = "%s (%s)" % (func, where)
+        return result
+
+
+def parse(data):
+    (magic, samples, samples_task, samples_unknown, callsites_lost, shift,
+     text_start, text_buckets, ramtext_start, ramtext_buckets,
+     n_callsites) = HEADER.unpack_from(data, 0)
+    if magic != PROFILE_MAGIC:
+        sys.stderr.write("Not a profile (bad magic 0x%08x)\n" % magic)
+        sys.exit(1)
+
+    off = HEADER.size
+    callsites = []
+    for i in range(n_callsites):
+        addr, count = CALLSITE.unpack_from(data, off)
+        off += CALLSITE.size
+        if count:
+            callsites.append((count, addr))
+
+    n = text_buckets + ramtext_buckets
+    counts = struct.unpack_from("<%dH" % n, data, off)
+    buckets = []
+    for i, count in enumerate(counts):
+        if not count:
+            continue
+        if i < text_buckets:
+            addr = text_start + (i << shift)
+        else:
+            addr = ramtext_start + ((i - text_buckets) << shift)
+        buckets.append((addr, count))
+
+    return {
+        "samples": samples,
+        "samples_task": samples_task,
+        "samples_unknown": samples_unknown,
+        "callsites_lost": callsites_lost,
+        "bucket_size": 1 << shift,
+        "buckets": buckets,
+        "callsites": callsites,
+    }
+
+
+def report(profile, syms, limit):
+    total = max(profile["samples"], 1)
+
+    print("%d samples (%.1f%% in tasks, %d outside of the kernel), "
+          "%d bytes per bucket" % (profile["samples"],
+                                   100.0 * profile["samples_task"] / total,
+                                   profile["samples_unknown"],
+                                   profile["bucket_size"]))
+    print("")
+
+    functions = {}
+    for addr, count in profile["buckets"]:
+        name = syms.function(addr)
+        functions[name] = functions.get(name, 0) + count
+
+    print("Flat profile:")
+    print("")
+    print("  %self  cumul%  samples  function")
+    cumul = 0
+    flat = sorted(functions.items(), key=lambda x: -x[1])
+    for name, count in flat[:limit]:
+        cumul += count
+        print("%7.2f %7.2f %8d  %s" % (100.0 * count / total,
+                                       100.0 * cumul / total, count, name))
+    print("")
+
+    # The sampled link register points after the call instruction.
+    callsites = sorted(profile["callsites"], reverse=True)[:limit]
+    where = syms.lines([addr - 4 for count, addr in callsites])
+    print("Call sites (sampled return addresses):")
+    print("")
+    print("      %  samples  caller")
+    for count, addr in callsites:
+        print("%7.2f %8d  %s" % (100.0 * count / total, count,
+                                 where[addr - 4]))
+    if profile["callsites_lost"]:
+        print("(%d samples did not fit in the call-site table)" %
+              profile["callsites_lost"])
+
+
+def main():
+    parser = optparse.OptionParser(usage="%prog [options] kernel.elf")
+    parser.add_option("-i", "--input",
+                      help="read a saved profile instead of waiting for "
+                      "the brick")
+    parser.add_option("-r", "--raw",
+                      help="save the received profile to this file")
+    parser.add_option("-n", "--limit", type="int", default=30,
+                      help="number of entries to show (default: %default)")
+    parser.add_option("-p", "--prefix", default="arm-elf-",
+                      help="toolchain prefix (default: %default)")
+    options, args = parser.parse_args()
+    if len(args) != 1:
+        parser.error("the kernel ELF file is required")
+
+    if options.input:
+        data = open(options.input, "rb").read()
+    else:
+        data = read_brick()
+        if options.raw:
+            open(options.raw, "wb").write(data)
+
+    report(parse(data), Symbols(args[0], options.prefix), options.limit)
+
+
+if __name__ == "__main__":
+    main()
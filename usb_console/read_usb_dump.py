@@ -51,6 +51,12 @@ def main():
       elif sys.argv[1] == 'ascii':
         from ascii_dump import beautify
         beautify(data, size)
+      elif sys.argv[1] == 'irq':
+        from irq_stats import beautify
+        beautify(data, size)
+      elif sys.argv[1] == 'tasks':
+        from task_stats import beautify
+        beautify(data, size)
       else:
         print [ str(i) for i in data ]
 
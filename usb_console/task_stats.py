@@ -0,0 +1,35 @@
+#!/usr/bin/env python
+
+# Marvin task statistics beautifier, for dumps sent by mv_top_dump()
+# (see nxos/systems/marvin/top.h).
+import struct
+
+def beautify(data, size):
+    raw = struct.pack("%dB" % size, *data)
+    magic, n_tasks, time_us = struct.unpack_from("<3L", raw)
+    if magic != 0x5354564D:
+        print("Not a task statistics dump")
+        return
+    task = struct.Struct("<12sH4BH7L")
+
+    tasks = []
+    for i in range(n_tasks):
+        tasks.append(task.unpack_from(raw, 12 + i * task.size))
+    total = sum(t[7] for t in tasks) or 1
+
+    print("Time: %.3fs" % (time_us / 1000000.0))
+    print("")
+    print("%3s %-12s %4s %5s %12s %6s %8s %8s %8s %11s %11s" %
+          ("id", "name", "prio", "state", "run(us)", "cpu%",
+           "switches", "volunt", "preempt", "blocked(ms)", "stack"))
+    for (name, id, prio, base_prio, running, blocked, _,
+         runtime, switches, voluntary, preempted, blocked_ms,
+         stack_size, stack_used) in tasks:
+        name = name.split(b"\0")[0].decode("ascii", "replace") or "?"
+        if prio != base_prio:
+            prio = "%d/%d" % (prio, base_prio)
+        state = running and "run" or (blocked and "block" or "ready")
+        print("%3d %-12s %4s %5s %12d %6.1f %8d %8d %8d %11d %11s" %
+              (id, name, prio, state, runtime, 100.0 * runtime / total,
+               switches, voluntary, preempted, blocked_ms,
+               "%d/%d" % (stack_used, stack_size)))
@@ -0,0 +1,194 @@
+#!/usr/bin/env python
+
+# Receive a live event trace from the brick, and convert it into a
+# Chrome trace event file, which can be loaded into Perfetto
+# (ui.perfetto.dev) or chrome://tracing.
+#
+# The brick streams fixed size records (see nx_trace_event_t in
+# base/lib/tracing/tracing.h), one after the other:
+#
+#   U32 time (microseconds, or payload), U8 kind, U8 track, U16 id
+#
+# all little-endian. The stream starts with a SYNC record. Stop the
+# capture with ^C; the timeline is written out when the capture ends.
+#
+# The raw stream can also be saved (-r) and converted later (-i).
+
+import json
+import optparse
+import struct
+import sys
+
+NXOS_INTERFACE = 0
+
+RECORD = struct.Struct("<LBBH")
+
+KIND_BEGIN, KIND_END, KIND_INSTANT, KIND_NAME, KIND_DROPPED, KIND_SYNC = \
+    range(1, 7)
+SYNC_MAGIC = 0x5254584E
+
+TRACKS = ["IRQ", "Tasks", "Drivers", "User"]
+TRACK_IRQ, TRACK_TASK, TRACK_DRIVER, TRACK_USER = range(4)
+
+# Default names of entities, until the brick names them itself.
+DEFAULT_NAMES = {
+    TRACK_IRQ: {
+        1: "SYS (systick)",
+        2: "PIOA",
+        4: "ADC",
+        5: "SPI",
+        6: "US0",
+        7: "US1 (bluetooth)",
+        8: "SSC (sound)",
+        9: "TWI (AVR link)",
+        10: "PWMC (scheduler)",
+        11: "UDP (USB)",
+        12: "TC0 (I2C)",
+        13: "TC1",
+        14: "TC2",
+    },
+    TRACK_DRIVER: {
+        0: "AVR link",
+        1: "I2C port 1",
+        2: "I2C port 2",
+        3: "I2C port 3",
+        4: "I2C port 4",
+    },
+}
+
+
+def read_brick(raw_out):
+    from nxt.lowlevel import get_device
+
+    sys.stderr.write("Looking for NXT... ")
+    brick = get_device(0x0694, 0xFF00, timeout=60)
+    if not brick:
+        sys.stderr.write("not found!\n")
+        sys.exit(1)
+    brick.open(NXOS_INTERFACE)
+    sys.stderr.write("ok. Capturing, ^C to stop.\n")
+
+    data = b""
+    try:
+        while True:
+            chunk = brick.read(4096, 1000)
+            if not chunk:
+                continue
+            if not isinstance(chunk, bytes):
+                chunk = bytes(bytearray(ord(c) for c in chunk))
+            if raw_out:
+                raw_out.write(chunk)
+            data += chunk
+    except KeyboardInterrupt:
+        pass
+    brick.close()
+    return data
+
+
+def decode(data):
+    """Yield (time, kind, track, id) tuples from a raw stream."""
+    # Skip anything before the first SYNC record, in case we joined a
+    # stream in progress.
+    sync = struct.pack("<LBB", SYNC_MAGIC, KIND_SYNC, 0)
+    start = data.find(sync)
+    if start < 0:
+        sys.stderr.write("warning: no sync record, assuming aligned stream\n")
+        start = 0
+    for off in range(start, len(data) - RECORD.size + 1, RECORD.size):
+        yield RECORD.unpack_from(data, off)
+
+
+def convert(records):
+    names = dict((k, dict(v)) for k, v in DEFAULT_NAMES.items())
+    pending_names = {}
+    seen = set()
+    events = []
+    last_time = None
+    epoch = 0
+    dropped = 0
+
+    for time, kind, track, ident in records:
+        if kind == KIND_SYNC:
+            continue
+        if kind == KIND_NAME:
+            key = (track, ident)
+            chars = struct.pack("<L", time)
+            pending_names[key] = pending_names.get(key, b"") + chars
+            if b"\0" in chars:
+                name = pending_names.pop(key).split(b"\0")[0]
+                names.setdefault(track, {})[ident] = name.decode("ascii",
+                                                                  "replace")
+            continue
+
+        # Dropped records carry a count, not a time: place them at the
+        # last known time.
+        if kind == KIND_DROPPED:
+            dropped += time
+            events.append({"name": "%d events dropped" % time, "ph": "i",
+                           "s": "g", "ts": epoch + (last_time or 0),
+                           "pid": track, "tid": 0})
+            continue
+
+        # Timestamps are 32 bits of microseconds, and wrap after ~71
+        # minutes.
+        if last_time is not None and time < last_time and \
+                last_time - time > 0x80000000:
+            epoch += 1 << 32
+        last_time = time
+        ts = epoch + time
+
+        ph = {KIND_BEGIN: "B", KIND_END: "E", KIND_INSTANT: "i"}.get(kind)
+        if ph is None or track >= len(TRACKS):
+            continue
+        seen.add((track, ident))
+        label = names.get(track, {}).get(ident, "%s %d" % (TRACKS[track],
+                                                          ident))
+        ev = {"name": label, "ph": ph, "ts": ts, "pid": track, "tid": ident}
+        if ph == "i":
+            ev["s"] = "t"
+        events.append(ev)
+
+    # Name the tracks.
+    for track, label in enumerate(TRACKS):
+        events.append({"name": "process_name", "ph": "M", "pid": track,
+                       "args": {"name": label}})
+    for track, ident in sorted(seen):
+        label = names.get(track, {}).get(ident, "%s %d" % (TRACKS[track],
+                                                          ident))
+        events.append({"name": "thread_name", "ph": "M", "pid": track,
+                       "tid": ident, "args": {"name": label}})
+
+    if dropped:
+        sys.stderr.write("warning: %d events dropped by the brick\n" % dropped)
+    return {"traceEvents": events, "displayTimeUnit": "ns"}
+
+
+def main():
+    parser = optparse.OptionParser(usage="%prog [options]")
+    parser.add_option("-o", "--output", default="trace.json",
+                      help="timeline file to write (default: %default)")
+    parser.add_option("-i", "--input",
+                      help="convert a saved raw stream instead of "
+                      "capturing from the brick")
+    parser.add_option("-r", "--raw",
+                      help="also save the raw stream to this file")
+    options, args = parser.parse_args()
+
+    if options.input:
+        data = open(options.input, "rb").read()
+    else:
+        raw_out = options.raw and open(options.raw, "wb")
+        data = read_brick(raw_out)
+        if raw_out:
+            raw_out.close()
+
+    timeline = convert(decode(data))
+    out = open(options.output, "w")
+    json.dump(timeline, out)
+    out.close()
+    sys.stderr.write("Wrote %d events to %s\n" % (len(timeline["traceEvents"]),
+                                                  options.output))
+
+
+if __name__ == "__main__":
+    main()